@@ -12,7 +12,13 @@
         Arm Debug Interface Architecture Specification (debug_interface_v5_2_architecture_specification_IHI0031F.pdf)
 */
 #include "pico/stdlib.h"
-#include "serial_utils.h"
+#include "blueTag_api.h"
+#include "board_config.h"
+#include "console_out.h"
+#include "jtag_chain.h"
+#include "jtag_pio.h"
+#include "pin_profile.h"
+#include "swd_pio.h"
 
 const char* banner = R"banner(
              _______ ___     __   __ _______ _______ _______ _______ 
@@ -33,9 +39,14 @@ char* version = "1.0.2";
 
 const uint statusLED = 10;
 const uint MAX_NUM_JTAG = 32;
-const uint maxChannels = 8;  // Max number of channels supported by Faulty Cat
+const uint8_t channelGpio[] = SCAN_CHANNEL_GPIOS;  // Channel -> GPIO, see board_config.h
+const uint maxChannels = ARRAY_SIZE(channelGpio);
 uint progressCount = 0;
 uint maxPermutations = 0;
+bool scanQuiet = false;  // Suppress the progress bar while scanning
+volatile bool scanCancel = false;  // Set from any core to stop the running scan
+// Called instead of drawing the progress bar when set (scan_job.c)
+void (*scanProgressHook)(size_t count, size_t max) = NULL;
 char cmd;
 
 uint jTDI;
@@ -45,14 +56,34 @@ uint jTMS;
 uint jTRST;
 uint jDeviceCount;
 bool jPulsePins;
+bool jQuickProbe = true;  // Drop dead permutations before the full BYPASS test
 uint32_t deviceIDs[MAX_DEVICES_LEN];  // Array to store identified device IDs
 
+// Bit streams for the PIO JTAG engine, enough for the longest sequence
+// (IR length measurement: a full IR chain shifted out, then through again)
+#define JTAG_SCAN_MAX_CLOCKS 4096
+uint32_t jtagStreamWords[JTAG_STREAM_WORDS(JTAG_SCAN_MAX_CLOCKS)];
+uint32_t jtagTdoWords[JTAG_TDO_WORDS(JTAG_SCAN_MAX_CLOCKS)];
+struct jtag_stream jtagStream;
+
 uint xTDI;
 uint xTDO;
 uint xTCK;
 uint xTMS;
 uint xTRST;
 
+// Chains found by the last JTAG scan, the first one is also in x*
+struct bluetag_jtag_chain jtagChains[BLUETAG_MAX_CHAINS];
+uint jtagChainCount = 0;
+
+// Passive pin characterization, redone at the start of every scan
+#define PIN_PROFILE_SAMPLES 16
+#define PIN_PROFILE_SETTLE_US 50
+#define PIN_PROFILE_SAMPLE_US 100
+struct pin_profile pinProfile;
+uint8_t roleOrder[PIN_ROLE_COUNT][PIN_PROFILE_MAX_CHANNELS];  // Most likely channel first
+uint8_t roleCount[PIN_ROLE_COUNT];
+
 // include file from openocd/src/helper
 static const char* const jep106[][126] = {
 #include "jep106.inc"
@@ -84,48 +115,63 @@ void showMenu(void) {
   printf(" [ Note 2: Try deactivating 'pin pulsing' (p) if valid pinout isn't found ]\n\n");
 }
 
-void printProgress(size_t count, size_t max) {
+void drawProgress(size_t count, size_t max) {
   const int bar_width = 50;
 
-  float progress = (float)count / max;
+  // TRST probing can run past the estimate, and pruning can leave nothing to try
+  float progress = (max == 0 || count >= max) ? 1.0f : (float)count / max;
   int bar_length = progress * bar_width;
 
-  printf("\r     Progress: [");
-  for (int i = 0; i < bar_length; ++i) {
-    printf("#");
+  // One buffered write per redraw instead of ~60 putchar-sized transfers
+  console_out_write("\r     Progress: [", 17);
+  console_out_repeat('#', bar_length);
+  console_out_repeat(' ', bar_width - bar_length);
+  console_out_printf("] %.2f%%", progress * 100);
+  console_out_flush();
+}
+
+void printProgress(size_t count, size_t max) {
+  if (scanProgressHook) {
+    scanProgressHook(count, max);
+  } else if (!scanQuiet) {
+    drawProgress(count, max);
   }
-  for (int i = bar_length; i < bar_width; ++i) {
-    printf(" ");
+}
+
+// GPIO mask of the channels set in a channel mask
+uint32_t channelsToGpios(uint32_t channels) {
+  uint32_t gpios = 0;
+  for (int x = 0; channels >> x; x++) {
+    if (channels & (1u << x)) {
+      gpios |= 1u << channelGpio[x];
+    }
   }
-  printf("] %.2f%%", progress * 100);
+  return gpios;
+}
 
-  fflush(stdout);
+// GPIO mask of channels 0..channelCount-1
+uint32_t channelGpioMask(int channelCount) {
+  return channelsToGpios((1u << channelCount) - 1);
 }
 
-int getChannels(void) {
-  int x;
-  printf("     Enter number of channels hooked up (Min 4, Max %d): ", maxChannels);
-  x = getIntFromSerial(1);
-  while (x < 4 || x > maxChannels) {
-    printf("     Enter a valid value: ");
-    x = getIntFromSerial(1);
+// Channel mask of the levels in a gpio_get_all() sample
+uint32_t gpiosToChannels(uint32_t levels, int channelCount) {
+  uint32_t channels = 0;
+  for (int x = 0; x < channelCount; x++) {
+    channels |= ((levels >> channelGpio[x]) & 1) << x;
   }
-  printf("     Number of channels set to: %d\n\n", x);
-  return (x);
+  return channels;
 }
 
 // Function that sets all used channels to output high
 void setPinsHigh(int channelCount) {
-  for (int x = 0; x < channelCount; x++) {
-    gpio_put(x, 1);
-  }
+  uint32_t mask = channelGpioMask(channelCount);
+  gpio_put_masked(mask, mask);
 }
 
-// Function that sets all used channels to output high
+// Function that sets all used channels to output low
 void setPinsLoW(int channelCount) {
-  for (int x = 0; x < channelCount; x++) {
-    gpio_put(x, 0);
-  }
+  gpio_put_masked(channelGpioMask(channelCount), 0);
 }
 
 // Function that sets all used channels to output high
@@ -147,30 +193,80 @@ void pulsePins(int channelCount) {
 
 // Initialize all available channels & set them as output
 void initChannels(void) {
-  for (int x = 0; x < maxChannels; x++) {
-    gpio_init(x);
-    gpio_set_dir(x, GPIO_OUT);
+  uint32_t mask = channelGpioMask(maxChannels);
+  gpio_init_mask(mask);
+  gpio_set_dir_masked(mask, mask);
+}
+
+// Candidate channels per role, leaving out the channels in used and, when
+// pruning, the active ones
+void pinProfileOrderRoles(uint32_t used, bool prune) {
+  for (int role = 0; role < PIN_ROLE_COUNT; role++) {
+    roleCount[role] = pin_profile_order(&pinProfile, role, used, prune, roleOrder[role]);
+  }
+}
+
+// Sample every channel with the pad pull-ups, then the pull-downs, while
+// nothing is clocked, and order the candidate channels of each role
+void pinProfileMeasure(int channelCount) {
+  uint32_t mask = channelGpioMask(channelCount);
+  pin_profile_init(&pinProfile, channelCount);
+  gpio_set_dir_masked(mask, 0);
+  for (int pass = 0; pass < 2; pass++) {
+    bool pullUp = (pass == 0);
+    // Pulls are per pad, the SDK has no masked variant
+    for (int x = 0; x < channelCount; x++) {
+      gpio_set_pulls(channelGpio[x], pullUp, !pullUp);
+    }
+    sleep_us(PIN_PROFILE_SETTLE_US);
+    for (int i = 0; i < PIN_PROFILE_SAMPLES; i++) {
+      pin_profile_add(&pinProfile, pullUp, gpiosToChannels(gpio_get_all(), channelCount));
+      sleep_us(PIN_PROFILE_SAMPLE_US);
+    }
   }
+  for (int x = 0; x < channelCount; x++) {
+    gpio_disable_pulls(channelGpio[x]);
+  }
+  gpio_set_dir_masked(mask, mask);
+  pinProfileOrderRoles(0, true);
 }
 
+void pinProfileDisplay(void) {
+  printf("     [   Pins   ] ");
+  for (int x = 0; x < pinProfile.channels; x++) {
+    printf(" CH%d=%s", x, pin_class_name(pin_profile_class(&pinProfile, x)));
+  }
+  printf("\n\n");
+}
+
+// Takes channels, sets up their GPIOs for the CPU and the PIO shifter
 void jtagConfig(uint tdiPin, uint tdoPin, uint tckPin, uint tmsPin) {
-  // Output
-  gpio_set_dir(tdiPin, GPIO_OUT);
-  gpio_set_dir(tckPin, GPIO_OUT);
-  gpio_set_dir(tmsPin, GPIO_OUT);
+  uint32_t outputs = channelsToGpios((1u << tdiPin) | (1u << tckPin) | (1u << tmsPin));
+  gpio_set_dir_masked(outputs | (1u << channelGpio[tdoPin]), outputs);
+  gpio_put(channelGpio[tckPin], 0);
+
+  jtag_pio_set_pins(channelGpio[tdiPin], channelGpio[tdoPin], channelGpio[tckPin], channelGpio[tmsPin]);
+}
 
-  // Input
-  gpio_set_dir(tdoPin, GPIO_IN);
-  gpio_put(tckPin, 0);
+// Start a new PIO stream; sequences begin by resetting to Run-Test-Idle
+struct jtag_stream* jtagStreamBegin(void) {
+  jtag_stream_init(&jtagStream, jtagStreamWords, JTAG_SCAN_MAX_CLOCKS);
+  jtag_stream_restore_idle(&jtagStream);
+  return &jtagStream;
+}
+
+// Clock the stream out; TDO ends up in jtagTdoWords
+bool jtagStreamRun(void) {
+  return jtag_stream_finish(&jtagStream) && jtag_pio_run(&jtagStream, jtagTdoWords);
 }
 
 // Generate one TCK pulse. Read TDO inside the pulse.
 // Expects TCK to be low upon being called.
 bool tdoRead(void) {
   bool volatile tdoStatus;
-  gpio_put(jTCK, 1);
-  tdoStatus = gpio_get(jTDO);
-  gpio_put(jTCK, 0);
+  gpio_put(channelGpio[jTCK], 1);
+  tdoStatus = gpio_get(channelGpio[jTDO]);
+  gpio_put(channelGpio[jTCK], 0);
   return (tdoStatus);
 }
 
@@ -182,19 +278,19 @@ void tckPulse(void) {
 }
 
 void tdiHigh(void) {
-  gpio_put(jTDI, 1);
+  gpio_put(channelGpio[jTDI], 1);
 }
 
 void tdiLow(void) {
-  gpio_put(jTDI, 0);
+  gpio_put(channelGpio[jTDI], 0);
 }
 
 void tmsHigh(void) {
-  gpio_put(jTMS, 1);
+  gpio_put(channelGpio[jTMS], 1);
 }
 
 void tmsLow(void) {
-  gpio_put(jTMS, 0);
+  gpio_put(channelGpio[jTMS], 0);
 }
 
 void restoreIdle(void) {
@@ -238,34 +334,29 @@ uint32_t bitReverse(uint32_t n) {
 }
 
 void getDeviceIDs(int number) {
-  restoreIdle();   // Reset TAP to Run-Test-Idle
-  enterShiftDR();  // Go to Shift DR
+  struct jtag_stream* stream = jtagStreamBegin();  // Reset TAP to Run-Test-Idle
+  jtag_stream_enter_shift_dr(stream);              // Go to Shift DR
 
-  tdiHigh();
-  tmsLow();
-  uint32_t tempValue;
+  // Reset selects IDCODE (or BYPASS): shift them out with TDI high, LSB first
+  uint32_t start = stream->clocks;
+  jtag_stream_clocks(stream, false, true, number * 32);
+  jtag_stream_restore_idle(stream);  // Reset TAP to Run-Test-Idle
+
+  if (!jtagStreamRun()) {
+    number = 0;
+  }
   for (int x = 0; x < number; x++) {
-    tempValue = 0;
-    for (int y = 0; y < 32; y++) {
-      tempValue <<= 1;
-      tempValue |= tdoRead();
-    }
-    tempValue = bitReverse(tempValue);
-    deviceIDs[x] = tempValue;
+    deviceIDs[x] = jtag_tdo_bits(jtagTdoWords, start + x * 32, 32);
   }
-
-  restoreIdle();  // Reset TAP to Run-Test-Idle
 }
 
-void displayPinout(void) {
-  printProgress(maxPermutations, maxPermutations);
-  printf("\n\n");
-  printf("     [  Pinout  ]  TDI=CH%d", xTDI);
-  printf(" TDO=CH%d", xTDO);
-  printf(" TCK=CH%d", xTCK);
-  printf(" TMS=CH%d", xTMS);
-  if (xTRST != 0) {
-    printf(" TRST=CH%d \n\n", xTRST);
+void displayPinout(const struct bluetag_jtag_chain* chain) {
+  printf("     [  Pinout  ]  TDI=CH%d", chain->tdi);
+  printf(" TDO=CH%d", chain->tdo);
+  printf(" TCK=CH%d", chain->tck);
+  printf(" TMS=CH%d", chain->tms);
+  if (chain->trst != 0) {
+    printf(" TRST=CH%d \n\n", chain->trst);
   } else {
     printf(" TRST=N/A \n\n");
   }
@@ -295,57 +386,65 @@ bool isValidDeviceID(uint32_t idc) {
   return (false);
 }
 
-void displayDeviceDetails(void) {
-  for (int x = 0; x < jDeviceCount; x++) {
-    printf("     [ Device %d ]  0x%08X ", x, deviceIDs[x]);
-    uint32_t idc = deviceIDs[x];
+// Devices from the TAP nearest TDO, with their IR length when it is known
+void displayDeviceDetails(const struct bluetag_jtag_chain* chain) {
+  for (int x = 0; x < chain->device_count; x++) {
+    uint32_t idc = chain->idcodes[x];
+    if (idc != 0) {
+      printf("     [ Device %d ]  0x%08X ", x, idc);
+    } else {
+      printf("     [ Device %d ]  no IDCODE  ", x);
+    }
+    if (chain->ir_lengths[x] != 0) {
+      printf("IR=%-2u ", chain->ir_lengths[x]);
+    } else {
+      printf("IR=?  ");
+    }
     long part = (idc & 0xffff000) >> 12;
     int bank = (idc & 0xf00) >> 8;
     int id = (idc & 0xfe) >> 1;
     int ver = (idc & 0xf0000000) >> 28;
 
     if (id > 1 && id <= 126 && bank <= 8) {
-      printf("(mfg: '%s' , part: 0x%x, ver: 0x%x)\n", jep106_table_manufacturer(bank, id), part, ver);
+      printf("(mfg: '%s' , part: 0x%x, ver: 0x%x)", jep106_table_manufacturer(bank, id), part, ver);
     }
+    printf("\n");
   }
-  printf("\n");
+  printf("     [    IR    ]  %u bits", chain->ir_total);
+  if (chain->ir_total == 0) {
+    printf(" (not measured)");
+  } else if (!chain->ir_exact && chain->device_count > 1) {
+    printf(" (capture pattern too ambiguous to split per device)");
+  }
+  printf("\n\n");
 }
 
 // Function to detect number of devices in the scan chain
 int detectDevices(void) {
-  int volatile x;
-  restoreIdle();
-  enterShiftIR();
+  int x;
+  struct jtag_stream* stream = jtagStreamBegin();
+  jtag_stream_enter_shift_ir(stream);
 
-  tdiHigh();
-  for (x = 0; x < MAX_IR_CHAIN_LEN; x++) {
-    tckPulse();
-  }
+  // All ones selects BYPASS in every device
+  jtag_stream_clocks(stream, false, true, MAX_IR_CHAIN_LEN);
 
-  tmsHigh();
-  tckPulse();  // Go to Exit1 IR
+  // Exit1 IR, Update IR (new instruction in effect), Select DR, Capture DR, Shift DR
+  jtag_stream_tms(stream, 0b00111, 5);
 
-  tmsHigh();
-  tckPulse();  // Go to Update IR, new instruction in effect
-
-  tmsHigh();
-  tckPulse();  // Go to Select DR
+  jtag_stream_clocks(stream, false, true, MAX_DEVICES_LEN);
 
-  tmsLow();
-  tckPulse();  // Go to Capture DR
+  // We are now in BYPASS mode with all DR set
+  // Send in a 0 on TDI and count until we see it on TDO
+  uint32_t start = stream->clocks;
+  jtag_stream_clocks(stream, false, false, MAX_DEVICES_LEN - 1);
 
-  tmsLow();
-  tckPulse();  // Go to Shift DR
+  jtag_stream_tms(stream, 0b011, 3);  // Go to Run-Test-Idle
 
-  for (x = 0; x < MAX_DEVICES_LEN; x++) {
-    tckPulse();
+  if (!jtagStreamRun()) {
+    return 0;
   }
-
-  // We are now in BYPASS mode with all DR set
-  // Send in a 0 on TDI and count until we see it on TDO
-  tdiLow();
   for (x = 0; x < (MAX_DEVICES_LEN - 1); x++) {
-    if (tdoRead() == false) {
+    if (jtag_tdo_bit(jtagTdoWords, start + x) == false) {
       break;  // Our 0 has propagated through the entire chain
               // 'x' holds the number of devices
     }
@@ -354,16 +453,85 @@ int detectDevices(void) {
   if (x > (MAX_DEVICES_LEN - 1)) {
     x = 0;
   }
-
-  tmsHigh();
-  tckPulse();
-  tmsHigh();
-  tckPulse();
-  tmsLow();
-  tckPulse();  // Go to Run-Test-Idle
   return (x);
 }
 
+// IDCODEs of the chain on the current pins. Reset selects IDCODE, or BYPASS
+// in TAPs that have none: a TAP shifts out either 32 bits starting with a 1,
+// or a single 0 (stored as IDCODE 0).
+void jtagReadChainIds(struct bluetag_jtag_chain* chain) {
+  struct jtag_stream* stream = jtagStreamBegin();
+  jtag_stream_enter_shift_dr(stream);
+  uint32_t start = stream->clocks;
+  jtag_stream_clocks(stream, false, true, chain->device_count * 32);
+  jtag_stream_restore_idle(stream);
+  if (!jtagStreamRun()) {
+    chain->device_count = 0;
+    return;
+  }
+
+  uint32_t clock = start;
+  for (int x = 0; x < chain->device_count; x++) {
+    if (jtag_tdo_bit(jtagTdoWords, clock)) {
+      chain->idcodes[x] = jtag_tdo_bits(jtagTdoWords, clock, 32);
+      clock += 32;
+    } else {
+      chain->idcodes[x] = 0;
+      clock += 1;
+    }
+  }
+}
+
+// Fill the IR chain with ones while its Capture-IR bits come out, then push a
+// single 0 through it: the clocks it takes are the total IR length. Ones are
+// shifted in last, so every TAP ends up in BYPASS when the IR is updated.
+void jtagMeasureIr(struct bluetag_jtag_chain* chain) {
+  struct jtag_stream* stream = jtagStreamBegin();
+  jtag_stream_enter_shift_ir(stream);
+  uint32_t capture = stream->clocks;
+  jtag_stream_clocks(stream, false, true, MAX_IR_CHAIN_LEN);
+  uint32_t zero = stream->clocks;
+  jtag_stream_clocks(stream, false, false, 1);
+  jtag_stream_clocks(stream, false, true, MAX_IR_CHAIN_LEN - 1);
+  jtag_stream_clocks(stream, true, true, 1);  // Last bit, to Exit1 IR
+  jtag_stream_exit_to_idle(stream);
+  if (!jtagStreamRun()) {
+    return;
+  }
+
+  chain->ir_total = jtag_chain_measure(jtagTdoWords, zero, MAX_IR_CHAIN_LEN);
+  chain->ir_exact = jtag_chain_split_ir(jtagTdoWords, capture, chain->ir_total, chain->device_count,
+                                        chain->ir_lengths);
+}
+
+// Chain analysis for the pinout in x*, once jDeviceCount is known: a few
+// stream runs, so it costs milliseconds next to the search itself
+void jtagAnalyzeChain(struct bluetag_jtag_chain* chain) {
+  memset(chain, 0, sizeof(*chain));
+  chain->tdi = xTDI;
+  chain->tdo = xTDO;
+  chain->tck = xTCK;
+  chain->tms = xTMS;
+  chain->trst = xTRST;
+  chain->device_count = MIN(jDeviceCount, BLUETAG_MAX_DEVICES);
+  if (chain->device_count == 0) {
+    return;
+  }
+  jtagReadChainIds(chain);
+  jtagMeasureIr(chain);
+}
+
+// Make a chain the result seen through x*, deviceIDs and jDeviceCount
+void jtagSelectChain(const struct bluetag_jtag_chain* chain) {
+  xTDI = chain->tdi;
+  xTDO = chain->tdo;
+  xTCK = chain->tck;
+  xTMS = chain->tms;
+  xTRST = chain->trst;
+  jDeviceCount = chain->device_count;
+  memcpy(deviceIDs, chain->idcodes, chain->device_count * sizeof(uint32_t));
+}
+
 uint32_t shiftArray(uint32_t array, int numBits) {
   uint32_t tempData;
   int x;
@@ -407,29 +575,22 @@ uint32_t bypassTest(int num, uint32_t bPattern) {
     return (0);
   }
 
-  int x;
-  uint32_t value;
-  restoreIdle();
-  enterShiftIR();
-
-  tdiHigh();
-  for (x = 0; x < (num * MAX_IR_LEN); x++)  // Send in 1s
-  {
-    tckPulse();
-  }
-
-  tmsHigh();
-  tckPulse();  // Go to Exit1 IR
+  struct jtag_stream* stream = jtagStreamBegin();
+  jtag_stream_enter_shift_ir(stream);
 
-  tmsHigh();
-  tckPulse();  // Go to Update IR, new instruction in effect
+  jtag_stream_clocks(stream, false, true, num * MAX_IR_LEN);  // Send in 1s
+  jtag_stream_tms(stream, 0b011, 3);  // Exit1 IR, Update IR (new instruction in effect), Run-Test-Idle
 
-  tmsLow();
-  tckPulse();  // Go to Run-Test-Idle
+  // Same as sendData(): the pattern comes out of the BYPASS chain 'num' bits late
+  jtag_stream_enter_shift_dr(stream);
+  uint32_t start = stream->clocks;
+  jtag_stream_shift(stream, bPattern, 32 + num, true);
+  jtag_stream_exit_to_idle(stream);  // Update DR, Run-Test-Idle
 
-  value = sendData(bPattern, 32 + num);  // This is correct, verified.
-  value = bitReverse(value);
-  return (value);
+  if (!jtagStreamRun()) {
+    return (0);
+  }
+  return (jtag_tdo_bits(jtagTdoWords, start + num, 32));
 }
 
 uint32_t uint32Rand(void) {
@@ -442,368 +603,701 @@ uint32_t uint32Rand(void) {
   return (Z);
 }
 
-int calculateJtagPermutations(int totalChannels) {
-  int result = 1;
-  for (int i = 0; i < 4; i++)  // Minimum required pins == 4
-  {
-    result *= (totalChannels - i);
+// TDI/TDO/TCK/TMS orderings left once impossible roles are dropped
+int calculateJtagPermutations(void) {
+  int result = 0;
+  for (int a = 0; a < roleCount[PIN_ROLE_TDI]; a++) {
+    uint tdi = roleOrder[PIN_ROLE_TDI][a];
+    for (int b = 0; b < roleCount[PIN_ROLE_TDO]; b++) {
+      uint tdo = roleOrder[PIN_ROLE_TDO][b];
+      for (int c = 0; c < roleCount[PIN_ROLE_TCK]; c++) {
+        uint tck = roleOrder[PIN_ROLE_TCK][c];
+        for (int d = 0; d < roleCount[PIN_ROLE_TMS]; d++) {
+          uint tms = roleOrder[PIN_ROLE_TMS][d];
+          if (tdi != tdo && tdi != tck && tdi != tms && tdo != tck && tdo != tms && tck != tms) {
+            result++;
+          }
+        }
+      }
+    }
   }
   return result;
 }
 
-void jtagScan(void) {
-  int channelCount;
-  uint32_t tempDeviceId;
-  bool volatile foundPinout = false;
-  jDeviceCount = 0;
-  channelCount = getChannels();  // First get the number of channels hooked
-  progressCount = 0;
-  maxPermutations = calculateJtagPermutations(channelCount);
-  jTDO, jTCK, jTMS, jTDI, jTRST = 0;
-  resetPins(channelCount);
-  for (jTDI = 0; jTDI < channelCount; jTDI++) {
-    for (jTDO = 0; jTDO < channelCount; jTDO++) {
-      if (jTDI == jTDO) {
-        continue;
-      }
-      for (jTCK = 0; jTCK < channelCount; jTCK++) {
-        if (jTCK == jTDO || jTCK == jTDI) {
-          continue;
-        }
-        for (jTMS = 0; jTMS < channelCount; jTMS++) {
-          if (jTMS == jTCK || jTMS == jTDO || jTMS == jTDI) {
-            continue;
-          }
-          // onBoard LED notification
-          gpio_put(statusLED, 1);
-
-          progressCount = progressCount + 1;
-          printProgress(progressCount, maxPermutations);
-          setPinsHigh(channelCount);
-          if (jPulsePins) {
-            pulsePins(channelCount);
-          }
-          jtagConfig(jTDI, jTDO, jTCK, jTMS);
-          jDeviceCount = detectDevices();
-
-          uint32_t dataIn;
-          uint32_t dataOut;
-          dataIn = uint32Rand();
-          dataOut = bypassTest(jDeviceCount, dataIn);
-          if (dataIn == dataOut) {
-            jDeviceCount = detectDevices();
-            getDeviceIDs(jDeviceCount);
-            tempDeviceId = deviceIDs[0];
-            if (isValidDeviceID(tempDeviceId) == false || jDeviceCount <= 0) {
-              continue;
-            } else {
-              foundPinout = true;
-            }
-
-            // Found all pins except nTRST, so let's try
-            xTDI = jTDI;
-            xTDO = jTDO;
-            xTCK = jTCK;
-            xTMS = jTMS;
-            xTRST = 0;
-            for (jTRST = 0; jTRST < channelCount; jTRST++) {
-              if (jTRST == jTMS || jTRST == jTCK || jTRST == jTDO || jTRST == jTDI) {
-                continue;
-              }
-              progressCount = progressCount + 1;
-              printProgress(progressCount, maxPermutations);
-
-              setPinsHigh(channelCount);
-              if (jPulsePins) {
-                pulsePins(channelCount);
-              }
-              jtagConfig(jTDI, jTDO, jTCK, jTMS);
-              gpio_put(jTRST, 1);
-              gpio_put(jTRST, 0);
-              sleep_ms(10);  // Give device time to react
-
-              getDeviceIDs(1);
-              if (tempDeviceId != deviceIDs[0]) {
-                deviceIDs[0] = tempDeviceId;
-                xTRST = jTRST;
-              }
-            }
-            // Done enumerating everything.
-            if (foundPinout == true) {
-              displayPinout();
-              displayDeviceDetails();
-              // onBoard LED notification
-              gpio_put(statusLED, 0);
-              return;
-            }
-          }
-          // onBoard LED notification
-          gpio_put(statusLED, 0);
-        }
+// Count clock/data pairs (TCK/TMS or SWCLK/SWDIO) with different channels
+int calculatePairPermutations(enum pin_role clockRole, enum pin_role dataRole) {
+  int result = 0;
+  for (int a = 0; a < roleCount[clockRole]; a++) {
+    for (int b = 0; b < roleCount[dataRole]; b++) {
+      if (roleOrder[clockRole][a] != roleOrder[dataRole][b]) {
+        result++;
       }
     }
   }
-  if (foundPinout == false) {
-    printProgress(maxPermutations, maxPermutations);
-    printf("\n\n");
-    printf("     No JTAG devices found. Please try again.\n\n");
-  }
+  return result;
 }
 
-//-------------------------------------SWD Scan [custom implementation]-----------------------------
-
-#define LINE_RESET_CLK_CYCLES 52      // Atleast 50 cycles, selecting 52
-#define LINE_RESET_CLK_IDLE_CYCLES 2  // For Line Reset, have to send both of these
-#define SWD_DELAY 5
-#define JTAG_TO_SWD_CMD 0xE79E
-#define SWD_TO_JTAG_CMD 0xE73C
-#define SWDP_ACTIVATION_CODE 0x1A
-#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
-#define bitSet(value, bit) ((value) |= (1UL << (bit)))
-#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
-#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
-
-uint xSwdClk = 0;
-uint xSwdIO = 1;
-bool swdDeviceFound = false;
-int getSwdChannels(void) {
-  char x;
-  printf("     Enter number of channels hooked up (Min 2, Max %d): ", maxChannels);
-  x = getIntFromSerial(1);
-  while (x < 2 || x > maxChannels) {
-    printf("     Enter a valid value: ");
-    x = getIntFromSerial(1);
-  }
-  printf("     Number of channels set to: %d\n\n", x);
-  return (x);
+void displaySkippedChannels(void) {
+  int skipped = __builtin_popcount(pin_profile_active(&pinProfile));
+  if (skipped > 0) {
+    printf("     %d channel(s) toggled by themselves and were only tried last.\n\n", skipped);
+  }
 }
 
-void swdDisplayDeviceDetails(uint32_t idcode) {
-  printf("     [ Device 0 ]  0x%08X ", idcode);
-  uint32_t idc = idcode;
-  long part = (idc & 0xffff000) >> 12;
-  int bank = (idc & 0xf00) >> 8;
-  int id = (idc & 0xfe) >> 1;
-  int ver = (idc & 0xf0000000) >> 28;
+// Time spent per permutation, split by how far it got
+struct {
+  uint32_t rejected;
+  uint64_t rejectedUs;
+  uint32_t tested;
+  uint64_t testedUs;
+  uint32_t resetPulses;
+  uint32_t trstSettles;
+} jtagTiming;
+
+#define QUICK_PROBE_CLOCKS 64
+
+// Cheap liveness check: reset the TAP, which selects IDCODE or BYPASS, and
+// shift an alternating pattern through DR. A real TDO shows the IDCODE or
+// the delayed pattern; a wrong pin assignment leaves it stuck at one level.
+// Only DR is shifted, so no instruction is ever updated.
+bool jtagQuickProbe(void) {
+  struct jtag_stream* stream = jtagStreamBegin();
+  jtag_stream_enter_shift_dr(stream);
+  uint32_t start = stream->clocks;
+  for (int x = 0; x < QUICK_PROBE_CLOCKS; x++) {
+    jtag_stream_clocks(stream, x == QUICK_PROBE_CLOCKS - 1, x & 1, 1);
+  }
+  jtag_stream_exit_to_idle(stream);
+  if (!jtagStreamRun()) {
+    return false;
+  }
 
-  if (id > 1 && id <= 126 && bank <= 8) {
-    printf("(mfg: '%s' , part: 0x%x, ver: 0x%x)\n", jep106_table_manufacturer(bank, id), part, ver);
+  uint32_t ones = 0;
+  for (int x = 0; x < QUICK_PROBE_CLOCKS; x++) {
+    ones += jtag_tdo_bit(jtagTdoWords, start + x);
   }
-  printf("\n");
+  return ones != 0 && ones != QUICK_PROBE_CLOCKS;
 }
 
-void swdDisplayPinout(int swdio, int swclk, uint32_t idcode) {
-  printProgress(maxPermutations, maxPermutations);
-  printf("\n\n");
-  printf("     [  Pinout  ]  SWDIO=CH%d", swdio);
-  printf(" SWCLK=CH%d\n\n", swclk);
-  swdDisplayDeviceDetails(idcode);
+// Roles the channels were last configured for, -1 once unknown. Scans walk
+// the permutations grouped by TCK/TMS so the reset pulse is only paid when
+// the pins driving the TAP change, and directions only when a role moves.
+struct {
+  int tdi;
+  int tdo;
+  int tck;
+  int tms;
+} jtagConfigured;
+
+void jtagScheduleReset(void) {
+  jtagConfigured.tdi = jtagConfigured.tdo = jtagConfigured.tck = jtagConfigured.tms = -1;
 }
 
-void initSwdPins(void) {
-  gpio_set_dir(xSwdClk, GPIO_OUT);
-  gpio_set_dir(xSwdIO, GPIO_OUT);
+// Pulse the pins only when TCK/TMS move: TDI/TDO changes don't disturb the TAP
+void jtagScheduleTap(int channelCount) {
+  if (jtagConfigured.tck == jTCK && jtagConfigured.tms == jTMS) {
+    return;
+  }
+  setPinsHigh(channelCount);
+  if (jPulsePins) {
+    pulsePins(channelCount);
+    jtagTiming.resetPulses++;
+  }
+  jtagConfigured.tck = jTCK;
+  jtagConfigured.tms = jTMS;
+  jtagConfigured.tdi = jtagConfigured.tdo = -1;
 }
 
-void swdClockPulse(void) {
-  gpio_put(xSwdClk, 0);
-  sleep_us(SWD_DELAY);
-  gpio_put(xSwdClk, 1);
-  sleep_us(SWD_DELAY);
+void jtagSchedule(int channelCount) {
+  jtagScheduleTap(channelCount);
+  if (jtagConfigured.tdi == jTDI && jtagConfigured.tdo == jTDO) {
+    return;
+  }
+  setPinsHigh(channelCount);
+  jtagConfig(jTDI, jTDO, jTCK, jTMS);
+  jtagConfigured.tdi = jTDI;
+  jtagConfigured.tdo = jTDO;
 }
 
-void swdSetReadMode(void) {
-  gpio_set_dir(xSwdIO, GPIO_IN);
+#define TRST_SETTLE_MS 10
+
+// Hold every channel in mask low and check whether the first IDCODE changes
+bool trstChangesId(uint32_t mask, uint32_t baseline) {
+  uint32_t gpios = channelsToGpios(mask);
+  gpio_set_dir_masked(gpios, gpios);
+  gpio_put_masked(gpios, 0);
+  sleep_ms(TRST_SETTLE_MS);  // Give device time to react
+  jtagTiming.trstSettles++;
+
+  getDeviceIDs(1);
+  bool changed = (deviceIDs[0] != baseline);
+  deviceIDs[0] = baseline;
+  gpio_put_masked(gpios, gpios);
+  return changed;
 }
 
-void swdTurnAround(void) {
-  swdSetReadMode();
-  swdClockPulse();
-}
+// Find nTRST among the unused channels: all candidates are asserted at once,
+// then halved until one is left, so the settle delay is paid about log2(n)
+// times instead of once per channel. Returns 0 if none.
+uint jtagFindTrst(uint32_t baseline) {
+  uint32_t candidates = 0;
+  for (int t = 0; t < roleCount[PIN_ROLE_TRST]; t++) {
+    uint ch = roleOrder[PIN_ROLE_TRST][t];
+    if (ch != jTMS && ch != jTCK && ch != jTDO && ch != jTDI) {
+      candidates |= 1u << ch;
+    }
+  }
+  if (candidates == 0 || !trstChangesId(candidates, baseline)) {
+    return 0;
+  }
 
-void swdSetWriteMode(void) {
-  gpio_set_dir(xSwdIO, GPIO_OUT);
+  while (candidates & (candidates - 1)) {
+    // Lower half of the remaining channels
+    uint32_t half = 0;
+    uint32_t rest = candidates;
+    for (int n = __builtin_popcount(candidates) / 2; n > 0; n--) {
+      half |= rest & -rest;
+      rest &= rest - 1;
+    }
+    candidates = trstChangesId(half, baseline) ? half : rest;
+  }
+  // The last half wasn't tested on its own if it was picked by elimination
+  if (!trstChangesId(candidates, baseline)) {
+    return 0;
+  }
+  return __builtin_ctz(candidates);
 }
 
-void swdIOHigh(void) {
-  gpio_put(xSwdIO, 1);
+void jtagDisplayTiming(void) {
+  printf("     [  Timing  ]  %lu rejected early", jtagTiming.rejected);
+  if (jtagTiming.rejected > 0) {
+    printf(" (avg %llu us)", jtagTiming.rejectedUs / jtagTiming.rejected);
+  }
+  printf(", %lu fully tested", jtagTiming.tested);
+  if (jtagTiming.tested > 0) {
+    printf(" (avg %llu us)", jtagTiming.testedUs / jtagTiming.tested);
+  }
+  printf("\n                   %lu reset pulses, %lu TRST settle delays\n\n", jtagTiming.resetPulses,
+         jtagTiming.trstSettles);
 }
 
-void swdIOLow(void) {
-  gpio_put(xSwdIO, 0);
+// Check the pinout in jTDI/jTDO/jTCK/jTMS with a BYPASS test, then read the
+// IDCODEs and look for TRST. Displays and returns true on success.
+bool jtagTryPinout(int channelCount) {
+  uint32_t tempDeviceId;
+  uint64_t start = time_us_64();
+  jtagSchedule(channelCount);
+  if (jQuickProbe && !jtagQuickProbe()) {
+    jtagTiming.rejected++;
+    jtagTiming.rejectedUs += time_us_64() - start;
+    return false;
+  }
+  jDeviceCount = detectDevices();
+
+  uint32_t dataIn;
+  uint32_t dataOut;
+  dataIn = uint32Rand();
+  dataOut = bypassTest(jDeviceCount, dataIn);
+  bool found = (dataIn == dataOut);
+  if (found) {
+    jDeviceCount = detectDevices();
+    getDeviceIDs(jDeviceCount);
+    tempDeviceId = deviceIDs[0];
+    found = isValidDeviceID(tempDeviceId) && jDeviceCount > 0;
+  }
+  jtagTiming.tested++;
+  jtagTiming.testedUs += time_us_64() - start;
+  if (!found) {
+    return false;
+  }
+
+  // Found all pins except nTRST, so let's try
+  xTDI = jTDI;
+  xTDO = jTDO;
+  xTCK = jTCK;
+  xTMS = jTMS;
+  xTRST = jtagFindTrst(tempDeviceId);
+  return true;
 }
 
-void swdWriteHigh(void) {
-  gpio_put(xSwdIO, 1);
-  swdClockPulse();
+// Clock TCK/TMS into Shift-DR after a TAP reset (which selects IDCODE) and
+// sample every channel at once on each of the 32 clocks that follow.
+// Fills ids[] per channel with what it shifted out, LSB first.
+void idcodeSniff(int channelCount, uint tck, uint tms, uint32_t* ids) {
+  uint tckGpio = channelGpio[tck];
+  uint tmsGpio = channelGpio[tms];
+  uint32_t samples[32];
+
+  // TMS: 5x high (Test-Logic-Reset), Run-Test-Idle, Select DR, Capture DR, Shift DR
+  const uint32_t tmsSequence = 0b001011111;
+  for (int x = 0; x < 9 + 32; x++) {
+    gpio_put(tmsGpio, (tmsSequence >> x) & 1);
+    gpio_put(tckGpio, 1);
+    uint32_t sample = gpio_get_all();
+    gpio_put(tckGpio, 0);
+    if (x >= 9) {
+      samples[x - 9] = sample;
+    }
+  }
+
+  // Regroup the raw GPIO samples per channel once the clocking is done
+  for (int ch = 0; ch < channelCount; ch++) {
+    uint gpio = channelGpio[ch];
+    ids[ch] = 0;
+    for (int x = 0; x < 32; x++) {
+      ids[ch] |= ((samples[x] >> gpio) & 1) << x;
+    }
+  }
 }
 
-void swdWriteLow(void) {
-  gpio_put(xSwdIO, 0);
-  swdClockPulse();
+// JTAGulator-style pre-scan: try every TCK/TMS pair and treat all other
+// channels as potential TDOs. Returns the channels that shifted out the same
+// valid IDCODE twice.
+uint32_t idcodePrescan(int channelCount, uint tck, uint tms) {
+  uint32_t first[32];
+  uint32_t second[32];
+
+  // Everything but TCK/TMS listens; pull-ups make unconnected channels read all ones
+  uint32_t listen = channelGpioMask(channelCount) & ~channelsToGpios((1u << tck) | (1u << tms));
+  gpio_set_dir_masked(listen, 0);
+  for (int x = 0; x < channelCount; x++) {
+    if (x != tck && x != tms) {
+      gpio_pull_up(channelGpio[x]);
+    }
+  }
+  gpio_put(channelGpio[tck], 0);
+
+  idcodeSniff(channelCount, tck, tms, first);
+  idcodeSniff(channelCount, tck, tms, second);
+
+  uint32_t candidates = 0;
+  for (int x = 0; x < channelCount; x++) {
+    if (x == tck || x == tms) {
+      continue;
+    }
+    // Bit 0 of an IDCODE is always 1 (BYPASS captures a 0)
+    if ((first[x] & 1) && first[x] == second[x] && first[x] != 0xFFFFFFFF && isValidDeviceID(first[x])) {
+      candidates |= 1u << x;
+    }
+    gpio_disable_pulls(channelGpio[x]);
+  }
+  gpio_set_dir_masked(listen, listen);
+  return candidates;
 }
 
-bool swdReadBit(void) {
-  bool value = gpio_get(xSwdIO);
-  swdClockPulse();
-  return (value);
+// Search the channels left in roleOrder[] for a pinout; fills x* on success
+bool jtagFindPinout(int channelCount) {
+  jDeviceCount = 0;
+  progressCount = 0;
+  jtagScheduleReset();
+
+  // Pre-scan: n*(n-1) TCK/TMS pairs instead of n*(n-1)*(n-2)*(n-3) orderings,
+  // TDI is only searched for once a TDO has shown an IDCODE
+  maxPermutations = calculatePairPermutations(PIN_ROLE_TCK, PIN_ROLE_TMS);
+  uint32_t tdoPossible = 0;
+  for (int d = 0; d < roleCount[PIN_ROLE_TDO]; d++) {
+    tdoPossible |= 1u << roleOrder[PIN_ROLE_TDO][d];
+  }
+  for (int c = 0; c < roleCount[PIN_ROLE_TCK]; c++) {
+    jTCK = roleOrder[PIN_ROLE_TCK][c];
+    for (int d = 0; d < roleCount[PIN_ROLE_TMS]; d++) {
+      jTMS = roleOrder[PIN_ROLE_TMS][d];
+      if (jTMS == jTCK) {
+        continue;
+      }
+      if (scanCancel) {
+        return false;
+      }
+      progressCount = progressCount + 1;
+      printProgress(progressCount, maxPermutations);
+      gpio_put(statusLED, 1);
+
+      jtagScheduleTap(channelCount);
+      uint32_t tdoCandidates = idcodePrescan(channelCount, jTCK, jTMS) & tdoPossible;
+      jtagConfigured.tdi = jtagConfigured.tdo = -1;  // Directions were changed
+      for (jTDO = 0; tdoCandidates != 0; jTDO++, tdoCandidates >>= 1) {
+        if ((tdoCandidates & 1) == 0) {
+          continue;
+        }
+        for (int a = 0; a < roleCount[PIN_ROLE_TDI]; a++) {
+          jTDI = roleOrder[PIN_ROLE_TDI][a];
+          if (jTDI == jTDO || jTDI == jTCK || jTDI == jTMS) {
+            continue;
+          }
+          if (jtagTryPinout(channelCount)) {
+            gpio_put(statusLED, 0);
+            return true;
+          }
+        }
+      }
+      gpio_put(statusLED, 0);
+    }
+  }
+
+  // Targets without IDCODE after reset only answer the full BYPASS search,
+  // tried with the most likely role assignments first. TCK/TMS are the outer
+  // loops so each pair gets a single reset pulse.
+  progressCount = 0;
+  maxPermutations = calculateJtagPermutations();
+  for (int c = 0; c < roleCount[PIN_ROLE_TCK]; c++) {
+    jTCK = roleOrder[PIN_ROLE_TCK][c];
+    for (int d = 0; d < roleCount[PIN_ROLE_TMS]; d++) {
+      jTMS = roleOrder[PIN_ROLE_TMS][d];
+      if (jTMS == jTCK) {
+        continue;
+      }
+      for (int b = 0; b < roleCount[PIN_ROLE_TDO]; b++) {
+        jTDO = roleOrder[PIN_ROLE_TDO][b];
+        if (jTDO == jTCK || jTDO == jTMS) {
+          continue;
+        }
+        for (int a = 0; a < roleCount[PIN_ROLE_TDI]; a++) {
+          jTDI = roleOrder[PIN_ROLE_TDI][a];
+          if (jTDI == jTDO || jTDI == jTCK || jTDI == jTMS) {
+            continue;
+          }
+          if (scanCancel) {
+            return false;
+          }
+          // onBoard LED notification
+          gpio_put(statusLED, 1);
+
+          progressCount = progressCount + 1;
+          printProgress(progressCount, maxPermutations);
+          if (jtagTryPinout(channelCount)) {
+            // onBoard LED notification
+            gpio_put(statusLED, 0);
+            return true;
+          }
+          // onBoard LED notification
+          gpio_put(statusLED, 0);
+        }
+      }
+    }
+  }
+  return false;
 }
 
-void swdReadDPIDR(void) {
-  long buffer;
-  bool value;
-  for (int x = 0; x < 32; x++) {
-    value = swdReadBit();
-    bitWrite(buffer, x, value);
+// Find a pinout, analyze its chain, then take its pins out of the roles and
+// search again: boards often route several independent chains to a header
+void jtagSearchChains(int channelCount, bool prune) {
+  uint32_t used = 0;
+  pinProfileOrderRoles(used, prune);
+  while (jtagChainCount < BLUETAG_MAX_CHAINS && channelCount - __builtin_popcount(used) >= 4) {
+    if (!jtagFindPinout(channelCount)) {
+      break;
+    }
+    jtagAnalyzeChain(&jtagChains[jtagChainCount++]);
+
+    used |= (1u << xTDI) | (1u << xTDO) | (1u << xTCK) | (1u << xTMS);
+    if (xTRST != 0) {
+      used |= 1u << xTRST;
+    }
+    pinProfileOrderRoles(used, prune);
   }
-  swdDisplayPinout(xSwdIO, xSwdClk, buffer);
 }
 
-// Receive ACK response from SWD device & verify if OK
-bool swdReadAck(void) {
-  bool bit1 = swdReadBit();
-  bool bit2 = swdReadBit();
-  bool bit3 = swdReadBit();
-  if (bit1 == true && bit2 == false && bit3 == false) {
-    return true;
-  } else {
+bool jtagScanChannels(int channelCount) {
+  jtagChainCount = 0;
+  memset(&jtagTiming, 0, sizeof(jtagTiming));
+  pinProfileMeasure(channelCount);
+  resetPins(channelCount);
+
+  jtagSearchChains(channelCount, true);
+  // The profile is a snapshot: a target still booting, or an output that
+  // went quiet, can pass for active. Nothing found without those channels,
+  // so try them too (last in every role).
+  if (!scanCancel && jtagChainCount == 0 && pin_profile_active(&pinProfile) != 0) {
+    jtagSearchChains(channelCount, false);
+  }
+  if (scanCancel || jtagChainCount == 0) {
     return false;
   }
+  jtagSelectChain(&jtagChains[0]);
+  return true;
 }
 
-void swdWriteBit(bool value) {
-  gpio_put(xSwdIO, value);
-  swdClockPulse();
+void jtagDisplayChains(void) {
+  for (int c = 0; c < jtagChainCount; c++) {
+    if (jtagChainCount > 1) {
+      printf("     [ Chain %d  ]  %d device(s)\n", c, jtagChains[c].device_count);
+    }
+    displayPinout(&jtagChains[c]);
+    displayDeviceDetails(&jtagChains[c]);
+  }
 }
 
-void swdWriteBits(long value, int length) {
-  for (int i = 0; i < length; i++) {
-    swdWriteBit(bitRead(value, i));
+// Results of the last jtagScanChannels()
+void jtagDisplayResult(bool found) {
+  pinProfileDisplay();
+  if (found) {
+    jtagDisplayChains();
+  } else {
+    printf("     No JTAG devices found. Please try again.\n\n");
+    displaySkippedChannels();
   }
+  jtagDisplayTiming();
 }
 
-void swdResetLineSWDJ(void) {
-  swdIOHigh();
-  for (int x = 0; x < LINE_RESET_CLK_CYCLES + 10; x++) {
-    swdClockPulse();
+// Check a known pinout with a single IDCODE read. On a match the chain is
+// read again and the pinout becomes the scan result, as if it was scanned.
+bool jtagVerifyPinout(int channelCount, uint tdi, uint tdo, uint tck, uint tms, uint trst, uint32_t idcode) {
+  jDeviceCount = 0;
+  jTDI = tdi;
+  jTDO = tdo;
+  jTCK = tck;
+  jTMS = tms;
+  jtagScheduleReset();
+  jtagSchedule(channelCount);
+  getDeviceIDs(1);
+  if (deviceIDs[0] != idcode) {
+    return false;
   }
-}
 
-void swdResetLineSWD(void) {
-  swdIOHigh();
-  for (int x = 0; x < LINE_RESET_CLK_CYCLES + 10; x++) {
-    swdClockPulse();
+  jDeviceCount = detectDevices();
+  if (jDeviceCount == 0) {
+    jDeviceCount = 1;  // Answered IDCODE, so there is at least this TAP
   }
-  swdIOLow();
-  swdClockPulse();
-  swdClockPulse();
-  swdClockPulse();
-  swdClockPulse();
-  swdIOHigh();
+  xTDI = tdi;
+  xTDO = tdo;
+  xTCK = tck;
+  xTMS = tms;
+  xTRST = trst;
+  jtagAnalyzeChain(&jtagChains[0]);
+  jtagChainCount = 1;
+  jtagSelectChain(&jtagChains[0]);
+  return true;
 }
 
-// Leave dormant state
-void swdArmWakeUp(void) {
-  swdSetWriteMode();
-  swdIOHigh();
-  for (int x = 0; x < 8; x++)  // Reset to selection Alert Sequence
-  {
-    swdClockPulse();
-  }
+//-------------------------------------SWD Scan [custom implementation]-----------------------------
 
-  // Send selection alert sequence 0x19BC0EA2 E3DDAFE9 86852D95 6209F392 (128 bits)
-  swdWriteBits(0x92, 8);
-  swdWriteBits(0xf3, 8);
-  swdWriteBits(0x09, 8);
-  swdWriteBits(0x62, 8);
+uint xSwdClk = 0;
+uint xSwdIO = 1;
+bool swdDeviceFound = false;
+uint32_t swdIdcode = 0;
+struct bluetag_swd_target swdTargets[BLUETAG_MAX_SWD_TARGETS];
+uint swdTargetCount = 0;
+
+// Multi-drop DPs that nobody can reach with a plain DPIDR read after a line
+// reset (all of them wait for a TARGETSEL), tried with every instance number
+static const uint32_t swdKnownTargetIds[] = {
+    0x01002927,  // RP2040: core 0, core 1 and the rescue DP (instance 0xF)
+    0x00040927,  // RP2350
+};
 
-  swdWriteBits(0x95, 8);
-  swdWriteBits(0x2D, 8);
-  swdWriteBits(0x85, 8);
-  swdWriteBits(0x86, 8);
+void swdDisplayDeviceDetails(uint32_t idcode) {
+  uint32_t idc = idcode;
+  long part = (idc & 0xffff000) >> 12;
+  int bank = (idc & 0xf00) >> 8;
+  int id = (idc & 0xfe) >> 1;
+  int ver = (idc & 0xf0000000) >> 28;
 
-  swdWriteBits(0xE9, 8);
-  swdWriteBits(0xAF, 8);
-  swdWriteBits(0xDD, 8);
-  swdWriteBits(0xE3, 8);
+  if (id > 1 && id <= 126 && bank <= 8) {
+    printf("(mfg: '%s' , part: 0x%x, ver: 0x%x)", jep106_table_manufacturer(bank, id), part, ver);
+  }
+  printf("\n");
+}
 
-  swdWriteBits(0xA2, 8);
-  swdWriteBits(0x0E, 8);
-  swdWriteBits(0xBC, 8);
-  swdWriteBits(0x19, 8);
+void swdDisplayTargets(void) {
+  for (uint i = 0; i < swdTargetCount; i++) {
+    const struct bluetag_swd_target *target = &swdTargets[i];
+    printf("     [  Pinout  ]  SWDIO=CH%d SWCLK=CH%d\n", target->swdio, target->swclk);
+    printf("     [   DP %d   ]  DPIDR    0x%08X ", i, target->dpidr);
+    swdDisplayDeviceDetails(target->dpidr);
+    if (target->has_targetid) {
+      printf("                   TARGETID 0x%08X ", target->targetid);
+      swdDisplayDeviceDetails(target->targetid);
+      if (target->multidrop) {
+        printf("                   TARGETSEL 0x%08X (instance %d)\n", target->targetsel,
+               SWD_TINSTANCE(target->targetsel));
+      }
+    }
+    printf("\n");
+  }
+}
 
-  swdWriteBits(0x00, 4);  // idle bits
-  swdWriteBits(SWDP_ACTIVATION_CODE, 8);
+void swdAddTarget(uint32_t dpidr, bool hasTargetId, uint32_t targetid, bool multidrop, uint32_t targetsel) {
+  for (uint i = 0; i < swdTargetCount; i++) {
+    const struct bluetag_swd_target *target = &swdTargets[i];
+    if (target->swclk == xSwdClk && target->swdio == xSwdIO && target->dpidr == dpidr &&
+        target->targetid == targetid && SWD_TINSTANCE(target->targetsel) == SWD_TINSTANCE(targetsel)) {
+      return;
+    }
+  }
+  if (swdTargetCount == 0) {
+    swdIdcode = dpidr;
+  }
+  if (swdTargetCount < BLUETAG_MAX_SWD_TARGETS) {
+    swdTargets[swdTargetCount++] = (struct bluetag_swd_target){
+        .swclk = xSwdClk,
+        .swdio = xSwdIO,
+        .dpidr = dpidr,
+        .targetid = targetid,
+        .targetsel = targetsel,
+        .has_targetid = hasTargetId,
+        .multidrop = multidrop,
+    };
+  }
+  swdDeviceFound = true;
 }
 
-void swdToJTAG(void) {
-  swdResetLineSWDJ();
-  swdWriteBits(SWD_TO_JTAG_CMD, 16);
+// Select every instance of a TARGETID in turn and record the ones that answer
+uint swdProbeInstances(uint32_t targetid, int skipInstance) {
+  uint found = 0;
+  for (int instance = 0; instance < 16; instance++) {
+    if (instance == skipInstance) {
+      continue;
+    }
+    uint32_t targetsel = (targetid & 0x0FFFFFFF) | ((uint32_t)instance << 28);
+    uint32_t dpidr;
+    swd_pio_send(&swd_seq_line_reset);
+    swd_pio_targetsel(targetsel);
+    if (swd_dp_read(SWD_DP_DPIDR, &dpidr) != SWD_ACK_OK) {
+      continue;
+    }
+    // A DP without multi-drop support ignores TARGETSEL and answers every
+    // time: only keep the ones that really have this instance number
+    uint32_t dlpidr;
+    if (swd_dp_read_bank(SWD_DP_BANK_DLPIDR, SWD_DP_DLPIDR, &dlpidr) == SWD_ACK_OK &&
+        SWD_TINSTANCE(dlpidr) == instance) {
+      swdAddTarget(dpidr, true, targetid, true, targetsel);
+      found++;
+    }
+  }
+  return found;
 }
 
+// Try the pins in xSwdClk/xSwdIO: wake the DPs up into SWD, read DPIDR and
+// TARGETID, then look for more DPs sharing the same wires
 void swdTrySWDJ(void) {
-  swdSetWriteMode();
-  swdArmWakeUp();  // Needed for devices like RPi Pico
-  swdResetLineSWDJ();
-  swdWriteBits(JTAG_TO_SWD_CMD, 16);
-  swdResetLineSWDJ();
-  swdWriteBits(0x00, 4);
-
-  swdWriteBits(0xA5, 8);  // readIdCode command 0b10100101
-  swdTurnAround();
+  uint32_t dpidr;
+  uint found = swdTargetCount;
+  if (!swd_pio_begin(channelGpio[xSwdClk], channelGpio[xSwdIO])) {
+    return;
+  }
+  swd_pio_connect();
 
-  if (swdReadAck() == true)  // Got ACK OK
+  if (swd_dp_read(SWD_DP_DPIDR, &dpidr) == SWD_ACK_OK)  // Got ACK OK and good parity
   {
-    swdDeviceFound = true;
-    swdReadDPIDR();
+    uint32_t targetid = 0;
+    uint32_t dlpidr = 0;
+    bool hasTargetId = SWD_DPIDR_VERSION(dpidr) >= 2 &&
+                       swd_dp_read_bank(SWD_DP_BANK_TARGETID, SWD_DP_TARGETID, &targetid) == SWD_ACK_OK &&
+                       swd_dp_read_bank(SWD_DP_BANK_DLPIDR, SWD_DP_DLPIDR, &dlpidr) == SWD_ACK_OK;
+    int instance = SWD_TINSTANCE(dlpidr);
+    swdAddTarget(dpidr, hasTargetId, targetid, false, (targetid & 0x0FFFFFFF) | ((uint32_t)instance << 28));
+    if (hasTargetId) {
+      // The DP that answered may have neighbours with another instance number
+      if (swdProbeInstances(targetid, instance) > 0) {
+        swdTargets[found].multidrop = true;
+      }
+    }
+  } else {
+    for (uint i = 0; i < count_of(swdKnownTargetIds); i++) {
+      swdProbeInstances(swdKnownTargetIds[i], -1);
+    }
+  }
+  swd_pio_send(&swd_seq_line_reset);
+  swd_pio_end();
+}
+
+void swdToJTAG(void) {
+  if (!swd_pio_begin(channelGpio[xSwdClk], channelGpio[xSwdIO])) {
+    return;
   }
-  swdTurnAround();
-  swdSetWriteMode();
-  swdWriteBits(0x00, 8);
+  swd_pio_send(&swd_seq_swd_to_jtag);
+  swd_pio_end();
 }
 
 bool swdBruteForce(void) {
+  uint before = swdTargetCount;
   // onBoard LED notification
   gpio_put(statusLED, 1);
   swdTrySWDJ();
   gpio_put(statusLED, 0);
-  if (swdDeviceFound) {
+  if (swdTargetCount > before) {
+    // Give SWJ-DPs back to JTAG, like they were before the scan
+    swdToJTAG();
     return (true);
   } else {
     return (false);
   }
 }
 
-void swdScan(void) {
-  swdDeviceFound = false;
-  bool result = false;
-  int channelCount = getSwdChannels();
+void swdSearchPairs(void) {
   progressCount = 0;
-  maxPermutations = channelCount * (channelCount - 1);
-  for (uint clkPin = 0; clkPin < channelCount; clkPin++) {
-    xSwdClk = clkPin;
-    for (uint ioPin = 0; ioPin < channelCount; ioPin++) {
-      xSwdIO = ioPin;
-      if (xSwdClk == xSwdIO) {
+  maxPermutations = calculatePairPermutations(PIN_ROLE_SWCLK, PIN_ROLE_SWDIO);
+  for (int c = 0; c < roleCount[PIN_ROLE_SWCLK]; c++) {
+    xSwdClk = roleOrder[PIN_ROLE_SWCLK][c];
+    for (int d = 0; d < roleCount[PIN_ROLE_SWDIO]; d++) {
+      xSwdIO = roleOrder[PIN_ROLE_SWDIO][d];
+      if (xSwdClk == xSwdIO || scanCancel) {
         continue;
       }
       printProgress(progressCount, maxPermutations);
       progressCount++;
-      initSwdPins();
-      result = swdBruteForce();
-      if (result)
-        break;
+      swdBruteForce();
     }
-    if (result)
-      break;
   }
-  if (swdDeviceFound == false) {
-    printProgress(maxPermutations, maxPermutations);
-    printf("\n\n");
+}
+
+// Walks every clk/io pair, a sweep over 8 channels takes a few tens of ms at 4 MHz
+bool swdScanChannels(int channelCount) {
+  swdDeviceFound = false;
+  swdIdcode = 0;
+  swdTargetCount = 0;
+  pinProfileMeasure(channelCount);
+  swdSearchPairs();
+  // As for JTAG: channels that looked active get their turn if nothing was found
+  if (!swdDeviceFound && !scanCancel && pin_profile_active(&pinProfile) != 0) {
+    pinProfileOrderRoles(0, false);
+    swdSearchPairs();
+  }
+  if (swdDeviceFound) {
+    // Report the first hit in the single-target results
+    xSwdClk = swdTargets[0].swclk;
+    xSwdIO = swdTargets[0].swdio;
+  }
+  return swdDeviceFound;
+}
+
+// Check a known debug port with a single DPIDR read; on a match it becomes
+// the only scan result
+bool swdVerifyTarget(const struct bluetag_swd_target* known) {
+  swdDeviceFound = false;
+  swdIdcode = 0;
+  swdTargetCount = 0;
+  xSwdClk = known->swclk;
+  xSwdIO = known->swdio;
+  if (!swd_pio_begin(channelGpio[xSwdClk], channelGpio[xSwdIO])) {
+    return false;
+  }
+  swd_pio_connect();
+  if (known->multidrop) {
+    swd_pio_send(&swd_seq_line_reset);
+    swd_pio_targetsel(known->targetsel);
+  }
+  uint32_t dpidr;
+  if (swd_dp_read(SWD_DP_DPIDR, &dpidr) == SWD_ACK_OK && dpidr == known->dpidr) {
+    swdAddTarget(dpidr, known->has_targetid, known->targetid, known->multidrop, known->targetsel);
+  }
+  swd_pio_send(&swd_seq_line_reset);
+  swd_pio_end();
+  if (swdDeviceFound) {
+    swdToJTAG();
+  }
+  return swdDeviceFound;
+}
+
+// Results of the last swdScanChannels()
+void swdDisplayResult(void) {
+  pinProfileDisplay();
+  if (swdDeviceFound) {
+    swdDisplayTargets();
+  } else {
     printf("     No devices found. Please try again.\n\n");
+    displaySkippedChannels();
   }
-  // Switch back to JTAG
-  swdToJTAG();
 }
 
 //--------------------------------------------Main--------------------------------------------------
@@ -0,0 +1,70 @@
+#pragma once
+
+// blueTag.h carries its definitions and may only be included by one
+// translation unit (scan/scan_job.c, which runs the scans). This header
+// exposes the settings and results to the rest of the firmware.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pico/types.h"
+
+#define BLUETAG_MAX_DEVICES 32  // MAX_DEVICES_LEN in blueTag.h
+#define BLUETAG_MAX_SWD_TARGETS 16
+#define BLUETAG_MAX_CHAINS 3
+
+/**
+ * One JTAG chain found by the scan, devices listed from the TAP nearest TDO.
+ */
+struct bluetag_jtag_chain {
+  uint tdi;  // Channels, see channelGpio[]
+  uint tdo;
+  uint tck;
+  uint tms;
+  uint trst;  // 0 = none, like xTRST
+  uint device_count;
+  uint32_t idcodes[BLUETAG_MAX_DEVICES];    // 0 = no IDCODE (BYPASS after reset)
+  uint8_t ir_lengths[BLUETAG_MAX_DEVICES];  // 0 = unknown
+  uint ir_total;   // 0 = not measured
+  bool ir_exact;   // ir_lengths split from the Capture-IR pattern
+};
+
+/**
+ * One debug port found by the SWD scan. Several can share a pin pair on a
+ * multi-drop bus, told apart by their TARGETSEL value.
+ */
+struct bluetag_swd_target {
+  uint swclk;  // Channels, see channelGpio[]
+  uint swdio;
+  uint32_t dpidr;
+  uint32_t targetid;   // Valid if has_targetid (DPv2)
+  uint32_t targetsel;  // TARGETID with the instance number in the top nibble
+  bool has_targetid;
+  bool multidrop;      // Needs targetsel to be selected
+};
+
+extern const uint statusLED;
+extern const uint maxChannels;
+extern const uint8_t channelGpio[];  // Channel -> GPIO, SCAN_CHANNEL_GPIOS in board_config.h
+
+// Defaults for the next scan from the console
+extern bool jPulsePins;
+extern bool jQuickProbe;
+
+// JTAG results
+extern uint xTDI;
+extern uint xTDO;
+extern uint xTCK;
+extern uint xTMS;
+extern uint xTRST;
+extern uint jDeviceCount;
+extern uint32_t deviceIDs[BLUETAG_MAX_DEVICES];
+extern struct bluetag_jtag_chain jtagChains[BLUETAG_MAX_CHAINS];  // The first one is also in x*
+extern uint jtagChainCount;
+
+// SWD results
+extern uint xSwdClk;
+extern uint xSwdIO;
+extern uint32_t swdIdcode;  // DPIDR of swdTargets[0]
+extern struct bluetag_swd_target swdTargets[BLUETAG_MAX_SWD_TARGETS];
+extern uint swdTargetCount;
@@ -27,3 +27,14 @@
 // ADC
 #define PIN_ADC_INPUT        29
 #define ADC_CHANNEL_NUM      3
+
+// Optional HV level sense: a divider from the HV capacitor to an ADC pin.
+// The stock board only has the binary PIN_HV_FB_IN, and no ADC pin is free:
+// GP26 is on the /CHARGED net, GP27 the charge LED, GP28 the arm button and
+// GP29 the glitcher ADC input. Free one of them and wire it to an HV divider,
+// then define PIN_HV_SENSE and HV_SENSE_ADC_CHANNEL (GPIO - 26) here.
+
+// JTAG/SWD scan channels (blueTag), CH0 first: the GPIOs routed to the scan
+// header. GP12/13/15/19/21/22 are not connected on the board, and GP26 is on
+// the /CHARGED net with PIN_HV_FB_IN, so it must never be driven.
+#define SCAN_CHANNEL_GPIOS   {0, 1, 2, 3, 4, 5, 6, 7}
@@ -0,0 +1,44 @@
+#include "burst.h"
+
+#include "pico/stdlib.h"
+
+#include "hv_sense.h"
+#include "picoemp.h"
+
+static struct burst_result result;
+
+bool burst_valid(const struct burst_config *config) {
+  return config->count > 0 && config->count <= BURST_MAX_PULSES && config->period_us > 0 &&
+         (uint64_t)config->count * config->period_us < 0x80000000u;
+}
+
+void burst_run(const struct burst_config *config) {
+  result.count = config->count;
+  result.fired = 0;
+  result.skipped = 0;
+
+  uint32_t start = time_us_32();
+  for (uint32_t i = 0; i < config->count; i++) {
+    uint32_t slot = i * config->period_us;
+    while (time_us_32() - start < slot) {
+      picoemp_process_charging();
+    }
+
+    bool charged = picoemp_is_charged();
+    uint16_t level = charged ? hv_sense_read() : HV_SENSE_UNAVAILABLE;
+    result.levels[i] = level;
+
+    if (charged && hv_sense_in_window(level)) {
+      result.timestamps_us[i] = time_us_32() - start;
+      picoemp_pulse_cycles(config->width_cycles);
+      result.fired++;
+    } else {
+      result.timestamps_us[i] = BURST_SKIPPED;
+      result.skipped++;
+    }
+  }
+}
+
+const struct burst_result *burst_get_result() {
+  return &result;
+}
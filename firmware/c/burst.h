@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Repetitive EMP pulses at a fixed rate, run on core 0.
+ *
+ * Pulse slots are scheduled at start + k * period. A slot only fires if the
+ * HV rail is charged and inside the energy window at that moment, otherwise
+ * it is skipped; the schedule never slips, so the spacing of fired pulses
+ * stays exact.
+ */
+
+#define BURST_MAX_PULSES 512
+#define BURST_SKIPPED 0xFFFFFFFF
+
+struct burst_config {
+  uint32_t count;      // Pulse slots, at most BURST_MAX_PULSES
+  uint32_t period_us;  // Slot spacing
+  uint32_t width_cycles;  // 0: use the manual pulse width
+};
+
+struct burst_result {
+  uint32_t count;
+  uint32_t fired;
+  uint32_t skipped;
+  // Per slot: fire time in us since the burst started, or BURST_SKIPPED
+  uint32_t timestamps_us[BURST_MAX_PULSES];
+  // Per slot: HV level sampled before firing (HV_SENSE_UNAVAILABLE if
+  // there's no sense input or the rail wasn't charged)
+  uint16_t levels[BURST_MAX_PULSES];
+};
+
+/**
+ * @brief Check a burst configuration
+ */
+bool burst_valid(const struct burst_config *config);
+
+/**
+ * @brief Run a burst; the HV regulator must already be enabled
+ * @note Blocks core 0 for count * period_us
+ */
+void burst_run(const struct burst_config *config);
+
+/**
+ * @brief Result of the last burst (read after core 0 reported completion)
+ */
+const struct burst_result *burst_get_result();
@@ -0,0 +1,353 @@
+#include "campaign.h"
+
+#include <string.h>
+
+#include "hardware/structs/watchdog.h"
+#include "hardware/sync.h"
+
+#include "config_log.h"
+#include "config_store.h"
+#include "flash_layout.h"
+#include "flash_rp2040.h"
+
+#define KIND_CAMPAIGN 1
+#define JOURNAL_KEY "campaign"
+
+// watchdog scratch[0..3] are free, the SDK uses [4..7] for reboots. The
+// campaign id only goes into the check word: it is known from the journal.
+#define SCRATCH_CHECK 0
+#define SCRATCH_IN_FLIGHT 1
+#define SCRATCH_COMPLETED 2
+#define SCRATCH_TRIGGERED 3
+#define SCRATCH_MAGIC 0xCA3F1A7E
+
+// Bump with any change to struct campaign_journal (or struct config_profile):
+// a journal of another layout is not resumed
+#define JOURNAL_VERSION 3
+
+struct campaign_journal {
+  uint16_t version;
+  uint16_t size;
+  uint32_t id;
+  uint32_t active;
+  struct campaign_params params;
+  uint32_t completed;
+  uint32_t triggered;
+  uint32_t timeouts;
+  uint32_t skipped;
+  uint32_t resumes;
+  uint32_t resets;
+  uint32_t in_flight;           // Attempt `completed` was firing
+  struct config_profile setup;  // Glitcher, pulse and HV setup the campaign runs with
+};
+
+static const struct config_log_flash flash_ops = {
+    .base = FLASH_CAMPAIGN_OFFSET,
+    .size = FLASH_CAMPAIGN_SECTORS * FLASH_SECTOR_SIZE,
+    .sector_size = FLASH_SECTOR_SIZE,
+    .read = flash_rp2040_read,
+    .erase = flash_rp2040_erase,
+    .program = flash_rp2040_program,
+};
+
+static struct config_log journal_log;
+static bool mounted = false;
+
+static struct campaign_status state;
+static spin_lock_t *state_lock;
+static struct config_profile setup;
+
+// Precomputed grid walk
+static uint32_t delay_points;
+static uint32_t width_points;
+static uint32_t stride;
+static uint32_t start;
+static struct campaign_attempt pending;
+static bool in_flight;
+// After a resume from the journal alone (power loss), attempts before this
+// index are journaled as they fire, so one that keeps taking the board down
+// is found on the next boot
+static uint32_t journal_each_until;
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+  while (b) {
+    uint32_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+static uint32_t point_count(uint32_t min, uint32_t max, uint32_t step) {
+  if (max < min || step == 0) {
+    return 0;
+  }
+  return (max - min) / step + 1;
+}
+
+// Grid points and attempts of a campaign; false if the grid is empty or
+// either count doesn't fit in 32 bits
+static bool grid_size(const struct campaign_params *p, uint32_t *points, uint32_t *total) {
+  uint64_t n = (uint64_t)point_count(p->delay_min, p->delay_max, p->delay_step) *
+               point_count(p->width_min, p->width_max, p->width_step);
+  uint64_t attempts = n * p->repeats;
+  if (n == 0 || p->repeats == 0 || n > UINT32_MAX || attempts > UINT32_MAX) {
+    return false;
+  }
+  *points = n;
+  *total = attempts;
+  return true;
+}
+
+/*
+ * Visit the grid as point(k) = (k * stride + start) mod N, with stride coprime
+ * to N: a full permutation that only needs the seed to reproduce. Returns
+ * false for parameters campaign_start() would reject, e.g. from a journal.
+ */
+static bool prepare_walk() {
+  const struct campaign_params *p = &state.params;
+  uint32_t n;
+  if (!grid_size(p, &n, &state.total)) {
+    return false;
+  }
+  delay_points = point_count(p->delay_min, p->delay_max, p->delay_step);
+  width_points = point_count(p->width_min, p->width_max, p->width_step);
+
+  if (p->seed == 0 || n <= 1) {
+    stride = 1;
+    start = 0;
+    return true;
+  }
+  stride = (p->seed % n) | 1;
+  while (gcd(stride, n) != 1) {
+    stride++;
+  }
+  start = (p->seed >> 16) % n;
+  return true;
+}
+
+static uint32_t scratch_check(uint32_t id, uint32_t completed, uint32_t triggered, uint32_t flight) {
+  return SCRATCH_MAGIC ^ id ^ completed ^ triggered ^ (flight << 31);
+}
+
+static void write_scratch() {
+  watchdog_hw->scratch[SCRATCH_IN_FLIGHT] = in_flight;
+  watchdog_hw->scratch[SCRATCH_COMPLETED] = state.completed;
+  watchdog_hw->scratch[SCRATCH_TRIGGERED] = state.triggered;
+  watchdog_hw->scratch[SCRATCH_CHECK] = scratch_check(state.id, state.completed, state.triggered, in_flight);
+}
+
+// False unless the registers hold progress of campaign @p id
+static bool read_scratch(uint32_t id, uint32_t *completed, uint32_t *triggered, bool *flight) {
+  uint32_t flight_word = watchdog_hw->scratch[SCRATCH_IN_FLIGHT];
+  *completed = watchdog_hw->scratch[SCRATCH_COMPLETED];
+  *triggered = watchdog_hw->scratch[SCRATCH_TRIGGERED];
+  *flight = flight_word == 1;
+  return flight_word <= 1 && watchdog_hw->scratch[SCRATCH_CHECK] == scratch_check(id, *completed, *triggered, flight_word);
+}
+
+static void clear_scratch() {
+  watchdog_hw->scratch[SCRATCH_CHECK] = 0;
+}
+
+static void write_journal() {
+  if (!mounted) {
+    return;
+  }
+  struct campaign_journal journal = {
+      .version = JOURNAL_VERSION,
+      .size = sizeof(journal),
+      .id = state.id,
+      .active = state.active,
+      .params = state.params,
+      .completed = state.completed,
+      .triggered = state.triggered,
+      .timeouts = state.timeouts,
+      .skipped = state.skipped,
+      .resumes = state.resumes,
+      .resets = state.resets,
+      .in_flight = in_flight,
+      .setup = setup,
+  };
+  config_log_write(&journal_log, KIND_CAMPAIGN, JOURNAL_KEY, &journal, sizeof(journal));
+}
+
+static bool journal_valid(const struct campaign_journal *journal, int length) {
+  return length == sizeof(*journal) && journal->version == JOURNAL_VERSION && journal->size == sizeof(*journal) &&
+         journal->setup.version == CONFIG_PROFILE_VERSION && journal->setup.size == sizeof(journal->setup);
+}
+
+bool campaign_init(struct config_profile *resumed_setup) {
+  state_lock = spin_lock_init(spin_lock_claim_unused(true));
+  memset(&state, 0, sizeof(state));
+
+  mounted = config_log_init(&journal_log, &flash_ops);
+  struct campaign_journal journal;
+  int length = mounted ? config_log_read(&journal_log, KIND_CAMPAIGN, JOURNAL_KEY, &journal, sizeof(journal)) : -1;
+  // None, or another layout from other firmware: resuming that would run
+  // with a setup it wasn't started with
+  if (!journal_valid(&journal, length)) {
+    clear_scratch();
+    return false;
+  }
+
+  state.id = journal.id;
+  state.params = journal.params;
+  state.completed = journal.completed;
+  state.triggered = journal.triggered;
+  state.timeouts = journal.timeouts;
+  state.skipped = journal.skipped;
+  state.resumes = journal.resumes;
+  state.resets = journal.resets;
+  setup = journal.setup;
+
+  if (!prepare_walk() || !journal.active) {
+    clear_scratch();
+    return false;
+  }
+
+  // The scratch registers are newer than the journal unless power was lost
+  uint32_t completed;
+  uint32_t triggered;
+  bool reset_in_flight = journal.in_flight;
+  if (read_scratch(state.id, &completed, &triggered, &reset_in_flight) && completed >= state.completed) {
+    state.timeouts += (completed - state.completed) - (triggered - state.triggered);
+    state.completed = completed;
+    state.triggered = triggered;
+    journal_each_until = 0;
+  } else {
+    reset_in_flight = journal.in_flight && journal.completed == state.completed;
+    journal_each_until = state.completed + CAMPAIGN_JOURNAL_INTERVAL;
+  }
+
+  // The board went down while an attempt fired: that's its outcome. Trying
+  // it again would likely take the board down again, over and over.
+  if (reset_in_flight && state.completed < state.total) {
+    state.completed++;
+    state.resets++;
+  }
+  in_flight = false;
+
+  if (state.completed >= state.total) {
+    state.active = false;
+    write_journal();
+    clear_scratch();
+    return false;
+  }
+
+  state.active = true;
+  state.resumes++;
+  write_journal();
+  write_scratch();
+  *resumed_setup = setup;
+  return true;
+}
+
+bool campaign_start(const struct campaign_params *params, const struct config_profile *campaign_setup) {
+  uint32_t points;
+  uint32_t total;
+  if (!grid_size(params, &points, &total)) {
+    return false;
+  }
+
+  uint32_t save = spin_lock_blocking(state_lock);
+  state.id++;
+  state.params = *params;
+  state.completed = 0;
+  state.triggered = 0;
+  state.timeouts = 0;
+  state.skipped = 0;
+  state.resumes = 0;
+  state.resets = 0;
+  state.active = true;
+  in_flight = false;
+  journal_each_until = 0;
+  setup = *campaign_setup;
+  prepare_walk();
+  spin_unlock(state_lock, save);
+
+  write_journal();
+  write_scratch();
+  return true;
+}
+
+void campaign_stop() {
+  if (!state.active) {
+    return;
+  }
+  uint32_t save = spin_lock_blocking(state_lock);
+  state.active = false;
+  spin_unlock(state_lock, save);
+  write_journal();
+  clear_scratch();
+}
+
+bool campaign_next(struct campaign_attempt *attempt) {
+  if (!state.active) {
+    return false;
+  }
+
+  uint32_t n = delay_points * width_points;
+  uint32_t point = (uint32_t)(((uint64_t)(state.completed / state.params.repeats) * stride + start) % n);
+
+  pending.index = state.completed;
+  pending.delay = state.params.delay_min + (point / width_points) * state.params.delay_step;
+  pending.width = state.params.width_min + (point % width_points) * state.params.width_step;
+  *attempt = pending;
+  return true;
+}
+
+void campaign_fire() {
+  if (!state.active || pending.index != state.completed) {
+    return;
+  }
+  in_flight = true;
+  write_scratch();
+  if (state.completed < journal_each_until) {
+    write_journal();
+  }
+}
+
+void campaign_skip(uint16_t level) {
+  uint32_t save = spin_lock_blocking(state_lock);
+  state.skipped++;
+  state.last_level = level;
+  spin_unlock(state_lock, save);
+}
+
+void campaign_record(bool triggered, uint16_t level) {
+  if (!state.active || pending.index != state.completed) {
+    return;
+  }
+
+  uint32_t save = spin_lock_blocking(state_lock);
+  state.last_level = level;
+  state.completed++;
+  if (triggered) {
+    state.triggered++;
+  } else {
+    state.timeouts++;
+  }
+  bool done = state.completed >= state.total;
+  if (done) {
+    state.active = false;
+  }
+  spin_unlock(state_lock, save);
+
+  // Journaled while in flight: clear that in the journal too
+  bool journaled = in_flight && state.completed - 1 < journal_each_until;
+  in_flight = false;
+  write_scratch();
+  if (done) {
+    write_journal();
+    clear_scratch();
+  } else if (journaled || state.completed % CAMPAIGN_JOURNAL_INTERVAL == 0) {
+    write_journal();
+  }
+}
+
+void campaign_get_status(struct campaign_status *status) {
+  uint32_t save = spin_lock_blocking(state_lock);
+  *status = state;
+  spin_unlock(state_lock, save);
+}
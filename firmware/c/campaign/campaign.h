@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config_store.h"
+
+/**
+ * On-device delay x width sweep.
+ *
+ * Every grid point is tried `repeats` times; points are visited in a
+ * seed-dependent order so a campaign can be reproduced. Progress is mirrored
+ * to the watchdog scratch registers after every attempt (survives watchdog
+ * and software resets) and journaled to flash every CAMPAIGN_JOURNAL_INTERVAL
+ * attempts (survives brown-outs), together with the setup the campaign was
+ * started with. campaign_init() picks up an interrupted campaign at the last
+ * completed attempt.
+ *
+ * An attempt that was firing when the board reset counts as done, with a
+ * reset outcome, so a point that reliably takes the board down can't trap it
+ * in a boot loop. After a power loss the registers are gone: the attempts
+ * redone from the journal are then journaled as they fire, until one interval
+ * has passed, so a repeat reset is caught there as well.
+ */
+
+#define CAMPAIGN_JOURNAL_INTERVAL 32
+
+struct campaign_params {
+  uint32_t delay_min;
+  uint32_t delay_max;
+  uint32_t delay_step;
+  uint32_t width_min;
+  uint32_t width_max;
+  uint32_t width_step;
+  uint32_t repeats;
+  uint32_t seed;
+};
+
+struct campaign_status {
+  bool active;
+  uint32_t id;
+  struct campaign_params params;
+  uint32_t total;      // Attempts in the whole campaign
+  uint32_t completed;  // Attempts done so far
+  uint32_t triggered;
+  uint32_t timeouts;
+  uint32_t skipped;    // Attempts postponed: HV not charged or outside the energy window
+  uint32_t resumes;    // How often the campaign was picked up after a reset
+  uint32_t resets;     // Attempts the board reset during, counted as completed
+  uint16_t last_level; // HV level sampled before the last attempt
+};
+
+struct campaign_attempt {
+  uint32_t index;
+  uint32_t delay;
+  uint32_t width;
+};
+
+/**
+ * @brief Mount the journal and resume an interrupted campaign, if any
+ * @note Core 0 only (writes to flash)
+ * @param resumed_setup Receives the setup to apply when a campaign is resumed
+ * @return true if a campaign was resumed; false also for a journal written by
+ *         firmware with another journal or profile layout
+ */
+bool campaign_init(struct config_profile *resumed_setup);
+
+/**
+ * @brief Start a new campaign, replacing any running one
+ * @param setup The glitcher, pulse and HV setup it runs with, restored when
+ *        it is resumed after a reset
+ * @return false if the parameters describe an empty grid, or one with more
+ *         than UINT32_MAX points or attempts
+ */
+bool campaign_start(const struct campaign_params *params, const struct config_profile *setup);
+
+/**
+ * @brief Stop the running campaign
+ */
+void campaign_stop();
+
+/**
+ * @brief Get the next attempt of the running campaign
+ * @return false if no campaign is running
+ */
+bool campaign_next(struct campaign_attempt *attempt);
+
+/**
+ * @brief Record the outcome of the attempt returned by campaign_next()
+ * @param level HV level sampled before firing (see hv_sense.h)
+ */
+void campaign_record(bool triggered, uint16_t level);
+
+/**
+ * @brief The attempt returned by campaign_next() is about to fire
+ * @details From here until campaign_record() a reset counts as its outcome.
+ */
+void campaign_fire();
+
+/**
+ * @brief The attempt couldn't fire; it is retried on the next campaign_next()
+ */
+void campaign_skip(uint16_t level);
+
+/**
+ * @brief Snapshot of the campaign progress (safe to call from core 1)
+ */
+void campaign_get_status(struct campaign_status *status);
@@ -49,6 +49,8 @@ struct glitcher_configuration glitcher = {
     .delay_before_pulse = 0,
     .pulse_width = 0};
 
+bool glitcher_verbose = true;
+
 static uint8_t capture_buffer[CAPTURE_DEPTH];
 static uint32_t sample_count = 1000;  // Default sample count
 
@@ -227,10 +229,16 @@ bool glitcher_configure() {
 
   pio_sm_set_enabled(pio0, 0, true);
 
-  printf("Glitcher configured successfully\n");
+  if (glitcher_verbose) printf("Glitcher configured successfully\n");
   return true;
 }
 
+void glitcher_release() {
+  pio_sm_set_enabled(pio0, 0, false);
+  if (current_program.loaded) ft_pio_remove_program(&current_program);
+  ft_pio_program_init(&current_program);
+}
+
 bool glitcher_set_adc_sample_count(uint32_t count) {
   if (count > CAPTURE_DEPTH) {
     printf("Sample count exceeds 30000 buffer size\n");
@@ -359,7 +367,7 @@ bool glitcher_run() {
       uint32_t pattern_len = strlen(glitcher.serial_pattern);
       uint32_t match_idx = 0;
       uint32_t last_print = 0;
-      printf("Waiting for serial pattern \"%s\" on GP%d (%d baud)...\n", glitcher.serial_pattern, glitcher.serial_pin, glitcher.serial_baud);
+      if (glitcher_verbose) printf("Waiting for serial pattern \"%s\" on GP%d (%d baud)...\n", glitcher.serial_pattern, glitcher.serial_pin, glitcher.serial_baud);
       
       // Ensure pulse button is initialized for manual override
       gpio_init(PIN_BTN_PULSE);
@@ -373,7 +381,7 @@ bool glitcher_run() {
           picoemp_process_charging();
 
           uint32_t now = time_us_32();
-          if (now - last_print > 1000000) {
+          if (glitcher_verbose && now - last_print > 1000000) {
               printf(".");
               fflush(stdout);
               last_print = now;
@@ -382,7 +390,7 @@ bool glitcher_run() {
           // Manual Trigger Override via button (PIN_BTN_PULSE)
           // `main.c` checks `if (gpio_get(PIN_BTN_PULSE))` for active high button
           if (gpio_get(PIN_BTN_PULSE)) {
-              printf("\nManual Trigger!\n");
+              if (glitcher_verbose) printf("\nManual Trigger!\n");
               
               // Only push the trigger unblock (Addr 9), others already pushed
               pio_sm_put_blocking(pio0, 0, 0); 
@@ -396,7 +404,7 @@ bool glitcher_run() {
                   match_idx++;
                   if (match_idx >= pattern_len) {
                       // Pattern matched, trigger glitch
-                      printf("\nPattern matched! Triggering...\n");
+                      if (glitcher_verbose) printf("\nPattern matched! Triggering...\n");
 
                       // Only push the trigger unblock (Addr 9), others already pushed
                       pio_sm_put_blocking(pio0, 0, 0); 
@@ -430,7 +438,7 @@ bool glitcher_run() {
   }
 
   if (trigger_timeout) {
-      printf("Trigger wait timed out\n");
+      if (glitcher_verbose) printf("Trigger wait timed out\n");
       adc_run(false);
       dma_channel_abort(ADC_DMA_CHANNEL);
       pio_sm_set_enabled(pio0, 0, false);
@@ -439,7 +447,7 @@ bool glitcher_run() {
       return false;
   }
 
-  printf("Trigger successful\n");
+  if (glitcher_verbose) printf("Trigger successful\n");
 
   pio_interrupt_clear(pio0, PIO_IRQ_TRIGGERED);
   // gpio_put(PIN_LED2, 1);
@@ -41,6 +41,12 @@ struct glitcher_configuration {
 
 extern struct glitcher_configuration glitcher;
 
+/**
+ * @brief Print progress messages while configuring and running (errors are
+ *        always printed). Cleared by the console's machine mode.
+ */
+extern bool glitcher_verbose;
+
 void glitcher_init();
 
 /**
@@ -65,6 +71,12 @@ void glitcher_get_config(struct glitcher_configuration* config);
 
 bool glitcher_configure();
 
+/**
+ * @brief Stop the glitcher state machine and free its pio0 program memory
+ * @details The next glitcher_configure() sets it up again.
+ */
+void glitcher_release();
+
 /**
  * @brief Setup the ADC for capturing samples
  * 
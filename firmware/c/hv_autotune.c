@@ -0,0 +1,80 @@
+#include "hv_autotune.h"
+
+#include "pico/stdlib.h"
+
+static struct hv_autotune_result result;
+
+// Candidate frequencies, each at the full and at half the default on-time
+static const uint32_t candidate_freqs[HV_AUTOTUNE_CANDIDATES / 2] = {1250, 2500, 5000, 10000};
+#define DEFAULT_ON_TIME_NS 4880
+
+static bool wait_recharge(uint32_t *charge_us) {
+  uint16_t level;
+  if (!picoemp_wait_ready(HV_AUTOTUNE_CHARGE_TIMEOUT_MS, &level)) {
+    return false;
+  }
+  // Let the regulator see the charged level if the interrupt hasn't yet
+  picoemp_process_charging();
+  *charge_us = picoemp_last_recharge_us();
+  return true;
+}
+
+static void run_candidate(struct hv_autotune_candidate *candidate, uint32_t width_cycles) {
+  struct picoemp_pwm_setting setting;
+  picoemp_pwm_compute(candidate->freq_hz, candidate->duty, &setting);
+
+  // Start from an empty rail so the first charge is a full cycle too
+  picoemp_hv_disable();
+  picoemp_pulse_cycles(width_cycles);
+  picoemp_hv_enable_setting(&setting);
+
+  uint32_t charge_us;
+  if (!wait_recharge(&charge_us)) {
+    return;
+  }
+
+  uint64_t sum = 0;
+  candidate->min_us = UINT32_MAX;
+  for (int shot = 0; shot < HV_AUTOTUNE_SHOTS; shot++) {
+    picoemp_pulse_cycles(width_cycles);
+    if (!wait_recharge(&charge_us)) {
+      candidate->min_us = 0;
+      return;
+    }
+    sum += charge_us;
+    if (charge_us < candidate->min_us) {
+      candidate->min_us = charge_us;
+    }
+    if (charge_us > candidate->max_us) {
+      candidate->max_us = charge_us;
+    }
+  }
+
+  candidate->mean_us = sum / HV_AUTOTUNE_SHOTS;
+  candidate->stable = candidate->max_us - candidate->min_us <= candidate->mean_us / 2;
+}
+
+void hv_autotune_run(uint32_t width_cycles) {
+  result.found = false;
+  result.count = 0;
+
+  for (int i = 0; i < HV_AUTOTUNE_CANDIDATES / 2; i++) {
+    for (uint32_t on_time_ns = DEFAULT_ON_TIME_NS; on_time_ns >= DEFAULT_ON_TIME_NS / 2; on_time_ns /= 2) {
+      struct hv_autotune_candidate *candidate = &result.candidates[result.count++];
+      *candidate = (struct hv_autotune_candidate){0};
+      candidate->freq_hz = candidate_freqs[i];
+      candidate->duty = (float)on_time_ns * candidate_freqs[i] / 1e9f;
+      run_candidate(candidate, width_cycles);
+
+      if (candidate->stable && (!result.found || candidate->mean_us < result.best_mean_us)) {
+        result.found = true;
+        result.best_mean_us = candidate->mean_us;
+        picoemp_pwm_compute(candidate->freq_hz, candidate->duty, &result.best);
+      }
+    }
+  }
+}
+
+const struct hv_autotune_result *hv_autotune_get_result() {
+  return &result;
+}
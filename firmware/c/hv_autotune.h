@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "picoemp.h"
+
+/**
+ * Charge pump autotune, run on core 0.
+ *
+ * Each candidate PWM setting charges the rail, then fires
+ * HV_AUTOTUNE_SHOTS pulses and times every recharge. A setting is stable
+ * if all recharges finish in time and their spread stays within half the
+ * mean; the stable setting with the lowest mean wins.
+ *
+ * Candidates never exceed the on-time per PWM period of the default setting
+ * (0.0122 at 2.5 kHz, ~4.9 us): a longer on-time would drive the transformer
+ * harder than the stock PicoEMP does.
+ */
+
+#define HV_AUTOTUNE_SHOTS 4
+#define HV_AUTOTUNE_CANDIDATES 8
+#define HV_AUTOTUNE_CHARGE_TIMEOUT_MS 1000
+
+struct hv_autotune_candidate {
+  uint32_t freq_hz;
+  float duty;
+  bool stable;
+  uint32_t mean_us;  // 0 if the rail didn't charge
+  uint32_t min_us;
+  uint32_t max_us;
+};
+
+struct hv_autotune_result {
+  bool found;
+  struct picoemp_pwm_setting best;
+  uint32_t best_mean_us;
+  uint32_t count;
+  struct hv_autotune_candidate candidates[HV_AUTOTUNE_CANDIDATES];
+};
+
+/**
+ * @brief Sweep the candidate settings; the HV regulator is left enabled with the last one
+ * @param width_cycles Width of the test pulses
+ * @note Fires (HV_AUTOTUNE_SHOTS + 1) * HV_AUTOTUNE_CANDIDATES pulses at most
+ */
+void hv_autotune_run(uint32_t width_cycles);
+
+/**
+ * @brief Result of the last autotune (read after core 0 reported completion)
+ */
+const struct hv_autotune_result *hv_autotune_get_result();
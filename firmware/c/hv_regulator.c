@@ -0,0 +1,48 @@
+#include "hv_regulator.h"
+
+// Turn the wanted PWM state into an action, skipping redundant ones
+static hv_reg_action_t set_pwm(struct hv_regulator *reg, bool on) {
+  if (reg->pwm_on == on) {
+    return HV_REG_PWM_KEEP;
+  }
+  reg->pwm_on = on;
+  return on ? HV_REG_PWM_START : HV_REG_PWM_STOP;
+}
+
+void hv_regulator_init(struct hv_regulator *reg) {
+  reg->state = HV_REG_OFF;
+  reg->pwm_on = false;
+  reg->charge_cycles = 0;
+}
+
+hv_reg_action_t hv_regulator_enable(struct hv_regulator *reg, bool charged) {
+  if (reg->state != HV_REG_OFF) {
+    return hv_regulator_feedback(reg, charged);
+  }
+  reg->state = charged ? HV_REG_HOLDING : HV_REG_CHARGING;
+  return set_pwm(reg, !charged);
+}
+
+hv_reg_action_t hv_regulator_disable(struct hv_regulator *reg) {
+  reg->state = HV_REG_OFF;
+  return set_pwm(reg, false);
+}
+
+hv_reg_action_t hv_regulator_feedback(struct hv_regulator *reg, bool charged) {
+  switch (reg->state) {
+    case HV_REG_CHARGING:
+      if (charged) {
+        reg->state = HV_REG_HOLDING;
+        reg->charge_cycles++;
+      }
+      break;
+    case HV_REG_HOLDING:
+      if (!charged) {
+        reg->state = HV_REG_CHARGING;
+      }
+      break;
+    case HV_REG_OFF:
+      return set_pwm(reg, false);
+  }
+  return set_pwm(reg, reg->state == HV_REG_CHARGING);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Charge/discharge state machine for the HV supply.
+ *
+ * Pure logic: it is fed the "charged" feedback level and tells the caller
+ * whether to start or stop the charge pump PWM. picoemp.c drives it from the
+ * feedback pin's edge interrupt, so regulation doesn't depend on what the
+ * main loop is doing.
+ */
+
+typedef enum {
+  HV_REG_OFF,       // Disarmed, PWM off
+  HV_REG_CHARGING,  // Below threshold, PWM running
+  HV_REG_HOLDING,   // Charged, PWM off until the level drops
+} hv_reg_state_t;
+
+typedef enum {
+  HV_REG_PWM_KEEP,
+  HV_REG_PWM_START,
+  HV_REG_PWM_STOP,
+} hv_reg_action_t;
+
+struct hv_regulator {
+  hv_reg_state_t state;
+  bool pwm_on;
+  uint32_t charge_cycles;  // Completed CHARGING -> HOLDING transitions
+};
+
+void hv_regulator_init(struct hv_regulator *reg);
+
+/**
+ * @brief Start regulating (arm)
+ * @param charged Current feedback level
+ */
+hv_reg_action_t hv_regulator_enable(struct hv_regulator *reg, bool charged);
+
+/**
+ * @brief Stop regulating (disarm)
+ */
+hv_reg_action_t hv_regulator_disable(struct hv_regulator *reg);
+
+/**
+ * @brief Feed a new feedback level (edge or periodic re-sample)
+ */
+hv_reg_action_t hv_regulator_feedback(struct hv_regulator *reg, bool charged);
@@ -0,0 +1,52 @@
+#include "hv_sense.h"
+
+#include "hardware/adc.h"
+
+#include "board_config.h"
+
+#define HV_SENSE_SAMPLES 4
+
+static volatile uint16_t window_target = 0;
+static volatile uint8_t window_pct = 5;
+
+void hv_sense_init() {
+#ifdef PIN_HV_SENSE
+  adc_init();
+  adc_gpio_init(PIN_HV_SENSE);
+#endif
+}
+
+uint16_t hv_sense_read() {
+#ifdef PIN_HV_SENSE
+  // The glitcher leaves the ADC set up for free-running DMA capture
+  adc_run(false);
+  adc_select_input(HV_SENSE_ADC_CHANNEL);
+  uint32_t sum = 0;
+  for (int i = 0; i < HV_SENSE_SAMPLES; i++) {
+    sum += adc_read();
+  }
+  adc_fifo_drain();
+  return sum / HV_SENSE_SAMPLES;
+#else
+  return HV_SENSE_UNAVAILABLE;
+#endif
+}
+
+void hv_sense_set_window(uint16_t target, uint8_t pct) {
+  window_target = target;
+  window_pct = pct;
+}
+
+void hv_sense_get_window(uint16_t *target, uint8_t *pct) {
+  *target = window_target;
+  *pct = window_pct;
+}
+
+bool hv_sense_in_window(uint16_t level) {
+  uint32_t target = window_target;
+  if (target == 0 || level == HV_SENSE_UNAVAILABLE) {
+    return true;
+  }
+  uint32_t margin = target * window_pct / 100;
+  return level + margin >= target && level <= target + margin;
+}
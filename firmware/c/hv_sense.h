@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Analog estimate of the HV capacitor charge, sampled right before a pulse.
+ *
+ * Needs PIN_HV_SENSE / HV_SENSE_ADC_CHANNEL in board_config.h; without them
+ * every reading is HV_SENSE_UNAVAILABLE and the energy window always passes.
+ * Levels are raw 12-bit ADC counts.
+ */
+
+#define HV_SENSE_UNAVAILABLE 0xFFFF
+
+void hv_sense_init();
+
+/**
+ * @brief Sample the HV level (core 0: the ADC is shared with the glitcher)
+ */
+uint16_t hv_sense_read();
+
+/**
+ * @brief Set the energy window: fire only within @p window_pct of @p target
+ * @param target Level in ADC counts, 0 disables the window
+ */
+void hv_sense_set_window(uint16_t target, uint8_t window_pct);
+void hv_sense_get_window(uint16_t *target, uint8_t *window_pct);
+
+/**
+ * @brief Whether a level is inside the energy window
+ */
+bool hv_sense_in_window(uint16_t level);
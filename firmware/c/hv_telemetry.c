@@ -0,0 +1,60 @@
+#include "hv_telemetry.h"
+
+#include <string.h>
+
+static struct hv_charge_stats settings[HV_TELEMETRY_SETTINGS];
+
+void hv_telemetry_reset() {
+  memset(settings, 0, sizeof(settings));
+}
+
+struct hv_charge_stats *hv_telemetry_select(uint32_t freq_hz, float duty) {
+  struct hv_charge_stats *victim = &settings[0];
+  for (int i = 0; i < HV_TELEMETRY_SETTINGS; i++) {
+    struct hv_charge_stats *stats = &settings[i];
+    if (stats->freq_hz == freq_hz && stats->duty == duty) {
+      return stats;
+    }
+    if (stats->count < victim->count) {
+      victim = stats;
+    }
+  }
+
+  memset(victim, 0, sizeof(*victim));
+  victim->freq_hz = freq_hz;
+  victim->duty = duty;
+  return victim;
+}
+
+uint32_t hv_telemetry_bucket(uint32_t charge_us) {
+  uint32_t bucket = 0;
+  charge_us >>= HV_TELEMETRY_BUCKET_SHIFT + 1;
+  while (charge_us && bucket < HV_TELEMETRY_BUCKETS - 1) {
+    charge_us >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+uint32_t hv_telemetry_bucket_floor_us(uint32_t bucket) {
+  return bucket == 0 ? 0 : 1u << (bucket + HV_TELEMETRY_BUCKET_SHIFT);
+}
+
+void hv_telemetry_add(struct hv_charge_stats *stats, uint32_t charge_us) {
+  if (stats->count == 0 || charge_us < stats->min_us) {
+    stats->min_us = charge_us;
+  }
+  if (charge_us > stats->max_us) {
+    stats->max_us = charge_us;
+  }
+  stats->count++;
+  stats->sum_us += charge_us;
+  stats->buckets[hv_telemetry_bucket(charge_us)]++;
+}
+
+const struct hv_charge_stats *hv_telemetry_get(uint32_t index) {
+  if (index >= HV_TELEMETRY_SETTINGS || settings[index].count == 0) {
+    return NULL;
+  }
+  return &settings[index];
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Time-to-charge statistics, kept separately for each PWM setting.
+ *
+ * Only full charge cycles are recorded (after arming or after a pulse), not
+ * the short top-ups that compensate leakage while holding.
+ */
+
+#define HV_TELEMETRY_SETTINGS 8
+#define HV_TELEMETRY_BUCKETS 12
+
+// Bucket i counts charge times in [2^(i+6), 2^(i+7)) us, i.e. from 64 us
+// up to ~262 ms; the first and last buckets also take anything beyond.
+#define HV_TELEMETRY_BUCKET_SHIFT 6
+
+struct hv_charge_stats {
+  uint32_t freq_hz;
+  float duty;
+  uint32_t count;
+  uint32_t min_us;
+  uint32_t max_us;
+  uint64_t sum_us;
+  uint32_t buckets[HV_TELEMETRY_BUCKETS];
+};
+
+void hv_telemetry_reset();
+
+/**
+ * @brief Find the stats for a PWM setting, starting new ones if needed
+ * @details When all slots are in use, the one with the fewest samples is reused.
+ */
+struct hv_charge_stats *hv_telemetry_select(uint32_t freq_hz, float duty);
+
+void hv_telemetry_add(struct hv_charge_stats *stats, uint32_t charge_us);
+
+uint32_t hv_telemetry_bucket(uint32_t charge_us);
+
+/**
+ * @brief Lower bound of a bucket in us
+ */
+uint32_t hv_telemetry_bucket_floor_us(uint32_t bucket);
+
+/**
+ * @brief Stats slot @p index, or NULL if it holds no samples
+ */
+const struct hv_charge_stats *hv_telemetry_get(uint32_t index);
@@ -0,0 +1,210 @@
+#include "jtag_bsr.h"
+
+#include <string.h>
+
+#include "hardware/gpio.h"
+#include "pico/time.h"
+
+#include "jtag_chain.h"
+#include "jtag_pio.h"
+#include "jtag_stream.h"
+
+#define MAX_DEVICES 32
+#define RING_WORDS ((1u << JTAG_BSR_RING_BITS) / sizeof(uint32_t))
+
+// IR load plus the BSR measurement: the longest DR chain shifted out, then
+// a 0 pushed through it
+#define SETUP_MAX_CLOCKS (2 * (JTAG_BSR_MAX_LEN + MAX_DEVICES) + MAX_DEVICES * JTAG_CHAIN_MAX_IR_LEN + 128)
+// One sample: Select-DR, Capture-DR, Shift-DR, the DR chain, Update, Run-Test/Idle, padding
+#define PERIOD_MAX_CLOCKS (JTAG_BSR_MAX_LEN + MAX_DEVICES + 64)
+
+static uint32_t ring[RING_WORDS] __attribute__((aligned(1u << JTAG_BSR_RING_BITS)));
+static uint32_t setup_words[JTAG_STREAM_WORDS(SETUP_MAX_CLOCKS)];
+static uint32_t setup_tdo[JTAG_TDO_WORDS(SETUP_MAX_CLOCKS)];
+static uint32_t period_words[JTAG_STREAM_WORDS(PERIOD_MAX_CLOCKS)];
+static struct jtag_stream setup;
+static struct jtag_stream period;
+
+static volatile bool running = false;
+static uint32_t bsr_length;
+static uint32_t bsr_offset;    // Clock of the first BSR bit within a period
+static uint32_t sample_words;  // TDO words per period
+static uint64_t started_us;
+static uint64_t stopped_us;
+static uint32_t stopped_words;
+
+static bool valid(const struct jtag_bsr_target *target) {
+  if (target->device >= target->device_count || target->device_count > MAX_DEVICES || target->opcode == 0 ||
+      target->bsr_length > JTAG_BSR_MAX_LEN) {
+    return false;
+  }
+  for (uint d = 0; d < target->device_count; d++) {
+    uint8_t length = target->ir_lengths[d];
+    if (length < JTAG_CHAIN_MIN_IR_LEN || length > JTAG_CHAIN_MAX_IR_LEN) {
+      return false;
+    }
+  }
+  uint8_t length = target->ir_lengths[target->device];
+  return length == 32 || (target->opcode >> length) == 0;
+}
+
+// SAMPLE/PRELOAD for the TAP, BYPASS (all ones) for the others, then the DR
+// chain length if the BSR length isn't given. Returns the BSR length, 0 on
+// failure.
+static uint32_t load_sample(const struct jtag_bsr_target *target) {
+  jtag_stream_init(&setup, setup_words, SETUP_MAX_CLOCKS);
+  jtag_stream_restore_idle(&setup);
+  jtag_stream_enter_shift_ir(&setup);
+  // The TAP nearest TDO gets the bits shifted in first
+  for (uint d = 0; d < target->device_count; d++) {
+    uint32_t value = (d == target->device) ? target->opcode : 0xFFFFFFFF;
+    jtag_stream_shift(&setup, value, target->ir_lengths[d], d == target->device_count - 1);
+  }
+  jtag_stream_exit_to_idle(&setup);
+
+  uint32_t bypassed = target->device_count - 1;
+  uint32_t chain_max = JTAG_BSR_MAX_LEN + bypassed;
+  uint32_t zero = 0;
+  if (target->bsr_length == 0) {
+    jtag_stream_enter_shift_dr(&setup);
+    jtag_stream_clocks(&setup, false, true, chain_max);
+    zero = setup.clocks;
+    jtag_stream_clocks(&setup, false, false, 1);
+    jtag_stream_clocks(&setup, false, true, chain_max - 1);
+    jtag_stream_clocks(&setup, true, true, 1);  // Last bit, to Exit1 DR
+    jtag_stream_exit_to_idle(&setup);
+  }
+  if (!jtag_stream_finish(&setup) || !jtag_pio_run(&setup, setup_tdo)) {
+    return 0;
+  }
+  if (target->bsr_length != 0) {
+    return target->bsr_length;
+  }
+
+  uint32_t chain = jtag_chain_measure(setup_tdo, zero, chain_max);
+  return chain > bypassed ? chain - bypassed : 0;
+}
+
+bool jtag_bsr_start(const struct jtag_bsr_target *target) {
+  if (running || !valid(target)) {
+    return false;
+  }
+  jtag_pio_set_pins(target->tdi, target->tdo, target->tck, target->tms);
+  gpio_set_dir(target->tdo, GPIO_IN);
+
+  uint32_t length = load_sample(target);
+  if (length == 0 || length > JTAG_BSR_MAX_LEN) {
+    return false;
+  }
+
+  // Capture-DR samples the pins; the rest of the chain is shifted through
+  // and the period padded in Run-Test/Idle to whole TDO words
+  jtag_stream_init(&period, period_words, PERIOD_MAX_CLOCKS);
+  jtag_stream_enter_shift_dr(&period);
+  uint32_t shift_start = period.clocks;
+  jtag_stream_clocks(&period, false, true, length + target->device_count - 2);
+  jtag_stream_clocks(&period, true, true, 1);
+  jtag_stream_exit_to_idle(&period);
+  if (!jtag_stream_finish(&period)) {
+    return false;
+  }
+
+  bsr_length = length;
+  bsr_offset = shift_start + target->device;  // Past the BYPASS bits nearer TDO
+  sample_words = period.clocks / JTAG_TDO_CLOCKS_PER_WORD;
+  stopped_words = 0;
+  started_us = time_us_64();
+  if (!jtag_pio_loop_start(&period, ring, JTAG_BSR_RING_BITS)) {
+    return false;
+  }
+  running = true;
+  return true;
+}
+
+void jtag_bsr_stop() {
+  if (!running) {
+    return;
+  }
+  stopped_words = jtag_pio_loop_words();
+  stopped_us = time_us_64();
+  jtag_pio_loop_stop();
+  running = false;
+}
+
+bool jtag_bsr_running() {
+  return running;
+}
+
+static uint32_t written_words() {
+  return running ? jtag_pio_loop_words() : stopped_words;
+}
+
+// First sample whose words haven't been overwritten yet. The word the DMA
+// writes next shares its slot with the oldest word in the ring.
+static uint32_t oldest_sample(uint32_t written) {
+  if (written < RING_WORDS) {
+    return 0;
+  }
+  return (written - RING_WORDS + 1 + sample_words - 1) / sample_words;
+}
+
+void jtag_bsr_get_status(struct jtag_bsr_status *status) {
+  memset(status, 0, sizeof(*status));
+  status->running = running;
+  if (sample_words == 0) {
+    return;  // Never started
+  }
+  status->bsr_length = bsr_length;
+  status->period_clocks = sample_words * JTAG_TDO_CLOCKS_PER_WORD;
+  status->samples = written_words() / sample_words;
+  uint64_t elapsed_us = (running ? time_us_64() : stopped_us) - started_us;
+  if (elapsed_us > 0) {
+    status->sample_rate = (uint64_t)status->samples * 1000000 / elapsed_us;
+  }
+}
+
+// BSR bits of a sample, funnel-shifted out of the ring 32 at a time
+static void extract(uint32_t sample, uint32_t *out) {
+  uint32_t word = sample * sample_words + bsr_offset / 32;
+  uint32_t shift = bsr_offset % 32;
+  uint32_t count = JTAG_BSR_SAMPLE_WORDS(bsr_length);
+  for (uint32_t i = 0; i < count; i++, word++) {
+    uint32_t value = ring[word % RING_WORDS] >> shift;
+    if (shift != 0) {
+      value |= ring[(word + 1) % RING_WORDS] << (32 - shift);
+    }
+    out[i] = value;
+  }
+  if (bsr_length % 32 != 0) {
+    out[count - 1] &= (1u << (bsr_length % 32)) - 1;
+  }
+}
+
+uint32_t jtag_bsr_read(uint32_t *first, uint32_t *words, uint32_t max) {
+  if (sample_words == 0) {
+    return 0;
+  }
+  uint32_t stride = JTAG_BSR_SAMPLE_WORDS(bsr_length);
+  uint32_t written = written_words();
+  uint32_t oldest = oldest_sample(written);
+  if (*first < oldest) {
+    *first = oldest;
+  }
+
+  uint32_t complete = written / sample_words;
+  uint32_t copied = 0;
+  while (copied < max && *first + copied < complete) {
+    extract(*first + copied, words + copied * stride);
+    copied++;
+  }
+
+  // The DMA may have lapped the samples while they were copied: drop those
+  oldest = oldest_sample(written_words());
+  if (*first < oldest) {
+    uint32_t lost = MIN(oldest - *first, copied);
+    memmove(words, words + lost * stride, (copied - lost) * stride * sizeof(uint32_t));
+    copied -= lost;
+    *first = oldest;
+  }
+  return copied;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pico/types.h"
+
+/**
+ * Boundary-scan sampler, on top of the JTAG engine (jtag_pio.h). One TAP of a
+ * known chain gets SAMPLE/PRELOAD, the others BYPASS; then a single
+ * Capture-DR/Shift-DR period is looped by DMA, so the pin states the TAP
+ * captures land in a RAM ring at TCK / period samples per second, with no CPU
+ * work. It keeps running while core 0 glitches, until jtag_bsr_stop().
+ *
+ * Samples are numbered from the start; the ring holds the most recent ones.
+ */
+
+#define JTAG_BSR_MAX_LEN 2048   // Boundary-scan register bits
+#define JTAG_BSR_RING_BITS 14   // 16 KB of TDO
+#define JTAG_BSR_SAMPLE_WORDS(bsr_length) (((bsr_length) + 31) / 32)
+
+/**
+ * The chain and the TAP to sample. IR lengths must be known for every TAP
+ * (see bluetag_jtag_chain).
+ */
+struct jtag_bsr_target {
+  uint tdi;  // GPIOs, not scan channels
+  uint tdo;
+  uint tck;
+  uint tms;
+  uint device;        // TAP to sample, 0 = nearest TDO
+  uint device_count;
+  const uint8_t *ir_lengths;
+  uint32_t opcode;      // SAMPLE/PRELOAD of that TAP (device specific)
+  uint32_t bsr_length;  // 0 = measure it
+};
+
+struct jtag_bsr_status {
+  bool running;
+  uint32_t bsr_length;
+  uint32_t period_clocks;  // TCK clocks per sample
+  uint32_t samples;        // Captured since jtag_bsr_start()
+  uint32_t sample_rate;    // Achieved samples/s
+};
+
+/**
+ * @brief Load SAMPLE/PRELOAD, measure the BSR if needed and start sampling
+ * @note Refuses an all-zeros opcode, which is EXTEST in most parts and would
+ *       drive the target's pins
+ * @return false if the target is invalid, the measured length is out of
+ *         range or the engine is busy
+ */
+bool jtag_bsr_start(const struct jtag_bsr_target *target);
+
+/**
+ * @brief Stop sampling; the ring and the counters stay readable
+ */
+void jtag_bsr_stop();
+
+bool jtag_bsr_running();
+
+void jtag_bsr_get_status(struct jtag_bsr_status *status);
+
+/**
+ * @brief Copy whole samples out of the ring, BSR bits only, the cell nearest
+ *        TDO in bit 0 of the first word
+ * @param first Index of the first sample wanted; moved past samples that
+ *              were already overwritten, so the caller can count them
+ * @param words Room for @p max samples of JTAG_BSR_SAMPLE_WORDS(bsr_length)
+ * @return Samples copied: not more than are complete
+ */
+uint32_t jtag_bsr_read(uint32_t *first, uint32_t *words, uint32_t max);
@@ -0,0 +1,84 @@
+#include "jtag_chain.h"
+
+#include <string.h>
+
+#include "jtag_stream.h"
+
+// ways[candidate * taps + tap], saturated at 2: only uniqueness matters
+#define SPLIT_TABLE_SIZE 1024
+static uint8_t ways[SPLIT_TABLE_SIZE];
+static uint16_t candidates[SPLIT_TABLE_SIZE];
+
+static bool fits(uint32_t length) {
+  return length >= JTAG_CHAIN_MIN_IR_LEN && length <= JTAG_CHAIN_MAX_IR_LEN;
+}
+
+bool jtag_chain_split_ir(const uint32_t *tdo, uint32_t start, uint32_t total, uint32_t taps, uint8_t *lengths) {
+  memset(lengths, 0, taps);
+  if (taps == 0 || total < taps * JTAG_CHAIN_MIN_IR_LEN) {
+    return false;
+  }
+  if (taps == 1) {
+    lengths[0] = total;
+    return fits(total);
+  }
+
+  // Where a TAP's IR can start: a captured 1 followed by a 0
+  uint32_t count = 0;
+  for (uint32_t p = 0; p + 1 < total; p++) {
+    if (jtag_tdo_bit(tdo, start + p) && !jtag_tdo_bit(tdo, start + p + 1)) {
+      if (count == SPLIT_TABLE_SIZE) {
+        return false;
+      }
+      candidates[count++] = p;
+    }
+  }
+  if (count < taps || candidates[0] != 0 || count * taps > SPLIT_TABLE_SIZE) {
+    return false;
+  }
+
+  // Count the splits from the end: TAP t starting at candidate i
+  for (int32_t i = count - 1; i >= 0; i--) {
+    for (int32_t t = taps - 1; t >= 0; t--) {
+      uint8_t n = 0;
+      if (t == (int32_t)taps - 1) {
+        n = fits(total - candidates[i]);
+      } else {
+        for (uint32_t j = i + 1; j < count && n < 2; j++) {
+          if (fits(candidates[j] - candidates[i])) {
+            n += ways[j * taps + t + 1];
+          }
+        }
+        if (n > 2) {
+          n = 2;
+        }
+      }
+      ways[i * taps + t] = n;
+    }
+  }
+  if (ways[0] != 1) {
+    return false;
+  }
+
+  // Walk the only split
+  uint32_t i = 0;
+  for (uint32_t t = 0; t + 1 < taps; t++) {
+    uint32_t j = i + 1;
+    while (!(fits(candidates[j] - candidates[i]) && ways[j * taps + t + 1] > 0)) {
+      j++;
+    }
+    lengths[t] = candidates[j] - candidates[i];
+    i = j;
+  }
+  lengths[taps - 1] = total - candidates[i];
+  return true;
+}
+
+uint32_t jtag_chain_measure(const uint32_t *tdo, uint32_t start, uint32_t max) {
+  for (uint32_t n = 1; n <= max; n++) {
+    if (!jtag_tdo_bit(tdo, start + n)) {
+      return n;
+    }
+  }
+  return 0;
+}
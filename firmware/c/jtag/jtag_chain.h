@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Chain analysis helpers for the JTAG scan.
+ *
+ * Every TAP loads its instruction register with a capture value ending in
+ * binary 01 on Capture-IR, so the first bits out of Shift-IR (TAP nearest TDO
+ * first, LSB first) start each TAP's IR with a 1 followed by a 0. With the
+ * total IR length and the number of TAPs known, the IR lengths follow when
+ * only one split of the captured bits fits that pattern.
+ *
+ * This file has no hardware dependencies: it works on TDO captures
+ * (jtag_stream.h layout), so it can be checked on a host.
+ */
+
+#define JTAG_CHAIN_MIN_IR_LEN 2
+#define JTAG_CHAIN_MAX_IR_LEN 32
+
+/**
+ * @brief Split the Capture-IR bits of a chain into per-TAP IR lengths
+ * @param tdo TDO words of the run that shifted IR out
+ * @param start Clock of the first captured bit
+ * @param total Total IR length of the chain
+ * @param taps Number of TAPs in the chain
+ * @param lengths Receives @p taps lengths, TAP nearest TDO first; all 0
+ *                if the split isn't unique
+ * @return true if exactly one split fits the capture pattern
+ */
+bool jtag_chain_split_ir(const uint32_t *tdo, uint32_t start, uint32_t total, uint32_t taps, uint8_t *lengths);
+
+/**
+ * @brief Find where a single 0 shifted in after a run of ones comes out
+ * @param tdo TDO words of the run
+ * @param start Clock at which the 0 was shifted in
+ * @param max Clocks shifted after it
+ * @return Number of clocks the 0 took, i.e. the register length, or 0 if it
+ *         never came out
+ */
+uint32_t jtag_chain_measure(const uint32_t *tdo, uint32_t start, uint32_t max);
@@ -0,0 +1,160 @@
+#include "jtag_pio.h"
+
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/pio.h"
+
+#include "jtag.pio.h"
+#include "pio_shared.h"
+
+// pio1 sm0 is the manual EMP pulse, driven from core 0
+#define JTAG_PIO pio1
+#define JTAG_SM 1
+// DMA channels 0 and 1 are the glitcher's ADC capture and multishot
+#define JTAG_DMA_TX 2
+#define JTAG_DMA_RX 3
+// Restarts the TX channel at the end of each period in loop mode
+#define JTAG_DMA_LOOP 4
+
+static int program_offset = -1;
+static bool looping = false;
+static const uint32_t *loop_words;  // Read by JTAG_DMA_LOOP
+static uint32_t clock_hz = JTAG_PIO_CLOCK_DEFAULT_HZ;
+static uint pin_tdi;
+static uint pin_tdo;
+static uint pin_tck;
+static uint pin_tms;
+
+void jtag_pio_set_clock(uint32_t hz) {
+  clock_hz = hz;
+}
+
+uint32_t jtag_pio_get_clock() {
+  return clock_hz;
+}
+
+void jtag_pio_set_pins(uint tdi, uint tdo, uint tck, uint tms) {
+  pin_tdi = tdi;
+  pin_tdo = tdo;
+  pin_tck = tck;
+  pin_tms = tms;
+}
+
+static void configure_dma(uint channel, volatile void *write, const volatile void *read, uint32_t count,
+                          bool from_memory) {
+  dma_channel_config cfg = dma_channel_get_default_config(channel);
+  channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+  channel_config_set_read_increment(&cfg, from_memory);
+  channel_config_set_write_increment(&cfg, !from_memory);
+  channel_config_set_dreq(&cfg, pio_get_dreq(JTAG_PIO, JTAG_SM, from_memory));
+  dma_channel_configure(channel, &cfg, write, read, count, false);
+}
+
+// Load the program once and set the state machine up for the current pins
+static bool prepare() {
+  if (program_offset < 0) {
+    if (!pio_can_add_program(JTAG_PIO, &jtag_shift_program)) {
+      return false;
+    }
+    pio_sm_claim(JTAG_PIO, JTAG_SM);
+    program_offset = pio_add_program(JTAG_PIO, &jtag_shift_program);
+  }
+
+  float clkdiv = (float)clock_get_hz(clk_sys) / ((float)clock_hz * JTAG_SHIFT_CYCLES_PER_CLOCK);
+  if (clkdiv < 1.0f) {
+    clkdiv = 1.0f;
+  }
+  jtag_shift_program_init(JTAG_PIO, JTAG_SM, program_offset, clkdiv, pin_tdi, pin_tdo, pin_tck, pin_tms);
+  return true;
+}
+
+// Back to the CPU, with TCK low
+static void release_pins() {
+  gpio_put(pin_tck, false);
+  gpio_set_function(pin_tdi, GPIO_FUNC_SIO);
+  gpio_set_function(pin_tms, GPIO_FUNC_SIO);
+  gpio_set_function(pin_tck, GPIO_FUNC_SIO);
+}
+
+bool jtag_pio_run(const struct jtag_stream *stream, uint32_t *tdo) {
+  // The RX DMA waits for whole words: a partial last word would never arrive
+  if (looping || stream->clocks % JTAG_TDO_CLOCKS_PER_WORD != 0 || !prepare()) {
+    return false;
+  }
+
+  configure_dma(JTAG_DMA_RX, tdo, &JTAG_PIO->rxf[JTAG_SM], JTAG_TDO_WORDS(stream->clocks), false);
+  configure_dma(JTAG_DMA_TX, &JTAG_PIO->txf[JTAG_SM], stream->words, JTAG_STREAM_WORDS(stream->clocks), true);
+  dma_start_channel_mask((1u << JTAG_DMA_RX) | (1u << JTAG_DMA_TX));
+  pio_shared_sm_set_enabled(JTAG_PIO, JTAG_SM, true);
+
+  // The last TDO word arrives after the last clock
+  dma_channel_wait_for_finish_blocking(JTAG_DMA_RX);
+  pio_shared_sm_set_enabled(JTAG_PIO, JTAG_SM, false);
+
+  release_pins();  // TCK is already low where the stream ended
+  return true;
+}
+
+bool jtag_pio_loop_start(const struct jtag_stream *stream, uint32_t *ring, uint ring_bits) {
+  if (looping || stream->clocks % JTAG_TDO_CLOCKS_PER_WORD != 0 || !prepare()) {
+    return false;
+  }
+
+  // TDO wraps around the ring; the count lasts for hours even at full speed
+  dma_channel_config rx = dma_channel_get_default_config(JTAG_DMA_RX);
+  channel_config_set_transfer_data_size(&rx, DMA_SIZE_32);
+  channel_config_set_read_increment(&rx, false);
+  channel_config_set_write_increment(&rx, true);
+  channel_config_set_ring(&rx, true, ring_bits);
+  channel_config_set_dreq(&rx, pio_get_dreq(JTAG_PIO, JTAG_SM, false));
+  dma_channel_configure(JTAG_DMA_RX, &rx, ring, &JTAG_PIO->rxf[JTAG_SM], 0xFFFFFFFF, false);
+
+  // TX sends one period and chains to LOOP, which points TX back at the
+  // start of the stream and retriggers it: no CPU work per period
+  dma_channel_config tx = dma_channel_get_default_config(JTAG_DMA_TX);
+  channel_config_set_transfer_data_size(&tx, DMA_SIZE_32);
+  channel_config_set_read_increment(&tx, true);
+  channel_config_set_write_increment(&tx, false);
+  channel_config_set_dreq(&tx, pio_get_dreq(JTAG_PIO, JTAG_SM, true));
+  channel_config_set_chain_to(&tx, JTAG_DMA_LOOP);
+  dma_channel_configure(JTAG_DMA_TX, &tx, &JTAG_PIO->txf[JTAG_SM], stream->words,
+                        JTAG_STREAM_WORDS(stream->clocks), false);
+
+  loop_words = stream->words;
+  dma_channel_config loop = dma_channel_get_default_config(JTAG_DMA_LOOP);
+  channel_config_set_transfer_data_size(&loop, DMA_SIZE_32);
+  channel_config_set_read_increment(&loop, false);
+  channel_config_set_write_increment(&loop, false);
+  dma_channel_configure(JTAG_DMA_LOOP, &loop, &dma_hw->ch[JTAG_DMA_TX].al3_read_addr_trig, &loop_words, 1, false);
+
+  looping = true;
+  dma_start_channel_mask((1u << JTAG_DMA_RX) | (1u << JTAG_DMA_TX));
+  pio_shared_sm_set_enabled(JTAG_PIO, JTAG_SM, true);
+  return true;
+}
+
+uint32_t jtag_pio_loop_words() {
+  if (!looping) {
+    return 0;
+  }
+  return 0xFFFFFFFF - dma_channel_hw_addr(JTAG_DMA_RX)->transfer_count;
+}
+
+void jtag_pio_loop_stop() {
+  if (!looping) {
+    return;
+  }
+  pio_shared_sm_set_enabled(JTAG_PIO, JTAG_SM, false);
+
+  // Break the chain first, so aborting TX can't retrigger LOOP (RP2040-E13)
+  dma_channel_config tx = dma_get_channel_config(JTAG_DMA_TX);
+  channel_config_set_chain_to(&tx, JTAG_DMA_TX);
+  dma_channel_set_config(JTAG_DMA_TX, &tx, false);
+  dma_channel_abort(JTAG_DMA_LOOP);
+  dma_channel_abort(JTAG_DMA_TX);
+  dma_channel_abort(JTAG_DMA_RX);
+
+  release_pins();
+  looping = false;
+}
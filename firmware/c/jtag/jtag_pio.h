@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pico/types.h"
+
+#include "jtag_stream.h"
+
+/**
+ * JTAG shift engine on pio1 sm1. A stream is fed by DMA and TDO lands in RAM,
+ * with no CPU work per clock. The pins are only handed to the PIO for the
+ * duration of jtag_pio_run(), so the scan can keep driving the other
+ * channels (e.g. TRST) from the CPU.
+ *
+ * Loop mode repeats one stream until stopped, TDO wrapping around a RAM ring
+ * (DMA 2-4). jtag_pio_run() fails while it is active.
+ */
+
+#define JTAG_PIO_CLOCK_DEFAULT_HZ 4000000
+
+/**
+ * @brief TCK frequency for the following runs (rounded to the PIO clock divider)
+ */
+void jtag_pio_set_clock(uint32_t hz);
+uint32_t jtag_pio_get_clock();
+
+/**
+ * @brief Pin mapping for the following runs
+ */
+void jtag_pio_set_pins(uint tdi, uint tdo, uint tck, uint tms);
+
+/**
+ * @brief Clock a finished stream out and capture TDO
+ * @param stream A whole number of TDO words long (jtag_stream_finish())
+ * @param tdo Receives JTAG_TDO_WORDS(stream->clocks) words
+ * @return false if the stream isn't finished or the program doesn't fit into pio1
+ */
+bool jtag_pio_run(const struct jtag_stream *stream, uint32_t *tdo);
+
+/**
+ * @brief Clock a stream out over and over until jtag_pio_loop_stop()
+ * @param stream One period: ends in the TAP state it starts in, and is a
+ *               whole number of TDO words long (jtag_stream_finish())
+ * @param ring TDO ring of 1 << @p ring_bits bytes, aligned to its size
+ * @return false if already looping or the program doesn't fit into pio1
+ */
+bool jtag_pio_loop_start(const struct jtag_stream *stream, uint32_t *ring, uint ring_bits);
+
+/**
+ * @brief TDO words written to the ring since jtag_pio_loop_start()
+ */
+uint32_t jtag_pio_loop_words();
+
+/**
+ * @brief Stop looping (the ring keeps its contents) and release the pins
+ */
+void jtag_pio_loop_stop();
@@ -0,0 +1,81 @@
+#include "jtag_stream.h"
+
+#include <string.h>
+
+void jtag_stream_init(struct jtag_stream *stream, uint32_t *words, uint32_t max_clocks) {
+  stream->words = words;
+  stream->max_clocks = max_clocks;
+  stream->clocks = 0;
+  stream->overflow = false;
+  memset(words, 0, JTAG_STREAM_WORDS(max_clocks) * sizeof(uint32_t));
+}
+
+static void append(struct jtag_stream *stream, bool tms, bool tdi) {
+  if (stream->clocks >= stream->max_clocks) {
+    stream->overflow = true;
+    return;
+  }
+  uint32_t word = stream->clocks / JTAG_STREAM_CLOCKS_PER_WORD;
+  uint32_t shift = (stream->clocks % JTAG_STREAM_CLOCKS_PER_WORD) * 2;
+  stream->words[word] |= (uint32_t)(tdi | (tms << 1)) << shift;
+  stream->clocks++;
+}
+
+void jtag_stream_clocks(struct jtag_stream *stream, bool tms, bool tdi, uint32_t count) {
+  while (count--) {
+    append(stream, tms, tdi);
+  }
+}
+
+void jtag_stream_tms(struct jtag_stream *stream, uint32_t tms_bits, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    append(stream, (tms_bits >> i) & 1, true);
+  }
+}
+
+void jtag_stream_shift(struct jtag_stream *stream, uint32_t value, uint32_t count, bool exit) {
+  for (uint32_t i = 0; i < count; i++) {
+    bool tdi = i < 32 && ((value >> i) & 1);
+    append(stream, exit && i == count - 1, tdi);
+  }
+}
+
+void jtag_stream_restore_idle(struct jtag_stream *stream) {
+  // Five TMS highs reach Test-Logic-Reset from anywhere, one low to Run-Test/Idle
+  jtag_stream_tms(stream, 0b011111, 6);
+}
+
+void jtag_stream_enter_shift_dr(struct jtag_stream *stream) {
+  // Select-DR, Capture-DR, Shift-DR
+  jtag_stream_tms(stream, 0b001, 3);
+}
+
+void jtag_stream_enter_shift_ir(struct jtag_stream *stream) {
+  // Select-DR, Select-IR, Capture-IR, Shift-IR
+  jtag_stream_tms(stream, 0b0011, 4);
+}
+
+void jtag_stream_exit_to_idle(struct jtag_stream *stream) {
+  // Update, Run-Test/Idle
+  jtag_stream_tms(stream, 0b01, 2);
+}
+
+bool jtag_stream_finish(struct jtag_stream *stream) {
+  uint32_t partial = stream->clocks % JTAG_TDO_CLOCKS_PER_WORD;
+  if (partial != 0) {
+    jtag_stream_clocks(stream, false, true, JTAG_TDO_CLOCKS_PER_WORD - partial);
+  }
+  return !stream->overflow;
+}
+
+bool jtag_tdo_bit(const uint32_t *tdo, uint32_t clock) {
+  return (tdo[clock / JTAG_TDO_CLOCKS_PER_WORD] >> (clock % JTAG_TDO_CLOCKS_PER_WORD)) & 1;
+}
+
+uint32_t jtag_tdo_bits(const uint32_t *tdo, uint32_t clock, uint32_t count) {
+  uint32_t value = 0;
+  for (uint32_t i = 0; i < count && i < 32; i++) {
+    value |= (uint32_t)jtag_tdo_bit(tdo, clock + i) << i;
+  }
+  return value;
+}
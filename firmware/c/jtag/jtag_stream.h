@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * TMS/TDI bit streams for the PIO JTAG engine (jtag_pio.h).
+ *
+ * Each TCK clock takes two bits, TDI then TMS, packed LSB first, 16 clocks
+ * per word. TDO comes back one bit per clock, LSB first, 32 clocks per word.
+ * Building a stream doesn't touch the hardware, so the sequences can be
+ * checked against a TAP model on the host.
+ */
+
+#define JTAG_STREAM_CLOCKS_PER_WORD 16
+#define JTAG_TDO_CLOCKS_PER_WORD 32
+
+struct jtag_stream {
+  uint32_t *words;
+  uint32_t max_clocks;
+  uint32_t clocks;
+  bool overflow;
+};
+
+#define JTAG_STREAM_WORDS(clocks) (((clocks) + JTAG_STREAM_CLOCKS_PER_WORD - 1) / JTAG_STREAM_CLOCKS_PER_WORD)
+#define JTAG_TDO_WORDS(clocks) (((clocks) + JTAG_TDO_CLOCKS_PER_WORD - 1) / JTAG_TDO_CLOCKS_PER_WORD)
+
+/**
+ * @brief Start an empty stream in @p words, room for JTAG_STREAM_WORDS(max_clocks)
+ * @param max_clocks Multiple of JTAG_TDO_CLOCKS_PER_WORD
+ */
+void jtag_stream_init(struct jtag_stream *stream, uint32_t *words, uint32_t max_clocks);
+
+/**
+ * @brief Append @p count clocks with fixed TMS and TDI
+ * @details Sets stream->overflow instead of writing past the buffer.
+ */
+void jtag_stream_clocks(struct jtag_stream *stream, bool tms, bool tdi, uint32_t count);
+
+/**
+ * @brief Append clocks with TDI held high, TMS from @p tms_bits LSB first
+ */
+void jtag_stream_tms(struct jtag_stream *stream, uint32_t tms_bits, uint32_t count);
+
+/**
+ * @brief Shift @p count TDI bits from @p value LSB first (zeros past bit 31)
+ * @param exit Raise TMS on the last bit to leave the Shift state
+ */
+void jtag_stream_shift(struct jtag_stream *stream, uint32_t value, uint32_t count, bool exit);
+
+// TAP state sequences, as used by the blueTag scan
+void jtag_stream_restore_idle(struct jtag_stream *stream);     // Any state -> Run-Test/Idle
+void jtag_stream_enter_shift_dr(struct jtag_stream *stream);   // Run-Test/Idle -> Shift-DR
+void jtag_stream_enter_shift_ir(struct jtag_stream *stream);   // Run-Test/Idle -> Shift-IR
+void jtag_stream_exit_to_idle(struct jtag_stream *stream);     // Exit1 -> Update -> Run-Test/Idle
+
+/**
+ * @brief Pad to a whole TDO word with Run-Test/Idle clocks
+ * @details The engine only returns complete TDO words, so every stream has to
+ *          end in Run-Test/Idle (where TMS low keeps the TAP put) and be finished.
+ * @return false if the stream overflowed
+ */
+bool jtag_stream_finish(struct jtag_stream *stream);
+
+/**
+ * @brief TDO sampled at clock @p clock
+ */
+bool jtag_tdo_bit(const uint32_t *tdo, uint32_t clock);
+
+/**
+ * @brief Up to 32 TDO bits starting at clock @p clock, first clock in bit 0
+ */
+uint32_t jtag_tdo_bits(const uint32_t *tdo, uint32_t clock, uint32_t count);
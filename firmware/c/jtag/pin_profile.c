@@ -0,0 +1,113 @@
+#include "pin_profile.h"
+
+#include <string.h>
+
+// Weights per class, in enum pin_role order. Target inputs often have board
+// pull resistors: TCK/SWCLK and nTRST down, TMS/TDI/SWDIO/TDO up.
+static const uint8_t role_weights[][PIN_ROLE_COUNT] = {
+    //                    TCK TMS TDI TDO TRST SWCLK SWDIO
+    [PIN_CLASS_FLOATING] = {2, 2, 2, 3, 2, 2, 2},
+    [PIN_CLASS_HIGH] = {1, 3, 3, 2, 2, 1, 3},
+    [PIN_CLASS_LOW] = {3, 1, 1, 1, 2, 3, 1},
+    [PIN_CLASS_ACTIVE] = {0, 0, 0, 0, 0, 0, 0},
+};
+
+static const char *const class_names[] = {
+    [PIN_CLASS_FLOATING] = "floating",
+    [PIN_CLASS_HIGH] = "high",
+    [PIN_CLASS_LOW] = "low",
+    [PIN_CLASS_ACTIVE] = "active",
+};
+
+void pin_profile_init(struct pin_profile *profile, uint8_t channels) {
+  memset(profile, 0, sizeof(*profile));
+  profile->channels = channels > PIN_PROFILE_MAX_CHANNELS ? PIN_PROFILE_MAX_CHANNELS : channels;
+}
+
+void pin_profile_add(struct pin_profile *profile, bool pulled_up, uint32_t levels) {
+  uint8_t *high = pulled_up ? profile->high_pulled_up : profile->high_pulled_down;
+  for (uint8_t ch = 0; ch < profile->channels; ch++) {
+    high[ch] += (levels >> ch) & 1;
+  }
+  if (pulled_up) {
+    profile->samples_pulled_up++;
+  } else {
+    profile->samples_pulled_down++;
+  }
+}
+
+// Majority level of a pass, ties going to the pull: a pass with no samples
+// reads as following it. *active is set if too many samples disagree.
+static bool pass_high(uint8_t high, uint8_t samples, bool pulled_up, bool *active) {
+  uint8_t low = samples - high;
+  uint8_t minority = high < low ? high : low;
+  if (minority != 0 && minority * PIN_PROFILE_ACTIVE_FRACTION >= samples) {
+    *active = true;
+  }
+  return pulled_up ? high >= low : high > low;
+}
+
+enum pin_class pin_profile_class(const struct pin_profile *profile, uint8_t channel) {
+  bool active = false;
+  bool up = pass_high(profile->high_pulled_up[channel], profile->samples_pulled_up, true, &active);
+  bool down = pass_high(profile->high_pulled_down[channel], profile->samples_pulled_down, false, &active);
+
+  if (active) {
+    return PIN_CLASS_ACTIVE;
+  }
+  if (up && !down) {
+    return PIN_CLASS_FLOATING;
+  }
+  if (up && down) {
+    return PIN_CLASS_HIGH;
+  }
+  if (!up && !down) {
+    return PIN_CLASS_LOW;
+  }
+  // Low when pulled up and high when pulled down: it moved between the passes
+  return PIN_CLASS_ACTIVE;
+}
+
+const char *pin_class_name(enum pin_class pin_class) {
+  return class_names[pin_class];
+}
+
+uint8_t pin_role_weight(enum pin_class pin_class, enum pin_role role) {
+  return role_weights[pin_class][role];
+}
+
+uint8_t pin_profile_order(const struct pin_profile *profile, enum pin_role role, uint32_t exclude, bool prune,
+                          uint8_t order[PIN_PROFILE_MAX_CHANNELS]) {
+  uint8_t count = 0;
+  uint8_t weights[PIN_PROFILE_MAX_CHANNELS];
+
+  for (uint8_t ch = 0; ch < profile->channels; ch++) {
+    if (exclude & (1u << ch)) {
+      continue;
+    }
+    uint8_t weight = pin_role_weight(pin_profile_class(profile, ch), role);
+    if (weight == 0 && prune) {
+      continue;
+    }
+    // Insertion sort, stable for equal weights
+    uint8_t i = count++;
+    while (i > 0 && weights[i - 1] < weight) {
+      weights[i] = weights[i - 1];
+      order[i] = order[i - 1];
+      i--;
+    }
+    weights[i] = weight;
+    order[i] = ch;
+  }
+  return count;
+}
+
+uint32_t pin_profile_active(const struct pin_profile *profile) {
+  uint32_t active = 0;
+  for (uint8_t ch = 0; ch < profile->channels; ch++) {
+    if (pin_profile_class(profile, ch) == PIN_CLASS_ACTIVE) {
+      active |= 1u << ch;
+    }
+  }
+  return active;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Passive pin characterization for the JTAG/SWD pinout scans.
+ *
+ * Before anything is clocked, every channel is sampled a few times with the
+ * pad pull-up and then with the pull-down. A channel that follows both pulls
+ * is floating, one that holds its level against them is pulled or driven by
+ * the target, and one that keeps changing level on its own is a target output
+ * (clock, UART, ...) that can't be any debug input nor an idle TDO. A few odd
+ * samples (a UART start bit, noise) don't make a channel active: each pass is
+ * classed by its majority level.
+ *
+ * This file has no hardware dependencies: the scan records a pin_profile
+ * and the ordering below works on the recording.
+ */
+
+#define PIN_PROFILE_MAX_CHANNELS 32
+
+// A pass with at least 1/PIN_PROFILE_ACTIVE_FRACTION of its samples away from
+// the majority level makes the channel active
+#define PIN_PROFILE_ACTIVE_FRACTION 4
+
+enum pin_class {
+  PIN_CLASS_FLOATING,  // Follows the pad pulls
+  PIN_CLASS_HIGH,      // High against the pull-down: pull-up, driven high or VCC
+  PIN_CLASS_LOW,       // Low against the pull-up: pull-down, driven low or GND
+  PIN_CLASS_ACTIVE,    // Kept changing level by itself
+};
+
+enum pin_role {
+  PIN_ROLE_TCK,
+  PIN_ROLE_TMS,
+  PIN_ROLE_TDI,
+  PIN_ROLE_TDO,
+  PIN_ROLE_TRST,
+  PIN_ROLE_SWCLK,
+  PIN_ROLE_SWDIO,
+  PIN_ROLE_COUNT,
+};
+
+/**
+ * Number of samples that read high, per channel and pull direction
+ */
+struct pin_profile {
+  uint8_t channels;
+  uint8_t samples_pulled_up;
+  uint8_t samples_pulled_down;
+  uint8_t high_pulled_up[PIN_PROFILE_MAX_CHANNELS];
+  uint8_t high_pulled_down[PIN_PROFILE_MAX_CHANNELS];
+};
+
+void pin_profile_init(struct pin_profile *profile, uint8_t channels);
+
+/**
+ * @brief Record one gpio_get_all()-style sample, bit n = channel n
+ */
+void pin_profile_add(struct pin_profile *profile, bool pulled_up, uint32_t levels);
+
+enum pin_class pin_profile_class(const struct pin_profile *profile, uint8_t channel);
+
+const char *pin_class_name(enum pin_class pin_class);
+
+/**
+ * @brief How likely a pin of this class is to have this role
+ * @return 0 for an active pin, higher is more likely
+ */
+uint8_t pin_role_weight(enum pin_class pin_class, enum pin_role role);
+
+/**
+ * @brief Channels that can have @p role, most likely first
+ * @details Channels in @p exclude (bit n = channel n) are skipped. Ties keep
+ *          the channel order, so a profile where every channel floats gives
+ *          back 0..channels-1.
+ * @param prune Skip active channels; without it they come last, for a
+ *              second search when the pruned one found nothing
+ * @return Number of channels written to @p order
+ */
+uint8_t pin_profile_order(const struct pin_profile *profile, enum pin_role role, uint32_t exclude, bool prune,
+                          uint8_t order[PIN_PROFILE_MAX_CHANNELS]);
+
+/**
+ * @brief Channels classed active, bit n = channel n
+ */
+uint32_t pin_profile_active(const struct pin_profile *profile);
@@ -1,10 +1,18 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "burst.h"
+#include "campaign.h"
+#include "config_store.h"
 #include "glitcher.h"
+#include "hv_autotune.h"
+#include "hv_sense.h"
+#include "jtag_bsr.h"
+#include "multishot.h"
 #include "pico/multicore.h"
 #include "pico/stdlib.h"
 #include "picoemp.h"
+#include "scan_job.h"
 #include "serial.h"
 #include "trigger_basic.pio.h"
 #include "board_config.h"
@@ -24,6 +32,8 @@ static bool armed = false;
 static bool timeout_active = true;
 static bool hvp_internal = true; 
 static absolute_time_t timeout_time;
+static bool pulse_button_down = false;
+static absolute_time_t pulse_button_time;
 static uint offset = 0xFFFFFFFF;
 
 // defaults taken from original code
@@ -32,17 +42,25 @@ static uint offset = 0xFFFFFFFF;
 #define PULSE_TIME_US_DEFAULT 5        // 5us
 #define PULSE_POWER_DEFAULT 0.0122
 static uint32_t pulse_time;
+static uint32_t pulse_cycles;  // 0: derived from pulse_time
 static uint32_t pulse_delay_cycles;
 static uint32_t pulse_time_cycles;
 union float_union {
   float f;
   uint32_t ui32;
 } pulse_power;
+// Charge pump registers for pulse_power at the PWM frequency, computed when either changes
+static struct picoemp_pwm_setting pwm_setting;
+
+static void update_pwm_setting() {
+  picoemp_pwm_compute(picoemp_get_pwm_freq(), pulse_power.f, &pwm_setting);
+}
 
 void arm() {
   gpio_put(PIN_LED_CHARGE_ON, true);
   gpio_put(PIN_LED_STATUS, true);
   armed = true;
+  picoemp_hv_enable_setting(&pwm_setting);
 }
 
 void disarm() {
@@ -50,45 +68,10 @@ void disarm() {
   gpio_put(PIN_LED_HV, false);
   gpio_put(PIN_LED_STATUS, false);
   armed = false;
+  picoemp_hv_disable();
   picoemp_shutdown_pwm();
 }
 
-static uint32_t last_charged_time = 0;
-#define HV_LED_HOLD_MS 500
-
-void picoemp_process_charging() {
-    uint32_t now = to_ms_since_boot(get_absolute_time());
-    if (armed) {
-      bool is_charged = gpio_get(PIN_IN_CHARGED);
-      
-      // Hysteresis for the LED to prevent blinking
-      if (is_charged) {
-          gpio_put(PIN_LED_HV, true);
-          last_charged_time = now;
-      } else {
-          // Only turn off if we haven't seen "charged" in the last HV_LED_HOLD_MS
-          if (now - last_charged_time > HV_LED_HOLD_MS) {
-              gpio_put(PIN_LED_HV, false);
-          }
-      }
-
-      if (!is_charged) {
-        if (!picoemp_is_pwm_enabled()) {
-          picoemp_enable_pwm(pulse_power.f);
-        }
-      } else {
-        if (picoemp_is_pwm_enabled()) {
-          picoemp_disable_pwm();
-        }
-      }
-    } else {
-      gpio_put(PIN_LED_HV, false);
-      if (picoemp_is_pwm_enabled()) {
-        picoemp_disable_pwm();
-      }
-    }
-}
-
 uint32_t get_status() {
   uint32_t result = 0;
   if (armed) {
@@ -106,10 +89,80 @@ uint32_t get_status() {
   return result;
 }
 
+static bool save_profile(const char *name) {
+  struct config_profile profile;
+  config_profile_capture(&profile, &glitcher, pulse_time, pulse_cycles, pulse_power.f, adc_get_sample_count());
+  return config_store_save(name, &profile);
+}
+
+static void apply_profile(const struct config_profile *profile) {
+  config_profile_apply(profile, &glitcher);
+  pulse_delay_cycles = glitcher.delay_before_pulse;
+  pulse_time_cycles = glitcher.pulse_width;
+  pulse_time = profile->pulse_time_us;
+  pulse_cycles = profile->pulse_cycles;
+  pulse_power.f = profile->pulse_power;
+  if (profile->pwm_freq_hz) {
+    picoemp_set_pwm_freq(profile->pwm_freq_hz);
+  }
+  update_pwm_setting();
+  glitcher_set_adc_sample_count(profile->adc_sample_count);
+  hv_sense_set_window(profile->hv_target, profile->hv_window_pct);
+}
+
+static bool load_profile(const char *name) {
+  struct config_profile profile;
+  if (!config_store_load(name, &profile)) {
+    return false;
+  }
+  apply_profile(&profile);
+  return true;
+}
+
+static uint32_t manual_pulse_cycles() {
+  return pulse_cycles ? pulse_cycles : picoemp_us_to_cycles(pulse_time);
+}
+
+static void manual_pulse() {
+  picoemp_pulse_cycles(manual_pulse_cycles());
+}
+
 void update_timeout() {
   timeout_time = delayed_by_ms(get_absolute_time(), 60 * 1000);
 }
 
+#define CAMPAIGN_CHARGE_TIMEOUT_MS 2000
+// Below the console's 1 s FIFO timeout
+#define PULSE_CHARGE_TIMEOUT_MS 800
+#define BUTTON_DEBOUNCE_US 50000
+
+static void run_campaign_attempt(const struct campaign_attempt *attempt) {
+  glitcher.delay_before_pulse = attempt->delay;
+  glitcher.pulse_width = attempt->width;
+
+  // EMP pulses need the HV circuit charged, crowbar outputs don't
+  uint16_t level = HV_SENSE_UNAVAILABLE;
+  if (glitcher.glitch_output == GlitchOutput_EMP) {
+    arm();
+    update_timeout();
+    if (!picoemp_wait_ready(CAMPAIGN_CHARGE_TIMEOUT_MS, &level)) {
+      // Don't spend the attempt on a pulse with the wrong energy
+      campaign_skip(level);
+      return;
+    }
+  }
+
+  // One line per attempt would flood the console
+  bool verbose = glitcher_verbose;
+  glitcher_verbose = false;
+  campaign_fire();
+  bool triggered = glitcher_run();
+  glitcher_verbose = verbose;
+
+  disarm();
+  campaign_record(triggered, level);
+}
+
 void fast_trigger() {
   // Choose which PIO instance to use (there are two instances)
   PIO pio = pio0;
@@ -198,16 +251,30 @@ int main() {
   gpio_set_dir(1, GPIO_OUT);
   gpio_put(1, 1);
 
-  // Run serial-console on second core
-  multicore_launch_core1(serial_console);
-
   pulse_time = PULSE_TIME_US_DEFAULT;
   pulse_power.f = PULSE_POWER_DEFAULT;
+  update_pwm_setting();
   pulse_delay_cycles = PULSE_DELAY_CYCLES_DEFAULT;
   pulse_time_cycles = PULSE_TIME_CYCLES_DEFAULT;
 
   glitcher_init();
 
+  // Restore the last saved/loaded profile before the console comes up
+  struct config_profile profile;
+  if (config_store_init() && config_store_read_boot(NULL, &profile)) {
+    apply_profile(&profile);
+  }
+
+  // Pick up a campaign interrupted by a reset or brown-out, with its setup
+  if (campaign_init(&profile)) {
+    apply_profile(&profile);
+  }
+
+  scan_job_init();
+
+  // Run serial-console on second core
+  multicore_launch_core1(serial_console);
+
 #ifdef TEST_HARDWARE
   test_hardware();
 #endif
@@ -217,6 +284,7 @@ int main() {
     while (multicore_fifo_rvalid()) {
       uint32_t command = multicore_fifo_pop_blocking();
       uint32_t val; // Fix undeclared variable
+      uint16_t level;
       switch (command) {
         case SERIAL_CMD_arm:
           arm();
@@ -228,8 +296,9 @@ int main() {
           multicore_fifo_push_blocking(return_ok);
           break;
         case SERIAL_CMD_pulse:
-          if (armed) {
-            picoemp_pulse(pulse_time);
+          // Fire as soon as the rail is back in regulation at the right level
+          if (armed && (!hvp_internal || picoemp_wait_ready(PULSE_CHARGE_TIMEOUT_MS, &level))) {
+            manual_pulse();
             update_timeout();
             disarm();
             multicore_fifo_push_blocking(return_ok);
@@ -262,10 +331,19 @@ int main() {
           break;
         case SERIAL_CMD_config_pulse_time:
           pulse_time = multicore_fifo_pop_blocking();
+          pulse_cycles = 0;
+          multicore_fifo_push_blocking(return_ok);
+          break;
+        case SERIAL_CMD_config_pulse_cycles:
+          pulse_cycles = multicore_fifo_pop_blocking();
           multicore_fifo_push_blocking(return_ok);
           break;
         case SERIAL_CMD_config_pulse_power:
           pulse_power.ui32 = multicore_fifo_pop_blocking();
+          update_pwm_setting();
+          if (armed) {
+            picoemp_hv_enable_setting(&pwm_setting);
+          }
           multicore_fifo_push_blocking(return_ok);
           break;
         case SERIAL_CMD_toggle_gp_all:
@@ -349,14 +427,148 @@ int main() {
           multicore_fifo_push_blocking(return_ok);
           break;
 
+        case SERIAL_CMD_profile_save:
+          val = multicore_fifo_pop_blocking();
+          multicore_fifo_push_blocking(save_profile((const char *)(uintptr_t)val) ? return_ok : return_failed);
+          break;
+
+        case SERIAL_CMD_profile_load:
+          val = multicore_fifo_pop_blocking();
+          multicore_fifo_push_blocking(load_profile((const char *)(uintptr_t)val) ? return_ok : return_failed);
+          break;
+
+        case SERIAL_CMD_campaign_start: {
+          val = multicore_fifo_pop_blocking();
+          if (scan_job_busy()) {
+            multicore_fifo_push_blocking(return_failed);
+            break;
+          }
+          // Journaled with the campaign, so a resume runs with the same setup
+          struct config_profile setup;
+          config_profile_capture(&setup, &glitcher, pulse_time, pulse_cycles, pulse_power.f, adc_get_sample_count());
+          bool started = campaign_start((const struct campaign_params *)(uintptr_t)val, &setup);
+          multicore_fifo_push_blocking(started ? return_ok : return_failed);
+          break;
+        }
+
+        case SERIAL_CMD_burst: {
+          struct burst_config burst = *(const struct burst_config *)(uintptr_t)multicore_fifo_pop_blocking();
+          if (!armed || !hvp_internal || !burst_valid(&burst)) {
+            multicore_fifo_push_blocking(return_failed);
+            break;
+          }
+          multicore_fifo_push_blocking(return_ok);
+          if (burst.width_cycles == 0) {
+            burst.width_cycles = manual_pulse_cycles();
+          }
+          update_timeout();
+          burst_run(&burst);
+          disarm();
+          multicore_fifo_push_blocking(return_ok);
+          break;
+        }
+
+        case SERIAL_CMD_hv_level:
+          multicore_fifo_push_blocking(return_ok);
+          multicore_fifo_push_blocking(hv_sense_read());
+          break;
+
+        case SERIAL_CMD_config_pwm_freq: {
+          uint32_t freq = multicore_fifo_pop_blocking();
+          if (freq < PICOEMP_PWM_FREQ_MIN || freq > PICOEMP_PWM_FREQ_MAX) {
+            multicore_fifo_push_blocking(return_failed);
+            break;
+          }
+          picoemp_set_pwm_freq(freq);
+          update_pwm_setting();
+          if (armed) {
+            picoemp_hv_enable_setting(&pwm_setting);
+          }
+          multicore_fifo_push_blocking(return_ok);
+          break;
+        }
+
+        case SERIAL_CMD_hv_autotune: {
+          if (!armed || !hvp_internal) {
+            multicore_fifo_push_blocking(return_failed);
+            break;
+          }
+          multicore_fifo_push_blocking(return_ok);
+          update_timeout();
+          hv_autotune_run(manual_pulse_cycles());
+          const struct hv_autotune_result *tune = hv_autotune_get_result();
+          if (tune->found) {
+            picoemp_set_pwm_freq(tune->best.freq_hz);
+            pulse_power.f = tune->best.duty;
+            pwm_setting = tune->best;
+          }
+          disarm();
+          multicore_fifo_push_blocking(return_ok);
+          break;
+        }
+
+        case SERIAL_CMD_multishot: {
+          struct multishot_config shots = *(const struct multishot_config *)(uintptr_t)multicore_fifo_pop_blocking();
+          shots.delay_cycles = glitcher.delay_before_pulse;
+          shots.width_cycles = glitcher.pulse_width;
+          shots.falling = glitcher.trigger_type == TriggersType_TRIGGER_FALLING_EDGE;
+          if (!armed || !hvp_internal || !multishot_valid(&shots)) {
+            multicore_fifo_push_blocking(return_failed);
+            break;
+          }
+          multicore_fifo_push_blocking(return_ok);
+          update_timeout();
+          multishot_run(&shots);
+          disarm();
+          multicore_fifo_push_blocking(return_ok);
+          break;
+        }
+
+        case SERIAL_CMD_scan_start: {
+          // Scans drive the channels: not while the glitcher may fire, nor
+          // while the boundary-scan sampler holds the JTAG engine
+          const struct scan_job_params *scan = (const struct scan_job_params *)(uintptr_t)multicore_fifo_pop_blocking();
+          struct campaign_status campaign;
+          campaign_get_status(&campaign);
+          if (armed || campaign.active || jtag_bsr_running()) {
+            multicore_fifo_push_blocking(return_failed);
+            break;
+          }
+          multicore_fifo_push_blocking(scan_job_start(scan) ? return_ok : return_failed);
+          break;
+        }
+
+        case SERIAL_CMD_campaign_stop:
+          campaign_stop();
+          multicore_fifo_push_blocking(return_ok);
+          break;
+
       }
     }
 
-    // Pulse
-    if (gpio_get(PIN_BTN_PULSE)) {
-      update_timeout();
-      picoemp_pulse(pulse_time);
-      disarm();
+    // One attempt per pass keeps the FIFO commands (e.g. stop) serviced
+    struct campaign_attempt attempt;
+    if (campaign_next(&attempt)) {
+      run_campaign_attempt(&attempt);
+    }
+
+    // A queued scan runs to completion here. Core 1 doesn't send commands
+    // meanwhile: console, machine mode and protocol all answer busy
+    if (!armed) {
+      scan_job_run();
+    }
+
+    // Pulse once per button press
+    bool pulse_button = gpio_get(PIN_BTN_PULSE);
+    if (pulse_button != pulse_button_down &&
+        absolute_time_diff_us(pulse_button_time, get_absolute_time()) > BUTTON_DEBOUNCE_US) {
+      pulse_button_down = pulse_button;
+      pulse_button_time = get_absolute_time();
+      if (pulse_button) {
+        update_timeout();
+        manual_pulse();
+        disarm();
+      }
     }
 
     if (gpio_get(PIN_BTN_ARM)) {
@@ -0,0 +1,102 @@
+#include "multishot.h"
+
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/pio.h"
+#include "pico/stdlib.h"
+
+#include "glitcher.h"
+#include "multishot.pio.h"
+#include "picoemp.h"
+
+// pio0 sm0 is the glitcher's, released for the run
+#define MULTISHOT_PIO pio0
+#define MULTISHOT_SM 1
+// DMA channel 0 is the glitcher's ADC capture
+#define MULTISHOT_DMA_CHANNEL 1
+
+// Holdoff, delay and width for each shot
+#define WORDS_PER_SHOT 3
+
+static struct multishot_result result;
+static volatile bool cancel = false;
+static uint32_t shot_words[MULTISHOT_MAX_SHOTS * WORDS_PER_SHOT];
+
+bool multishot_valid(const struct multishot_config *config) {
+  return config->count > 0 && config->count <= MULTISHOT_MAX_SHOTS &&
+         config->width_cycles >= EMP_MULTISHOT_WIDTH_OVERHEAD_CYCLES && config->timeout_ms > 0 &&
+         config->timeout_ms <= MULTISHOT_MAX_TIMEOUT_MS;
+}
+
+static void feed_shots(const struct multishot_config *config) {
+  uint32_t holdoff = picoemp_us_to_cycles(PICOEMP_PULSE_HOLDOFF_US);
+  for (uint32_t i = 0; i < config->count; i++) {
+    shot_words[i * WORDS_PER_SHOT] = holdoff;
+    shot_words[i * WORDS_PER_SHOT + 1] = config->delay_cycles;
+    shot_words[i * WORDS_PER_SHOT + 2] = config->width_cycles - EMP_MULTISHOT_WIDTH_OVERHEAD_CYCLES;
+  }
+
+  dma_channel_config cfg = dma_channel_get_default_config(MULTISHOT_DMA_CHANNEL);
+  channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+  channel_config_set_read_increment(&cfg, true);
+  channel_config_set_write_increment(&cfg, false);
+  channel_config_set_dreq(&cfg, pio_get_dreq(MULTISHOT_PIO, MULTISHOT_SM, true));
+  dma_channel_configure(MULTISHOT_DMA_CHANNEL, &cfg, &MULTISHOT_PIO->txf[MULTISHOT_SM], shot_words,
+                        config->count * WORDS_PER_SHOT, true);
+}
+
+void multishot_run(const struct multishot_config *config) {
+  result.count = config->count;
+  result.fired = 0;
+  result.cancelled = false;
+  cancel = false;
+
+  glitcher_release();
+  if (!pio_can_add_program(MULTISHOT_PIO, &emp_multishot_program)) {
+    return;
+  }
+  uint offset = pio_add_program(MULTISHOT_PIO, &emp_multishot_program);
+
+  gpio_set_inover(PIN_IN_TRIGGER, config->falling ? GPIO_OVERRIDE_INVERT : GPIO_OVERRIDE_NORMAL);
+  gpio_set_pulls(PIN_IN_TRIGGER, glitcher.trigger_pull_configuration == TriggerPullConfiguration_TRIGGER_PULL_UP,
+                 glitcher.trigger_pull_configuration == TriggerPullConfiguration_TRIGGER_PULL_DOWN);
+  emp_multishot_program_init(MULTISHOT_PIO, MULTISHOT_SM, offset, PIN_IN_TRIGGER, PIN_IN_CHARGED, PIN_OUT_HVPULSE);
+  feed_shots(config);
+
+  uint32_t start = time_us_32();
+  absolute_time_t deadline = make_timeout_time_ms(config->timeout_ms);
+  pio_sm_set_enabled(MULTISHOT_PIO, MULTISHOT_SM, true);
+
+  while (result.fired < config->count) {
+    if (!pio_sm_is_rx_fifo_empty(MULTISHOT_PIO, MULTISHOT_SM)) {
+      pio_sm_get(MULTISHOT_PIO, MULTISHOT_SM);
+      result.timestamps_us[result.fired++] = time_us_32() - start;
+      continue;
+    }
+    if (time_reached(deadline)) {
+      break;
+    }
+    if (cancel) {
+      result.cancelled = true;
+      break;
+    }
+    picoemp_process_charging();
+  }
+
+  // The last pulse ends a few cycles after its trigger was reported
+  busy_wait_us(1 + (config->delay_cycles + config->width_cycles) / picoemp_us_to_cycles(1));
+  pio_sm_set_enabled(MULTISHOT_PIO, MULTISHOT_SM, false);
+  pio_sm_set_pins_with_mask(MULTISHOT_PIO, MULTISHOT_SM, 0, 1u << PIN_OUT_HVPULSE);
+  dma_channel_abort(MULTISHOT_DMA_CHANNEL);
+  pio_sm_clear_fifos(MULTISHOT_PIO, MULTISHOT_SM);
+  pio_remove_program(MULTISHOT_PIO, &emp_multishot_program, offset);
+  gpio_set_inover(PIN_IN_TRIGGER, GPIO_OVERRIDE_NORMAL);
+}
+
+void multishot_cancel() {
+  cancel = true;
+}
+
+const struct multishot_result *multishot_get_result() {
+  return &result;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Trigger-driven EMP shots, run on core 0.
+ *
+ * A PIO program (multishot.pio) fires one pulse per trigger edge, up to
+ * count shots. Before re-arming on the trigger it waits out the pulse holdoff
+ * and then for the charged feedback, so an edge that arrives while the rail is
+ * still charging is ignored. The CPU only timestamps the triggers.
+ *
+ * Every run has a timeout, and multishot_cancel() ends it early: the console
+ * waits on core 0 for as long as the run lasts.
+ */
+
+#define MULTISHOT_MAX_SHOTS 256
+#define MULTISHOT_MAX_TIMEOUT_MS (10 * 60 * 1000)
+
+struct multishot_config {
+  uint32_t count;         // Shots, at most MULTISHOT_MAX_SHOTS
+  uint32_t delay_cycles;  // From the trigger edge to the pulse
+  uint32_t width_cycles;  // Pulse width (minimum 2)
+  bool falling;           // Trigger on falling instead of rising edges
+  uint32_t timeout_ms;    // Give up after this long, 1..MULTISHOT_MAX_TIMEOUT_MS
+};
+
+struct multishot_result {
+  uint32_t count;
+  uint32_t fired;
+  bool cancelled;
+  // Per shot: time in us since the run started at which core 0 saw the PIO
+  // report the trigger. It trails the edge by up to one pass of the poll
+  // loop (a few us), longer if an interrupt such as the HV regulator's runs
+  // in between, and is never early. The pulse itself is timed by the PIO,
+  // delay_cycles after the edge, whatever the CPU does.
+  uint32_t timestamps_us[MULTISHOT_MAX_SHOTS];
+};
+
+/**
+ * @brief Check a multishot configuration
+ */
+bool multishot_valid(const struct multishot_config *config);
+
+/**
+ * @brief Fire on trigger edges until count shots, the timeout or a cancel
+ * @details Takes the pulse pin and pio0 from the glitcher for the duration of
+ *          the run; the HV regulator must already be enabled.
+ * @note Blocks core 0
+ */
+void multishot_run(const struct multishot_config *config);
+
+/**
+ * @brief Stop the current run after the shot in progress (safe to call from core 1)
+ */
+void multishot_cancel();
+
+/**
+ * @brief Result of the last run (read after core 0 reported completion)
+ */
+const struct multishot_result *multishot_get_result();
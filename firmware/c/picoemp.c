@@ -1,6 +1,7 @@
 #include "picoemp.h"
 
 #include "hardware/gpio.h"
+#include "hardware/pio.h"
 #include "hardware/pwm.h"
 #include "hardware/clocks.h"
 #include "hardware/sync.h"
@@ -10,6 +11,11 @@
 #include <stdio.h>
 
 #include "board_config.h"
+#include "hv_regulator.h"
+#include "hv_sense.h"
+#include "hv_telemetry.h"
+#include "pio_shared.h"
+#include "pulse.pio.h"
 
 // Mappings to board_config via constants for compatibility
 const uint32_t PIN_IN_TRIGGER = PIN_TRIGGER;
@@ -44,9 +50,32 @@ const uint32_t PIN_BTN_ARM = _PIN_BTN_ARM;
 static bool pwm_hardware_initialized = false;
 static bool pwm_enabled = false;
 
-uint32_t pwm_set_freq_duty(uint slice_num,
-       uint chan, uint32_t f, float d)
-{
+// HV regulation, driven by the PIN_IN_CHARGED edge interrupt
+static struct hv_regulator regulator;
+static uint32_t last_charged_time = 0;
+#define HV_LED_HOLD_MS 500
+
+// Recharge timing: from PWM start until the feedback reports charged
+static uint32_t charge_start_us;
+static volatile uint32_t last_recharge_us = 0;
+static absolute_time_t last_pulse_time;
+
+// Manual pulses are generated by pio1 sm0; core 1 runs JTAG and SWD on sm1/sm2
+#define PULSE_PIO pio1
+#define PULSE_SM 0
+static int pulse_offset = -1;
+static bool pulse_external = false;
+
+// Divider, wrap and level are worked out once per setting, not per enable:
+// the enable path runs from the charged-pin interrupt
+static struct picoemp_pwm_setting pwm_setting;
+static uint32_t pwm_freq_hz = PICOEMP_PWM_FREQ_DEFAULT;
+
+// Charge telemetry: only full charge cycles count, not holding top-ups
+static struct hv_charge_stats *charge_stats;
+static volatile bool charge_from_empty = false;
+
+void picoemp_pwm_compute(uint32_t f, float d, struct picoemp_pwm_setting *setting) {
     uint32_t clock = clock_get_hz(clk_sys);
     uint32_t divider16 = clock / f / 4096 + (clock % (f * 4096) != 0);
     
@@ -54,15 +83,22 @@ uint32_t pwm_set_freq_duty(uint slice_num,
         divider16 = 16;
     
     uint32_t wrap = clock * 16 / divider16 / f - 1;
-    
-    pwm_set_clkdiv_int_frac(slice_num, divider16/16, divider16 & 0xF);
-    pwm_set_wrap(slice_num, wrap);
-    pwm_set_chan_level(slice_num, chan, (int)((float)wrap * d));
-    
-    return wrap;
+
+    setting->freq_hz = f;
+    setting->duty = d;
+    setting->div_int = divider16 / 16;
+    setting->div_frac = divider16 & 0xF;
+    setting->wrap = wrap;
+    setting->level = (uint16_t)((float)wrap * d);
 }
 
-void picoemp_enable_pwm(float duty_frac) {
+static void pwm_apply_setting(uint slice_num, uint chan, const struct picoemp_pwm_setting *setting) {
+    pwm_set_clkdiv_int_frac(slice_num, setting->div_int, setting->div_frac);
+    pwm_set_wrap(slice_num, setting->wrap);
+    pwm_set_chan_level(slice_num, chan, setting->level);
+}
+
+static void pwm_enable_setting(const struct picoemp_pwm_setting *setting) {
     uint32_t slice = pwm_gpio_to_slice_num(PIN_OUT_HVPWM);
     
     if (!pwm_hardware_initialized) {
@@ -74,7 +110,7 @@ void picoemp_enable_pwm(float duty_frac) {
 
     if (pwm_enabled) return;
 
-    pwm_set_freq_duty(slice, PWM_CHAN_A, 2500, duty_frac);
+    pwm_apply_setting(slice, PWM_CHAN_A, setting);
     pwm_set_enabled(slice, true);
     pwm_enabled = true;
 }
@@ -101,16 +137,146 @@ bool picoemp_is_pwm_enabled() {
     return pwm_enabled;
 }
 
-void picoemp_pulse(uint32_t pulse_time) {
+static void apply_regulator_action(hv_reg_action_t action) {
+    if (action == HV_REG_PWM_START) {
+        charge_start_us = time_us_32();
+        pwm_enable_setting(&pwm_setting);
+    } else if (action == HV_REG_PWM_STOP) {
+        picoemp_disable_pwm();
+        if (regulator.state == HV_REG_HOLDING && charge_from_empty) {
+            last_recharge_us = time_us_32() - charge_start_us;
+            hv_telemetry_add(charge_stats, last_recharge_us);
+        }
+        charge_from_empty = false;
+    }
+}
+
+static void charged_irq_handler() {
+    uint32_t events = gpio_get_irq_event_mask(PIN_IN_CHARGED);
+    if (events == 0) return;
+    gpio_acknowledge_irq(PIN_IN_CHARGED, events);
+    // Feed the level rather than the edge: a bounce just re-confirms the state
+    apply_regulator_action(hv_regulator_feedback(&regulator, gpio_get(PIN_IN_CHARGED)));
+}
+
+void picoemp_hv_enable_setting(const struct picoemp_pwm_setting *setting) {
     uint32_t ints = save_and_disable_interrupts();
-    gpio_put(PIN_OUT_HVPULSE, true);
-    busy_wait_us_32(pulse_time);
-    gpio_put(PIN_OUT_HVPULSE, false);
+    // A new setting takes effect on the next recharge
+    pwm_setting = *setting;
+    charge_stats = hv_telemetry_select(setting->freq_hz, setting->duty);
+    if (regulator.state == HV_REG_OFF) {
+        charge_from_empty = true;
+    }
+    apply_regulator_action(hv_regulator_enable(&regulator, gpio_get(PIN_IN_CHARGED)));
     restore_interrupts(ints);
-    sleep_ms(250);
+}
+
+void picoemp_set_pwm_freq(uint32_t freq_hz) {
+    pwm_freq_hz = freq_hz;
+}
+
+uint32_t picoemp_get_pwm_freq() {
+    return pwm_freq_hz;
+}
+
+void picoemp_get_pwm_setting(struct picoemp_pwm_setting *setting) {
+    *setting = pwm_setting;
+}
+
+void picoemp_hv_disable() {
+    uint32_t ints = save_and_disable_interrupts();
+    apply_regulator_action(hv_regulator_disable(&regulator));
+    restore_interrupts(ints);
+}
+
+bool picoemp_hv_enabled() {
+    return regulator.state != HV_REG_OFF;
+}
+
+void picoemp_process_charging() {
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    bool is_charged = gpio_get(PIN_IN_CHARGED);
+
+    if (!picoemp_hv_enabled()) {
+        gpio_put(PIN_LED_HV, false);
+        return;
+    }
+
+    // Hysteresis for the LED to prevent blinking
+    if (is_charged) {
+        gpio_put(PIN_LED_HV, true);
+        last_charged_time = now;
+    } else if (now - last_charged_time > HV_LED_HOLD_MS) {
+        // Only turn off if we haven't seen "charged" in the last HV_LED_HOLD_MS
+        gpio_put(PIN_LED_HV, false);
+    }
+
+    // Regulation happens in the interrupt; re-sampling here only covers an
+    // edge lost while interrupts were masked (e.g. during a pulse)
+    uint32_t ints = save_and_disable_interrupts();
+    apply_regulator_action(hv_regulator_feedback(&regulator, gpio_get(PIN_IN_CHARGED)));
+    restore_interrupts(ints);
+}
+
+uint32_t picoemp_us_to_cycles(uint32_t us) {
+    return (uint32_t)((uint64_t)us * clock_get_hz(clk_sys) / 1000000);
+}
+
+void picoemp_pulse_cycles(uint32_t cycles) {
+    // The pulse pin is an input driven by the external source
+    if (pulse_external) return;
+
+    if (pulse_offset < 0) {
+        pio_sm_claim(PULSE_PIO, PULSE_SM);
+        pulse_offset = pio_add_program(PULSE_PIO, &emp_pulse_program);
+    }
+    if (cycles < EMP_PULSE_OVERHEAD_CYCLES) cycles = EMP_PULSE_OVERHEAD_CYCLES;
+
+    // Re-init every time: the glitcher hands the pin to pio0 while it runs
+    emp_pulse_program_init(PULSE_PIO, PULSE_SM, pulse_offset, PIN_OUT_HVPULSE);
+    pio_sm_put_blocking(PULSE_PIO, PULSE_SM, cycles - EMP_PULSE_OVERHEAD_CYCLES);
+    pio_sm_get_blocking(PULSE_PIO, PULSE_SM);
+    last_pulse_time = get_absolute_time();
+    // The next charge cycle starts from a discharged rail
+    charge_from_empty = true;
+}
+
+void picoemp_pulse(uint32_t pulse_time) {
+    picoemp_pulse_cycles(picoemp_us_to_cycles(pulse_time));
+}
+
+bool picoemp_is_charged() {
+    // Right after a pulse the feedback may still read the old level
+    if (!time_reached(delayed_by_us(last_pulse_time, PICOEMP_PULSE_HOLDOFF_US))) {
+        return false;
+    }
+    return gpio_get(PIN_IN_CHARGED);
+}
+
+bool picoemp_wait_ready(uint32_t timeout_ms, uint16_t *level) {
+    absolute_time_t deadline = make_timeout_time_ms(timeout_ms);
+
+    while (true) {
+        if (picoemp_is_charged()) {
+            // Sample as late as possible: this is the energy the pulse gets
+            *level = hv_sense_read();
+            if (hv_sense_in_window(*level)) {
+                return true;
+            }
+        }
+        if (time_reached(deadline)) {
+            return false;
+        }
+        picoemp_process_charging();
+    }
+}
+
+uint32_t picoemp_last_recharge_us() {
+    return last_recharge_us;
 }
 
 void picoemp_configure_pulse_output() {
+    pulse_external = false;
     // Configure pulse output
     gpio_init(PIN_OUT_HVPULSE);
     gpio_set_dir(PIN_OUT_HVPULSE, GPIO_OUT);
@@ -123,6 +289,10 @@ void picoemp_configure_pulse_output() {
 }
 
 void picoemp_configure_pulse_external() {
+    pulse_external = true;
+    if (pulse_offset >= 0) {
+        pio_shared_sm_set_enabled(PULSE_PIO, PULSE_SM, false);
+    }
     // Configure pulse input
     gpio_init(PIN_OUT_HVPULSE);
     gpio_set_dir(PIN_OUT_HVPULSE, GPIO_IN);
@@ -153,6 +323,8 @@ void picoemp_init() {
     gpio_set_inover(PIN_BTN_PULSE, GPIO_OVERRIDE_INVERT);
 
 
+    hv_sense_init();
+
     // Charge-detection coming from HV side
     gpio_init(PIN_IN_CHARGED);
     gpio_set_dir(PIN_IN_CHARGED, GPIO_IN);
@@ -161,6 +333,12 @@ void picoemp_init() {
     // more logical
     gpio_set_inover(PIN_IN_CHARGED, GPIO_OVERRIDE_INVERT);
 
+    // Both edges: charged (stop pumping) and discharged (pump again)
+    hv_regulator_init(&regulator);
+    gpio_add_raw_irq_handler(PIN_IN_CHARGED, charged_irq_handler);
+    gpio_set_irq_enabled(PIN_IN_CHARGED, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+
     // Configure pulse output
     picoemp_configure_pulse_output();
 
@@ -14,12 +14,97 @@ extern const uint32_t PIN_OUT_HVPWM;
 extern const uint32_t PIN_LED_CHARGE_ON;
 extern const uint32_t PIN_BTN_ARM;
 
-void picoemp_enable_pwm(float duty_frac);
+// Charge pump PWM frequency used unless a profile or autotune picks another
+#define PICOEMP_PWM_FREQ_DEFAULT 2500
+#define PICOEMP_PWM_FREQ_MIN 500
+#define PICOEMP_PWM_FREQ_MAX 20000
+
+/**
+ * @brief A charge pump PWM setting with its hardware registers precomputed
+ */
+struct picoemp_pwm_setting {
+    uint32_t freq_hz;
+    float duty;
+    uint8_t div_int;
+    uint8_t div_frac;
+    uint16_t wrap;
+    uint16_t level;
+};
+
+/**
+ * @brief Work out divider, wrap and compare level for @p freq_hz at @p duty_frac
+ */
+void picoemp_pwm_compute(uint32_t freq_hz, float duty_frac, struct picoemp_pwm_setting *setting);
+
 void picoemp_disable_pwm();
 void picoemp_shutdown_pwm();
+
+/**
+ * @brief Start regulating the HV supply with a setting from picoemp_pwm_compute()
+ * @details Regulation runs from the charged-pin interrupt, independent of the
+ *          main loop. Calling it again only updates the setting.
+ */
+void picoemp_hv_enable_setting(const struct picoemp_pwm_setting *setting);
+
+/**
+ * @brief PWM frequency the callers compute their next setting for
+ */
+void picoemp_set_pwm_freq(uint32_t freq_hz);
+uint32_t picoemp_get_pwm_freq();
+
+/**
+ * @brief The setting the regulator currently charges with
+ */
+void picoemp_get_pwm_setting(struct picoemp_pwm_setting *setting);
+
+/**
+ * @brief Stop regulating and switch the charge pump off
+ */
+void picoemp_hv_disable();
+bool picoemp_hv_enabled();
+
+/**
+ * @brief Update the HV LED and catch up on missed feedback edges
+ */
 void picoemp_process_charging();
 bool picoemp_is_pwm_enabled();
+
+/**
+ * @brief Fire one HV pulse of @p pulse_time microseconds
+ */
 void picoemp_pulse(uint32_t pulse_time);
+
+/**
+ * @brief Fire one HV pulse generated by PIO, exact to one system clock
+ * @details Interrupts stay enabled; the call returns once the pulse is over.
+ *          Does nothing while the pulse pin is configured for an external source.
+ * @param cycles Pulse width in system clock cycles (minimum 2)
+ */
+void picoemp_pulse_cycles(uint32_t cycles);
+uint32_t picoemp_us_to_cycles(uint32_t us);
+
+// Time the feedback comparator needs to see the discharge after a pulse
+#define PICOEMP_PULSE_HOLDOFF_US 1000
+
+/**
+ * @brief Whether the HV rail is charged (always false during the holdoff after a pulse)
+ */
+bool picoemp_is_charged();
+
+/**
+ * @brief Wait until the HV rail is charged and inside the energy window
+ * @param timeout_ms Give up after this long
+ * @param level Receives the last HV level sampled (see hv_sense.h)
+ * @return false on timeout
+ */
+bool picoemp_wait_ready(uint32_t timeout_ms, uint16_t *level);
+
+/**
+ * @brief Duration of the last full charge cycle (after arming or a pulse), 0 if none yet
+ * @details Every full cycle is also added to the hv_telemetry stats of the
+ *          active PWM setting.
+ */
+uint32_t picoemp_last_recharge_us();
 void picoemp_configure_pulse_output();
 void picoemp_configure_pulse_external();
 void picoemp_init();
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "hardware/pio.h"
+
+/**
+ * State machine control for a PIO block both cores drive.
+ *
+ * pio1 runs the manual EMP pulse on core 0 next to the JTAG and SWD engines
+ * on core 1. pio_sm_set_enabled() and pio_sm_init() read-modify-write CTRL,
+ * so one core can undo the other's enable. These only touch CTRL through the
+ * atomic set/clear aliases.
+ */
+
+static inline void pio_shared_sm_set_enabled(PIO pio, uint sm, bool enabled) {
+  if (enabled) {
+    hw_set_bits(&pio->ctrl, 1u << (PIO_CTRL_SM_ENABLE_LSB + sm));
+  } else {
+    hw_clear_bits(&pio->ctrl, 1u << (PIO_CTRL_SM_ENABLE_LSB + sm));
+  }
+}
+
+/**
+ * @brief pio_sm_init() without the read-modify-write; leaves @p sm disabled
+ */
+static inline void pio_shared_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config) {
+  pio_shared_sm_set_enabled(pio, sm, false);
+  pio_sm_set_config(pio, sm, config);
+  pio_sm_clear_fifos(pio, sm);
+  pio_sm_restart(pio, sm);
+  pio_sm_clkdiv_restart(pio, sm);
+  pio_sm_exec(pio, sm, pio_encode_jmp(initial_pc));
+}
@@ -0,0 +1,101 @@
+#include "cobs.h"
+
+size_t cobs_encode(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_len) {
+  if (dst_len < COBS_ENCODED_MAX(len)) {
+    return 0;
+  }
+
+  size_t code_idx = 0;  // Where the current block's length code goes
+  size_t out = 1;
+  uint8_t code = 1;
+
+  for (size_t i = 0; i < len; i++) {
+    if (src[i] == 0) {
+      dst[code_idx] = code;
+      code_idx = out++;
+      code = 1;
+      continue;
+    }
+
+    dst[out++] = src[i];
+    code++;
+
+    // A full block of 254 data bytes has no implicit zero after it
+    if (code == 0xFF) {
+      dst[code_idx] = code;
+      code_idx = out++;
+      code = 1;
+    }
+  }
+
+  dst[code_idx] = code;
+  return out;
+}
+
+size_t cobs_decode(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_len) {
+  size_t in = 0;
+  size_t out = 0;
+
+  while (in < len) {
+    uint8_t code = src[in++];
+    if (code == 0 || in + code - 1 > len) {
+      return 0;
+    }
+
+    for (uint8_t i = 1; i < code; i++) {
+      if (out >= dst_len) {
+        return 0;
+      }
+      dst[out++] = src[in++];
+    }
+
+    // Every block except a full one or the last one ends in an implicit zero
+    if (code != 0xFF && in < len) {
+      if (out >= dst_len) {
+        return 0;
+      }
+      dst[out++] = 0;
+    }
+  }
+
+  return out;
+}
+
+uint16_t crc16_ccitt(const uint8_t *data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int b = 0; b < 8; b++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+size_t cobs_frame_encode(uint8_t *payload, size_t len, uint8_t *dst, size_t dst_len) {
+  if (dst_len < COBS_FRAME_MAX(len)) {
+    return 0;
+  }
+  uint16_t crc = crc16_ccitt(payload, len);
+  payload[len] = crc & 0xFF;
+  payload[len + 1] = crc >> 8;
+
+  dst[0] = 0;
+  size_t encoded = cobs_encode(payload, len + 2, dst + 1, dst_len - 2);
+  dst[encoded + 1] = 0;
+  return encoded + 2;
+}
+
+bool cobs_frame_decode(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_len, size_t *payload_len) {
+  size_t decoded = cobs_decode(src, len, dst, dst_len);
+  if (decoded < 2) {
+    return false;
+  }
+  decoded -= 2;
+  uint16_t crc = dst[decoded] | (dst[decoded + 1] << 8);
+  if (crc != crc16_ccitt(dst, decoded)) {
+    return false;
+  }
+  *payload_len = decoded;
+  return true;
+}
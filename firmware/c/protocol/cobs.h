@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Worst-case encoded size of a COBS block of @p len bytes
+ */
+#define COBS_ENCODED_MAX(len) ((len) + ((len) / 254) + 1)
+
+/**
+ * @brief COBS-encode a buffer
+ * @details The output never contains a zero byte, so 0x00 can be used as the
+ *          frame delimiter on the wire. No delimiter is appended.
+ * @param src The data to encode
+ * @param len Number of bytes in @p src
+ * @param dst Output buffer
+ * @param dst_len Size of @p dst, at least COBS_ENCODED_MAX(len)
+ * @return Number of bytes written, 0 if @p dst is too small
+ */
+size_t cobs_encode(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_len);
+
+/**
+ * @brief Decode a COBS block (without the trailing delimiter)
+ * @param src The encoded data
+ * @param len Number of bytes in @p src
+ * @param dst Output buffer, may be the same as @p src
+ * @param dst_len Size of @p dst
+ * @return Number of decoded bytes, 0 if the block is malformed or too large
+ */
+size_t cobs_decode(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_len);
+
+/**
+ * @brief CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) used to guard frames
+ */
+uint16_t crc16_ccitt(const uint8_t *data, size_t len);
+
+/**
+ * @brief Worst-case size of a frame carrying @p len payload bytes
+ */
+#define COBS_FRAME_MAX(len) (COBS_ENCODED_MAX((len) + 2) + 2)
+
+/**
+ * @brief Build a frame: 0x00 | COBS( payload | CRC-16 (little endian) ) | 0x00
+ * @param payload The payload, with 2 spare bytes after it for the CRC
+ * @param len Payload length
+ * @param dst Output buffer
+ * @param dst_len Size of @p dst, at least COBS_FRAME_MAX(len)
+ * @return Number of bytes written, 0 if @p dst is too small
+ */
+size_t cobs_frame_encode(uint8_t *payload, size_t len, uint8_t *dst, size_t dst_len);
+
+/**
+ * @brief Decode and check the body of a frame (without its delimiters)
+ * @param src The encoded body
+ * @param len Number of bytes in @p src
+ * @param dst Output buffer, may be the same as @p src; it also receives the CRC
+ * @param dst_len Size of @p dst
+ * @param payload_len Receives the payload length
+ * @return false if the body is malformed, too large or fails the CRC
+ */
+bool cobs_frame_decode(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_len, size_t *payload_len);
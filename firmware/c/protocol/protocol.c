@@ -0,0 +1,548 @@
+#include "protocol.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pb_decode.h"
+#include "pb_encode.h"
+
+#include "blueTag_api.h"
+#include "cobs.h"
+#include "core_link.h"
+#include "faultycat.pb.h"
+#include "glitcher.h"
+#include "jtag_bsr.h"
+#include "jtag_pio.h"
+#include "picoemp.h"
+#include "scan_job.h"
+#include "serial.h"
+#include "swd_mem.h"
+#include "swd_pio.h"
+
+// Inter-byte timeout once a frame has started
+#define PROTOCOL_BYTE_TIMEOUT_US 100000
+
+static uint8_t frame_buffer[COBS_FRAME_MAX(PROTOCOL_MAX_PAYLOAD)];
+static uint8_t payload_buffer[PROTOCOL_MAX_PAYLOAD + 2];
+
+static faultycat_Request request;
+static faultycat_Response response;
+
+bool protocol_send_frame(const uint8_t *payload, size_t len) {
+  if (len > PROTOCOL_MAX_PAYLOAD) {
+    return false;
+  }
+
+  memcpy(payload_buffer, payload, len);
+  size_t framed = cobs_frame_encode(payload_buffer, len, frame_buffer, sizeof(frame_buffer));
+
+  // Raw write: no CR/LF translation inside the frame
+  stdio_flush();
+  stdio_put_string((const char *)frame_buffer, framed, false, false);
+  stdio_flush();
+  return true;
+}
+
+static void send_response() {
+  static uint8_t encoded[faultycat_Response_size];
+  pb_ostream_t stream = pb_ostream_from_buffer(encoded, sizeof(encoded));
+  if (!pb_encode(&stream, faultycat_Response_fields, &response)) {
+    return;
+  }
+  protocol_send_frame(encoded, stream.bytes_written);
+}
+
+static faultycat_ResultCode handle_configure(const faultycat_ConfigureRequest *req) {
+  if (req->has_trigger_type) {
+    if (req->trigger_type > TriggersType_TRIGGER_PULSE_NEGATIVE && req->trigger_type != TriggersType_TRIGGER_SERIAL) {
+      return faultycat_ResultCode_RESULT_INVALID;
+    }
+    glitcher.trigger_type = (TriggersType)req->trigger_type;
+  }
+  if (req->has_trigger_pull) {
+    if (req->trigger_pull > TriggerPullConfiguration_TRIGGER_PULL_DOWN) {
+      return faultycat_ResultCode_RESULT_INVALID;
+    }
+    glitcher.trigger_pull_configuration = (TriggerPullConfiguration)req->trigger_pull;
+  }
+  if (req->has_glitch_output) {
+    if (req->glitch_output > GlitchOutput_EMP) {
+      return faultycat_ResultCode_RESULT_INVALID;
+    }
+    glitcher.glitch_output = (GlitchOutput_t)req->glitch_output;
+  }
+  if (req->has_delay_before_pulse) {
+    glitcher.delay_before_pulse = req->delay_before_pulse;
+  }
+  if (req->has_pulse_width) {
+    if (req->pulse_width == 0) {
+      return faultycat_ResultCode_RESULT_INVALID;
+    }
+    glitcher.pulse_width = req->pulse_width;
+  }
+  if (req->has_serial_pin) {
+    if (req->serial_pin != 1 && req->serial_pin != 5) {
+      return faultycat_ResultCode_RESULT_INVALID;
+    }
+    glitcher.serial_pin = req->serial_pin;
+  }
+  if (req->has_serial_baud) {
+    if (req->serial_baud < 300 || req->serial_baud > 1000000) {
+      return faultycat_ResultCode_RESULT_INVALID;
+    }
+    glitcher.serial_baud = req->serial_baud;
+  }
+  if (req->has_serial_pattern) {
+    strncpy(glitcher.serial_pattern, req->serial_pattern, sizeof(glitcher.serial_pattern) - 1);
+  }
+  if (req->has_adc_sample_count && !glitcher_set_adc_sample_count(req->adc_sample_count)) {
+    return faultycat_ResultCode_RESULT_INVALID;
+  }
+
+  if (!core_link_sync_glitcher()) {
+    return faultycat_ResultCode_RESULT_TIMEOUT;
+  }
+  if (req->has_pulse_time_us && !core_link_call_arg(SERIAL_CMD_config_pulse_time, req->pulse_time_us, NULL)) {
+    return faultycat_ResultCode_RESULT_TIMEOUT;
+  }
+  if (req->has_pulse_power) {
+    union {
+      float f;
+      uint32_t ui32;
+    } power = {.f = req->pulse_power};
+    if (!core_link_call_arg(SERIAL_CMD_config_pulse_power, power.ui32, NULL)) {
+      return faultycat_ResultCode_RESULT_TIMEOUT;
+    }
+  }
+  return faultycat_ResultCode_RESULT_OK;
+}
+
+static faultycat_ResultCode handle_glitch(const faultycat_GlitchRequest *req) {
+  uint32_t result;
+
+  if (req->arm && !core_link_call(SERIAL_CMD_arm, NULL)) {
+    return faultycat_ResultCode_RESULT_TIMEOUT;
+  }
+  if (!core_link_call(SERIAL_CMD_glitch, &result) || result != return_ok) {
+    return faultycat_ResultCode_RESULT_FAILED;
+  }
+
+  // Core 0 answers a second time once the trigger fired or timed out
+  core_link_read(0, &result);
+
+  response.which_payload = faultycat_Response_glitch_tag;
+  response.payload.glitch.triggered = (result == return_ok);
+  return faultycat_ResultCode_RESULT_OK;
+}
+
+static faultycat_ResultCode handle_status() {
+  uint32_t result;
+  uint32_t status;
+
+  if (!core_link_call(SERIAL_CMD_status, &result) || result != return_ok ||
+      !core_link_read(1000000, &status)) {
+    return faultycat_ResultCode_RESULT_TIMEOUT;
+  }
+
+  faultycat_StatusResponse *out = &response.payload.status;
+  response.which_payload = faultycat_Response_status_tag;
+  out->armed = (status >> 0) & 1;
+  out->charged = (status >> 1) & 1;
+  out->timeout_active = (status >> 2) & 1;
+  out->hvp_internal = (status >> 3) & 1;
+  out->trigger_type = glitcher.trigger_type;
+  out->trigger_pull = glitcher.trigger_pull_configuration;
+  out->glitch_output = glitcher.glitch_output;
+  out->delay_before_pulse = glitcher.delay_before_pulse;
+  out->pulse_width = glitcher.pulse_width;
+  out->adc_sample_count = adc_get_sample_count();
+  out->has_recharge_us = true;
+  out->recharge_us = picoemp_last_recharge_us();
+  return faultycat_ResultCode_RESULT_OK;
+}
+
+static faultycat_ResultCode handle_capture(const faultycat_CaptureRequest *req) {
+  uint32_t total = adc_get_sample_count();
+  uint32_t offset = req->offset;
+  uint32_t length = req->has_length ? req->length : sizeof(response.payload.capture.data.bytes);
+
+  if (offset > total) {
+    return faultycat_ResultCode_RESULT_INVALID;
+  }
+  if (length > total - offset) {
+    length = total - offset;
+  }
+  if (length > sizeof(response.payload.capture.data.bytes)) {
+    length = sizeof(response.payload.capture.data.bytes);
+  }
+
+  faultycat_CaptureResponse *out = &response.payload.capture;
+  response.which_payload = faultycat_Response_capture_tag;
+  out->offset = offset;
+  out->total = total;
+  out->data.size = length;
+  memcpy(out->data.bytes, adc_get_capture_buffer() + offset, length);
+  return faultycat_ResultCode_RESULT_OK;
+}
+
+static faultycat_ResultCode handle_scan(const faultycat_ScanRequest *req) {
+  struct scan_job_params params = {
+      .type = (req->type == faultycat_ScanType_SCAN_JTAG) ? SCAN_JOB_JTAG : SCAN_JOB_SWD,
+      .channels = req->channels,
+      .pulse_pins = req->has_pulse_pins ? req->pulse_pins : jPulsePins,
+      .quick_probe = req->has_quick_probe ? req->quick_probe : jQuickProbe,
+      .verify = req->verify,
+  };
+  if (!scan_job_valid(&params)) {
+    return faultycat_ResultCode_RESULT_INVALID;
+  }
+
+  // Runs on core 0 like a console scan; the answer waits for the results
+  uint32_t result;
+  if (!core_link_call_arg(SERIAL_CMD_scan_start, (uint32_t)(uintptr_t)&params, &result)) {
+    return faultycat_ResultCode_RESULT_TIMEOUT;
+  }
+  if (result != return_ok) {
+    return faultycat_ResultCode_RESULT_FAILED;
+  }
+  struct scan_job_status status;
+  do {
+    sleep_ms(SCAN_JOB_EVENT_INTERVAL_MS);
+    scan_job_get_status(&status);
+  } while (status.state != SCAN_JOB_DONE && status.state != SCAN_JOB_CANCELLED);
+  if (status.state == SCAN_JOB_CANCELLED) {
+    return faultycat_ResultCode_RESULT_FAILED;
+  }
+
+  faultycat_ScanResponse *out = &response.payload.scan;
+  response.which_payload = faultycat_Response_scan_tag;
+  out->found = status.found;
+  out->has_cached = true;
+  out->cached = status.cached;
+
+  if (req->type == faultycat_ScanType_SCAN_JTAG) {
+    if (out->found) {
+      out->has_tdi = out->has_tdo = out->has_tck = out->has_tms = true;
+      out->tdi = xTDI;
+      out->tdo = xTDO;
+      out->tck = xTCK;
+      out->tms = xTMS;
+      out->has_trst = (xTRST != 0);
+      out->trst = xTRST;
+      out->idcodes_count = jDeviceCount;
+      memcpy(out->idcodes, deviceIDs, jDeviceCount * sizeof(uint32_t));
+
+      out->chains_count = MIN(jtagChainCount, count_of(out->chains));
+      for (uint i = 0; i < out->chains_count; i++) {
+        const struct bluetag_jtag_chain *chain = &jtagChains[i];
+        faultycat_JtagChain *dst = &out->chains[i];
+        dst->tdi = chain->tdi;
+        dst->tdo = chain->tdo;
+        dst->tck = chain->tck;
+        dst->tms = chain->tms;
+        dst->has_trst = (chain->trst != 0);
+        dst->trst = chain->trst;
+        dst->ir_total = chain->ir_total;
+        uint devices = MIN(chain->device_count, count_of(dst->idcodes));
+        dst->idcodes_count = dst->ir_lengths_count = devices;
+        for (uint x = 0; x < devices; x++) {
+          dst->idcodes[x] = chain->idcodes[x];
+          dst->ir_lengths[x] = chain->ir_lengths[x];
+        }
+      }
+    }
+  } else {
+    if (out->found) {
+      out->has_swdio = out->has_swclk = true;
+      out->swdio = xSwdIO;
+      out->swclk = xSwdClk;
+      out->idcodes_count = 1;
+      out->idcodes[0] = swdIdcode;
+
+      uint count = MIN(swdTargetCount, count_of(out->swd_targets));
+      out->swd_targets_count = count;
+      for (uint i = 0; i < count; i++) {
+        const struct bluetag_swd_target *target = &swdTargets[i];
+        faultycat_SwdTarget *dp = &out->swd_targets[i];
+        dp->swclk = target->swclk;
+        dp->swdio = target->swdio;
+        dp->dpidr = target->dpidr;
+        dp->has_targetid = target->has_targetid;
+        dp->targetid = target->targetid;
+        dp->has_targetsel = target->multidrop;
+        dp->targetsel = target->targetsel;
+      }
+    }
+  }
+  return faultycat_ResultCode_RESULT_OK;
+}
+
+static void bsr_status(faultycat_BsrResponse *out) {
+  struct jtag_bsr_status status;
+  jtag_bsr_get_status(&status);
+  out->running = status.running;
+  out->bsr_length = status.bsr_length;
+  out->period_clocks = status.period_clocks;
+  out->samples = status.samples;
+  out->sample_rate = status.sample_rate;
+}
+
+static faultycat_ResultCode bsr_start(const faultycat_BsrRequest *req) {
+  const struct bluetag_jtag_chain *chain = &jtagChains[0];
+  if (jtagChainCount == 0 || !chain->ir_exact || !req->has_opcode || req->device >= chain->device_count ||
+      (req->has_clock_hz && req->clock_hz == 0)) {
+    return faultycat_ResultCode_RESULT_INVALID;
+  }
+  struct jtag_bsr_target target = {
+      .tdi = channelGpio[chain->tdi],
+      .tdo = channelGpio[chain->tdo],
+      .tck = channelGpio[chain->tck],
+      .tms = channelGpio[chain->tms],
+      .device = req->device,
+      .device_count = chain->device_count,
+      .ir_lengths = chain->ir_lengths,
+      .opcode = req->opcode,
+      .bsr_length = req->has_bsr_length ? req->bsr_length : 0,
+  };
+
+  // The loop keeps the divider it started with
+  uint32_t clock_hz = jtag_pio_get_clock();
+  if (req->has_clock_hz) {
+    jtag_pio_set_clock(req->clock_hz);
+  }
+  bool started = jtag_bsr_start(&target);
+  jtag_pio_set_clock(clock_hz);
+  return started ? faultycat_ResultCode_RESULT_OK : faultycat_ResultCode_RESULT_FAILED;
+}
+
+// Whole samples per chunk; waits for new ones while the sampler runs
+static faultycat_ResultCode bsr_read(const faultycat_BsrRequest *req, faultycat_BsrResponse *out) {
+  struct jtag_bsr_status status;
+  jtag_bsr_get_status(&status);
+  if (status.bsr_length == 0) {
+    return faultycat_ResultCode_RESULT_FAILED;  // Never started
+  }
+
+  // data.bytes has no alignment guarantee
+  static uint32_t words[sizeof(out->data.bytes) / sizeof(uint32_t)];
+  uint32_t stride = JTAG_BSR_SAMPLE_WORDS(status.bsr_length);
+  uint32_t per_chunk = count_of(words) / stride;
+
+  // Live: from the next sample on. Stopped: the newest ones in the ring
+  uint32_t next = status.samples;
+  if (!status.running) {
+    next = status.samples > req->samples ? status.samples - req->samples : 0;
+  }
+  uint32_t end = next + req->samples;
+  uint32_t dropped = 0;
+  while (true) {
+    uint32_t first = next;
+    uint32_t count = jtag_bsr_read(&first, words, MIN(per_chunk, end - next));
+    if (first > next) {
+      dropped += MIN(first, end) - next;
+    }
+    if (first >= end) {
+      count = 0;
+    } else if (first + count > end) {
+      count = end - first;
+    }
+    next = MAX(next, first + count);
+    if (next < end && count == 0) {
+      if (jtag_bsr_running()) {
+        sleep_us(100);
+        continue;
+      }
+      next = end;  // Stopped: nothing more will come
+    }
+
+    bsr_status(out);
+    out->has_first = out->has_data = out->has_dropped = out->has_last = true;
+    out->first = first;
+    out->data.size = count * stride * sizeof(uint32_t);
+    memcpy(out->data.bytes, words, out->data.size);
+    out->dropped = dropped;
+    out->last = next >= end;
+    if (out->last) {
+      return faultycat_ResultCode_RESULT_OK;
+    }
+    response.result = faultycat_ResultCode_RESULT_OK;
+    send_response();
+  }
+}
+
+static faultycat_ResultCode handle_bsr(const faultycat_BsrRequest *req) {
+  faultycat_BsrResponse *out = &response.payload.bsr;
+  response.which_payload = faultycat_Response_bsr_tag;
+  faultycat_ResultCode result = faultycat_ResultCode_RESULT_OK;
+  switch (req->action) {
+    case faultycat_BsrAction_BSR_START:
+      result = bsr_start(req);
+      break;
+    case faultycat_BsrAction_BSR_STOP:
+      jtag_bsr_stop();
+      break;
+    case faultycat_BsrAction_BSR_STATUS:
+      break;
+    case faultycat_BsrAction_BSR_READ:
+      return bsr_read(req, out);
+    default:
+      return faultycat_ResultCode_RESULT_INVALID;
+  }
+  bsr_status(out);
+  return result;
+}
+
+static faultycat_ResultCode handle_memory(const faultycat_MemoryRequest *req) {
+  struct swd_mem_target target = {.apsel = req->apsel};
+  if (req->has_swclk && req->has_swdio) {
+    target.swclk = req->swclk;
+    target.swdio = req->swdio;
+  } else if (swdTargetCount > 0) {
+    target.swclk = swdTargets[0].swclk;
+    target.swdio = swdTargets[0].swdio;
+    target.multidrop = swdTargets[0].multidrop;
+    target.targetsel = swdTargets[0].targetsel;
+  } else {
+    return faultycat_ResultCode_RESULT_INVALID;
+  }
+  if (req->has_targetsel) {
+    target.multidrop = true;
+    target.targetsel = req->targetsel;
+  }
+  if (target.swclk >= maxChannels || target.swdio >= maxChannels || target.swclk == target.swdio ||
+      req->apsel > 0xFF || (req->address & 3) != 0 || (req->has_clock_hz && req->clock_hz == 0)) {
+    return faultycat_ResultCode_RESULT_INVALID;
+  }
+  target.swclk = channelGpio[target.swclk];
+  target.swdio = channelGpio[target.swdio];
+
+  uint32_t clock_hz = swd_pio_get_clock();
+  if (req->has_clock_hz) {
+    swd_pio_set_clock(req->clock_hz);
+  }
+
+  faultycat_MemoryResponse *out = &response.payload.memory;
+  response.which_payload = faultycat_Response_memory_tag;
+  out->address = req->address;
+  out->last = true;
+
+  if (!swd_mem_begin(&target)) {
+    swd_pio_set_clock(clock_hz);
+    return faultycat_ResultCode_RESULT_FAILED;
+  }
+
+  // data.bytes has no alignment guarantee
+  static uint32_t words[sizeof(out->data.bytes) / sizeof(uint32_t)];
+  faultycat_ResultCode result = faultycat_ResultCode_RESULT_OK;
+  uint32_t address = req->address;
+  uint32_t bytes_left = req->length;
+  uint32_t words_left = (req->length + 3) / 4;
+  while (true) {
+    uint32_t count = MIN(words_left, count_of(words));
+    uint32_t done = swd_mem_read(address, words, count);
+    if (done < count) {
+      result = faultycat_ResultCode_RESULT_FAILED;
+    }
+
+    // The target is read in whole words, the last one is cut to the length
+    out->address = address;
+    out->data.size = MIN(done * sizeof(uint32_t), bytes_left);
+    memcpy(out->data.bytes, words, out->data.size);
+    address += done * sizeof(uint32_t);
+    bytes_left -= out->data.size;
+    words_left -= done;
+
+    out->last = words_left == 0 || result != faultycat_ResultCode_RESULT_OK;
+    if (out->last) {
+      break;
+    }
+    response.result = faultycat_ResultCode_RESULT_OK;
+    send_response();
+  }
+
+  swd_mem_end();
+  swd_pio_set_clock(clock_hz);
+  return result;
+}
+
+static void handle_request() {
+  response = (faultycat_Response)faultycat_Response_init_zero;
+  response.id = request.id;
+
+  // A scan started from the console holds core 0 and the JTAG/SWD engines
+  // until it's done; a request queued behind it would stall the link
+  if (scan_job_busy()) {
+    response.result = faultycat_ResultCode_RESULT_BUSY;
+    send_response();
+    return;
+  }
+
+  switch (request.which_payload) {
+    case faultycat_Request_configure_tag:
+      response.result = handle_configure(&request.payload.configure);
+      break;
+    case faultycat_Request_glitch_tag:
+      response.result = handle_glitch(&request.payload.glitch);
+      break;
+    case faultycat_Request_status_tag:
+      response.result = handle_status();
+      break;
+    case faultycat_Request_capture_tag:
+      response.result = handle_capture(&request.payload.capture);
+      break;
+    case faultycat_Request_scan_tag:
+      response.result = handle_scan(&request.payload.scan);
+      break;
+    case faultycat_Request_memory_tag:
+      response.result = handle_memory(&request.payload.memory);
+      break;
+    case faultycat_Request_bsr_tag:
+      response.result = handle_bsr(&request.payload.bsr);
+      break;
+    default:
+      response.result = faultycat_ResultCode_RESULT_INVALID;
+      break;
+  }
+
+  send_response();
+}
+
+bool protocol_receive_frame() {
+  size_t len = 0;
+
+  while (true) {
+    int c = getchar_timeout_us(PROTOCOL_BYTE_TIMEOUT_US);
+    if (c == PICO_ERROR_TIMEOUT) {
+      return false;
+    }
+    if (c == PROTOCOL_FRAME_DELIMITER) {
+      // Back-to-back delimiters are idle filler, keep waiting for data
+      if (len == 0) {
+        continue;
+      }
+      break;
+    }
+    if (len >= sizeof(frame_buffer)) {
+      return false;
+    }
+    frame_buffer[len++] = (uint8_t)c;
+  }
+
+  size_t decoded;
+  if (!cobs_frame_decode(frame_buffer, len, payload_buffer, sizeof(payload_buffer), &decoded)) {
+    return false;
+  }
+
+  request = (faultycat_Request)faultycat_Request_init_zero;
+  pb_istream_t stream = pb_istream_from_buffer(payload_buffer, decoded);
+  if (!pb_decode(&stream, faultycat_Request_fields, &request)) {
+    response = (faultycat_Response)faultycat_Response_init_zero;
+    response.result = faultycat_ResultCode_RESULT_DECODE_ERROR;
+    send_response();
+    return false;
+  }
+
+  handle_request();
+  return true;
+}
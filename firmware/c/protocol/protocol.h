@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Binary control channel
+ *
+ * Runs alongside the text console on the same USB CDC port. A frame on the
+ * wire is:
+ *
+ *   0x00 | COBS( protobuf message | CRC-16 (little endian) ) | 0x00
+ *
+ * The leading 0x00 tells the console to hand the bytes to this module;
+ * a human never types it. Requests are faultycat.Request messages and every
+ * request is answered with one faultycat.Response (see proto/faultycat.proto).
+ * Text printed by the firmware between frames is not part of any frame and
+ * fails the CRC check, so hosts can simply drop it.
+ */
+
+#define PROTOCOL_FRAME_DELIMITER 0x00
+#define PROTOCOL_MAX_PAYLOAD 640
+
+/**
+ * @brief Receive one frame after the leading delimiter, run it and reply
+ * @details Called by the console when it reads PROTOCOL_FRAME_DELIMITER.
+ * @return true if a well-formed request was handled
+ */
+bool protocol_receive_frame();
+
+/**
+ * @brief Frame and send a payload
+ * @param payload The encoded message
+ * @param len Payload length, at most PROTOCOL_MAX_PAYLOAD
+ * @return false if the payload is too large
+ */
+bool protocol_send_frame(const uint8_t *payload, size_t len);
@@ -0,0 +1,139 @@
+#include "pinout_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hardware/sync.h"
+
+#include "config_log.h"
+#include "flash_layout.h"
+#include "flash_rp2040.h"
+#include "scan_job.h"
+
+#define KIND_PINOUT 1
+
+static const struct config_log_flash flash_ops = {
+    .base = FLASH_PINOUT_OFFSET,
+    .size = FLASH_PINOUT_SECTORS * FLASH_SECTOR_SIZE,
+    .sector_size = FLASH_SECTOR_SIZE,
+    .read = flash_rp2040_read,
+    .erase = flash_rp2040_erase,
+    .program = flash_rp2040_program,
+};
+
+static struct config_log cache_log;
+static bool mounted = false;
+
+static struct pinout_cache_entry entries[PINOUT_CACHE_MAX];
+static uint32_t entry_count;
+static uint32_t last_seq;
+static spin_lock_t *entries_lock;
+
+// One record per pinout: finding the same pins again replaces the entry
+static void entry_name(const struct pinout_cache_entry *entry, char name[CONFIG_LOG_NAME_LEN + 1]) {
+  if (entry->type == SCAN_JOB_JTAG) {
+    snprintf(name, CONFIG_LOG_NAME_LEN + 1, "j%u.%u.%u.%u", entry->tck, entry->tms, entry->tdi, entry->tdo);
+  } else if (entry->multidrop) {
+    snprintf(name, CONFIG_LOG_NAME_LEN + 1, "s%u.%u.%lx", entry->swclk, entry->swdio, entry->targetsel >> 28);
+  } else {
+    snprintf(name, CONFIG_LOG_NAME_LEN + 1, "s%u.%u", entry->swclk, entry->swdio);
+  }
+}
+
+static int find_entry(const char *name) {
+  char other[CONFIG_LOG_NAME_LEN + 1];
+  for (uint32_t i = 0; i < entry_count; i++) {
+    entry_name(&entries[i], other);
+    if (strcmp(name, other) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void load_visitor(uint8_t kind, const char *name, uint16_t length, void *ctx) {
+  struct pinout_cache_entry entry;
+  memset(&entry, 0, sizeof(entry));
+  int len = config_log_read(&cache_log, KIND_PINOUT, name, &entry, sizeof(entry));
+  if (len < 4 || len > (int)sizeof(entry) || entry.size != len || entry.version > PINOUT_CACHE_VERSION ||
+      entry_count >= PINOUT_CACHE_MAX) {
+    return;
+  }
+  entries[entry_count++] = entry;
+  if (entry.seq > last_seq) {
+    last_seq = entry.seq;
+  }
+}
+
+bool pinout_cache_init() {
+  entries_lock = spin_lock_init(spin_lock_claim_unused(true));
+  entry_count = 0;
+  last_seq = 0;
+  mounted = config_log_init(&cache_log, &flash_ops);
+  if (mounted) {
+    config_log_list(&cache_log, KIND_PINOUT, load_visitor, NULL);
+  }
+  return mounted;
+}
+
+bool pinout_cache_save(struct pinout_cache_entry *entry) {
+  if (!mounted) {
+    return false;
+  }
+  entry->version = PINOUT_CACHE_VERSION;
+  entry->size = sizeof(*entry);
+  entry->seq = ++last_seq;
+
+  char name[CONFIG_LOG_NAME_LEN + 1];
+  entry_name(entry, name);
+  int slot = find_entry(name);
+  if (slot < 0 && entry_count == PINOUT_CACHE_MAX) {
+    // Full: the least recently found pinout makes room
+    slot = 0;
+    for (uint32_t i = 1; i < entry_count; i++) {
+      if (entries[i].seq < entries[slot].seq) {
+        slot = i;
+      }
+    }
+    char evicted[CONFIG_LOG_NAME_LEN + 1];
+    entry_name(&entries[slot], evicted);
+    config_log_delete(&cache_log, KIND_PINOUT, evicted);
+  }
+  if (!config_log_write(&cache_log, KIND_PINOUT, name, entry, sizeof(*entry))) {
+    return false;
+  }
+
+  uint32_t save = spin_lock_blocking(entries_lock);
+  if (slot < 0) {
+    slot = entry_count++;
+  }
+  entries[slot] = *entry;
+  spin_unlock(entries_lock, save);
+  return true;
+}
+
+uint32_t pinout_cache_get(uint32_t type, struct pinout_cache_entry *out, uint32_t max) {
+  uint32_t count = 0;
+  uint32_t save = spin_lock_blocking(entries_lock);
+  for (uint32_t i = 0; i < entry_count; i++) {
+    if (type != PINOUT_CACHE_ANY && entries[i].type != type) {
+      continue;
+    }
+    // Insertion by seq, most recent first
+    uint32_t at = count;
+    while (at > 0 && out[at - 1].seq < entries[i].seq) {
+      if (at < max) {
+        out[at] = out[at - 1];
+      }
+      at--;
+    }
+    if (at < max) {
+      out[at] = entries[i];
+    }
+    if (count < max) {
+      count++;
+    }
+  }
+  spin_unlock(entries_lock, save);
+  return count;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Pinouts found by full JTAG/SWD scans, kept in flash so a target that is
+ * plugged in again can be checked with a single IDCODE/DPIDR read.
+ *
+ * Entries are records of a config_log; the same pinout found again replaces
+ * its entry, and the least recent one is dropped once PINOUT_CACHE_MAX are
+ * stored. A RAM copy serves the readers, so core 1 never touches the flash.
+ */
+
+#define PINOUT_CACHE_MAX 8
+#define PINOUT_CACHE_VERSION 1
+#define PINOUT_CACHE_ANY 0xFF  // Type filter for pinout_cache_get()
+
+/**
+ * Stored as-is in flash: only append fields and bump PINOUT_CACHE_VERSION.
+ */
+struct pinout_cache_entry {
+  uint16_t version;
+  uint16_t size;
+  uint32_t seq;     // Set by pinout_cache_save(), most recent is highest
+  uint8_t type;     // enum scan_job_type
+  uint8_t channels; // Channel count of the scan that found it
+
+  // JTAG, channel numbers. trst 0 = none, like xTRST
+  uint8_t tdi;
+  uint8_t tdo;
+  uint8_t tck;
+  uint8_t tms;
+  uint8_t trst;
+
+  // SWD, channel numbers and the DP to select
+  uint8_t swclk;
+  uint8_t swdio;
+  uint8_t multidrop;
+  uint8_t has_targetid;
+  uint32_t targetid;
+  uint32_t targetsel;
+
+  uint32_t id;  // IDCODE of the first TAP, or DPIDR
+};
+
+/**
+ * @brief Mount the cache and load it to RAM
+ * @note Core 0 only (may format the region)
+ */
+bool pinout_cache_init();
+
+/**
+ * @brief Store a pinout as the most recent one
+ * @note Core 0 only (writes to flash)
+ */
+bool pinout_cache_save(struct pinout_cache_entry *entry);
+
+/**
+ * @brief Copy the cached pinouts of a type, most recent first
+ * @param type enum scan_job_type or PINOUT_CACHE_ANY
+ * @return Number of entries copied (safe to call from core 1)
+ */
+uint32_t pinout_cache_get(uint32_t type, struct pinout_cache_entry *entries, uint32_t max);
@@ -0,0 +1,234 @@
+#include "scan_job.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hardware/sync.h"
+#include "pico/stdlib.h"
+
+// blueTag.h carries its definitions: this is the only file including it
+#include "blueTag.h"
+#include "pinout_cache.h"
+
+static struct scan_job_status state;
+static spin_lock_t *state_lock;
+
+static uint64_t started_us;
+static uint64_t published_us;
+
+static uint32_t elapsed_ms() {
+  return (time_us_64() - started_us) / 1000;
+}
+
+// printProgress() lands here for every permutation: only publish an event
+// when the interval is up, or when a phase completes
+static void publish_progress(size_t count, size_t max) {
+  uint64_t now = time_us_64();
+  if (count < max && now - published_us < SCAN_JOB_EVENT_INTERVAL_MS * 1000) {
+    return;
+  }
+  published_us = now;
+
+  uint32_t save = spin_lock_blocking(state_lock);
+  state.progress = count;
+  state.total = max;
+  state.elapsed_ms = elapsed_ms();
+  state.event++;
+  spin_unlock(state_lock, save);
+}
+
+static void finish(uint32_t final_state, bool found, bool cached) {
+  uint32_t save = spin_lock_blocking(state_lock);
+  state.state = final_state;
+  state.found = found;
+  state.cached = cached;
+  state.elapsed_ms = elapsed_ms();
+  state.event++;
+  spin_unlock(state_lock, save);
+}
+
+// Try the cached pinouts of the job's type, most recent first
+static bool verify_cached(const struct scan_job_params *params) {
+  struct pinout_cache_entry cached[PINOUT_CACHE_MAX];
+  uint32_t count = pinout_cache_get(params->type, cached, count_of(cached));
+  for (uint32_t i = 0; i < count && !scanCancel; i++) {
+    const struct pinout_cache_entry *entry = &cached[i];
+    if (entry->channels > maxChannels) {
+      continue;  // Saved with another channel map
+    }
+    if (entry->type == SCAN_JOB_JTAG) {
+      if (jtagVerifyPinout(entry->channels, entry->tdi, entry->tdo, entry->tck, entry->tms, entry->trst, entry->id)) {
+        return true;
+      }
+    } else {
+      struct bluetag_swd_target target = {
+          .swclk = entry->swclk,
+          .swdio = entry->swdio,
+          .dpidr = entry->id,
+          .targetid = entry->targetid,
+          .targetsel = entry->targetsel,
+          .has_targetid = entry->has_targetid,
+          .multidrop = entry->multidrop,
+      };
+      if (swdVerifyTarget(&target)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static void save_pinout(const struct scan_job_params *params) {
+  struct pinout_cache_entry entry;
+  memset(&entry, 0, sizeof(entry));
+  entry.type = params->type;
+  entry.channels = params->channels;
+  if (params->type == SCAN_JOB_JTAG) {
+    entry.tdi = xTDI;
+    entry.tdo = xTDO;
+    entry.tck = xTCK;
+    entry.tms = xTMS;
+    entry.trst = xTRST;
+    entry.id = deviceIDs[0];
+  } else {
+    const struct bluetag_swd_target *target = &swdTargets[0];
+    entry.swclk = target->swclk;
+    entry.swdio = target->swdio;
+    entry.multidrop = target->multidrop;
+    entry.has_targetid = target->has_targetid;
+    entry.targetid = target->targetid;
+    entry.targetsel = target->targetsel;
+    entry.id = target->dpidr;
+  }
+  pinout_cache_save(&entry);
+}
+
+void scan_job_init() {
+  state_lock = spin_lock_init(spin_lock_claim_unused(true));
+  state.state = SCAN_JOB_IDLE;
+  initChannels();
+  pinout_cache_init();
+}
+
+bool scan_job_valid(const struct scan_job_params *params) {
+  uint32_t min_channels;
+  switch (params->type) {
+    case SCAN_JOB_JTAG:
+      min_channels = 4;
+      break;
+    case SCAN_JOB_SWD:
+      min_channels = 2;
+      break;
+    default:
+      return false;
+  }
+  return params->channels >= min_channels && params->channels <= maxChannels;
+}
+
+bool scan_job_start(const struct scan_job_params *params) {
+  if (!scan_job_valid(params)) {
+    return false;
+  }
+
+  uint32_t save = spin_lock_blocking(state_lock);
+  bool busy = state.state == SCAN_JOB_PENDING || state.state == SCAN_JOB_RUNNING;
+  if (!busy) {
+    state.state = SCAN_JOB_PENDING;
+    state.params = *params;
+    state.id++;
+    state.event++;
+    state.progress = 0;
+    state.total = 0;
+    state.found = false;
+    state.cached = false;
+    state.elapsed_ms = 0;
+    scanCancel = false;
+  }
+  spin_unlock(state_lock, save);
+  return !busy;
+}
+
+void scan_job_run() {
+  uint32_t save = spin_lock_blocking(state_lock);
+  bool pending = state.state == SCAN_JOB_PENDING;
+  if (pending) {
+    state.state = SCAN_JOB_RUNNING;
+    state.event++;
+  }
+  struct scan_job_params params = state.params;
+  spin_unlock(state_lock, save);
+  if (!pending) {
+    return;
+  }
+
+  bool pulse_pins = jPulsePins;
+  bool quick_probe = jQuickProbe;
+  jPulsePins = params.pulse_pins;
+  jQuickProbe = params.quick_probe;
+  scanQuiet = true;
+  scanProgressHook = publish_progress;
+  started_us = time_us_64();
+  published_us = started_us;
+
+  bool cached = params.verify && verify_cached(&params);
+  bool found = cached;
+  if (!found && !scanCancel) {
+    if (params.type == SCAN_JOB_JTAG) {
+      found = jtagScanChannels(params.channels);
+    } else {
+      found = swdScanChannels(params.channels);
+    }
+    if (found && !scanCancel) {
+      save_pinout(&params);
+    }
+  }
+
+  scanProgressHook = NULL;
+  scanQuiet = false;
+  jPulsePins = pulse_pins;
+  jQuickProbe = quick_probe;
+  finish(scanCancel ? SCAN_JOB_CANCELLED : SCAN_JOB_DONE, found && !scanCancel, cached);
+}
+
+void scan_job_cancel() {
+  scanCancel = true;
+}
+
+bool scan_job_busy() {
+  uint32_t save = spin_lock_blocking(state_lock);
+  bool busy = state.state == SCAN_JOB_PENDING || state.state == SCAN_JOB_RUNNING;
+  spin_unlock(state_lock, save);
+  return busy;
+}
+
+void scan_job_get_status(struct scan_job_status *status) {
+  uint32_t save = spin_lock_blocking(state_lock);
+  *status = state;
+  spin_unlock(state_lock, save);
+}
+
+void scan_job_print_progress(const struct scan_job_status *status) {
+  drawProgress(status->progress, status->total);
+}
+
+void scan_job_print_result() {
+  struct scan_job_status status;
+  scan_job_get_status(&status);
+  if (status.state != SCAN_JOB_DONE) {
+    return;
+  }
+  if (status.cached) {
+    printf("     [  Cached  ]  Known pinout answered, no scan needed\n\n");
+    if (status.params.type == SCAN_JOB_JTAG) {
+      jtagDisplayChains();
+    } else {
+      swdDisplayTargets();
+    }
+    return;
+  }
+  if (status.params.type == SCAN_JOB_JTAG) {
+    jtagDisplayResult(status.found);
+  } else {
+    swdDisplayResult();
+  }
+}
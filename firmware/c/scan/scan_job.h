@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * JTAG/SWD pinout scans as a background job of core 0.
+ *
+ * The console queues a scan with every parameter up front
+ * (SERIAL_CMD_scan_start) and goes back to reading input. Core 0 runs the
+ * job from its main loop while the glitcher is idle and publishes progress at
+ * most every SCAN_JOB_EVENT_INTERVAL_MS; readers poll scan_job_get_status()
+ * and act when `event` changes. The results stay in the blueTag globals
+ * (blueTag_api.h) until the next scan starts.
+ *
+ * Pinouts found by full scans are saved to the pinout cache. A verify job
+ * first checks the cached pinouts of its type with one ID read each and only
+ * falls back to a full scan if none answers.
+ */
+
+#define SCAN_JOB_EVENT_INTERVAL_MS 100
+
+enum scan_job_type {
+  SCAN_JOB_JTAG,
+  SCAN_JOB_SWD,
+};
+
+enum scan_job_state {
+  SCAN_JOB_IDLE,       // Nothing scanned since boot
+  SCAN_JOB_PENDING,    // Accepted, core 0 hasn't picked it up yet
+  SCAN_JOB_RUNNING,
+  SCAN_JOB_DONE,
+  SCAN_JOB_CANCELLED,
+};
+
+struct scan_job_params {
+  uint32_t type;      // enum scan_job_type
+  uint32_t channels;  // Scan channels 0..channels-1
+  bool pulse_pins;
+  bool quick_probe;   // JTAG only, see jtagQuickProbe()
+  bool verify;        // Try the cached pinouts first
+};
+
+struct scan_job_status {
+  uint32_t state;  // enum scan_job_state
+  uint32_t id;     // Bumped by every accepted scan
+  uint32_t event;  // Bumped by every published update
+  struct scan_job_params params;
+  uint32_t progress;  // Permutations tried so far
+  uint32_t total;     // Permutations in the current phase
+  bool found;
+  bool cached;  // Found by checking a cached pinout
+  uint32_t elapsed_ms;
+};
+
+/**
+ * @brief Set up the scan channels and load the pinout cache
+ * @note Core 0, before core 1 is launched
+ */
+void scan_job_init();
+
+/**
+ * @brief Check the channel count against the scan type
+ */
+bool scan_job_valid(const struct scan_job_params *params);
+
+/**
+ * @brief Queue a scan
+ * @note Core 0 (SERIAL_CMD_scan_start)
+ * @return false if a scan is already queued or running, or the parameters
+ *         are invalid
+ */
+bool scan_job_start(const struct scan_job_params *params);
+
+/**
+ * @brief Run the queued scan, if any, to completion or cancellation
+ * @note Core 0 main loop, only while the glitcher is idle
+ */
+void scan_job_run();
+
+/**
+ * @brief Ask the running scan to stop (safe to call from core 1)
+ */
+void scan_job_cancel();
+
+/**
+ * @brief A scan is queued or running: its pins and PIO state machines are in use
+ */
+bool scan_job_busy();
+
+/**
+ * @brief Snapshot of the scan progress (safe to call from core 1)
+ */
+void scan_job_get_status(struct scan_job_status *status);
+
+/**
+ * @brief Redraw the progress bar from a status snapshot
+ */
+void scan_job_print_progress(const struct scan_job_status *status);
+
+/**
+ * @brief Print the pinout and devices found by the last finished scan
+ * @note Core 1, only while no scan is busy
+ */
+void scan_job_print_result();
@@ -0,0 +1,130 @@
+#include "console_out.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+
+static char out_buffer[CONSOLE_OUT_BUFFER_SIZE];
+static size_t out_len = 0;
+static uint32_t out_last_write_us = 0;
+static uint32_t out_writes = 0;
+
+void console_out_flush() {
+  if (out_len == 0) {
+    return;
+  }
+  stdio_put_string(out_buffer, out_len, false, true);
+  stdio_flush();
+  out_len = 0;
+  out_writes++;
+}
+
+void console_out_write(const char *data, size_t len) {
+  if (len > 0) {
+    out_last_write_us = time_us_32();
+  }
+
+  while (len > 0) {
+    size_t chunk = CONSOLE_OUT_BUFFER_SIZE - out_len;
+    if (chunk > len) {
+      chunk = len;
+    }
+    for (size_t i = 0; i < chunk; i++) {
+      out_buffer[out_len++] = data[i];
+    }
+    data += chunk;
+    len -= chunk;
+
+    if (out_len == CONSOLE_OUT_BUFFER_SIZE) {
+      console_out_flush();
+    }
+  }
+}
+
+void console_out_putc(char c) {
+  console_out_write(&c, 1);
+}
+
+void console_out_repeat(char c, size_t count) {
+  char chunk[CONSOLE_OUT_PACKET_SIZE];
+  size_t fill = count < sizeof(chunk) ? count : sizeof(chunk);
+  for (size_t i = 0; i < fill; i++) {
+    chunk[i] = c;
+  }
+  while (count > 0) {
+    size_t n = count < sizeof(chunk) ? count : sizeof(chunk);
+    console_out_write(chunk, n);
+    count -= n;
+  }
+}
+
+void console_out_printf(const char *fmt, ...) {
+  char line[128];
+  va_list args;
+  va_start(args, fmt);
+  int len = vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+
+  if (len < 0) {
+    return;
+  }
+  if ((size_t)len >= sizeof(line)) {
+    len = sizeof(line) - 1;
+  }
+  console_out_write(line, len);
+}
+
+void console_out_poll() {
+  if (out_len > 0 && time_us_32() - out_last_write_us > CONSOLE_OUT_IDLE_US) {
+    console_out_flush();
+  }
+}
+
+uint32_t console_out_writes() {
+  return out_writes;
+}
+
+static uint32_t bytes_per_s(uint32_t bytes, uint32_t start_us) {
+  uint32_t elapsed = time_us_32() - start_us;
+  return elapsed ? (uint64_t)bytes * 1000000 / elapsed : 0;
+}
+
+// Lines of '#' through console_out, optionally flushed after each one
+static void benchmark_lines(uint32_t total_bytes, uint32_t line_len, bool line_flush) {
+  for (uint32_t i = 0; i < total_bytes; i += line_len) {
+    console_out_repeat('#', line_len - 1);
+    console_out_putc('\n');
+    if (line_flush) {
+      console_out_flush();
+    }
+  }
+  console_out_flush();
+}
+
+void console_out_benchmark(uint32_t total_bytes, struct console_out_benchmark *result) {
+  const uint32_t line_len = 64;
+  uint32_t start;
+  uint32_t writes;
+
+  // Character by character, the way the progress bars used to be drawn
+  start = time_us_32();
+  for (uint32_t i = 0; i < total_bytes; i++) {
+    putchar((i % line_len == line_len - 1) ? '\n' : '#');
+  }
+  stdio_flush();
+  result->direct_bps = bytes_per_s(total_bytes, start);
+
+  console_out_flush();
+  start = time_us_32();
+  writes = out_writes;
+  benchmark_lines(total_bytes, line_len, true);
+  result->line_bps = bytes_per_s(total_bytes, start);
+  result->line_writes = out_writes - writes;
+
+  start = time_us_32();
+  writes = out_writes;
+  benchmark_lines(total_bytes, line_len, false);
+  result->buffered_bps = bytes_per_s(total_bytes, start);
+  result->buffered_writes = out_writes - writes;
+}
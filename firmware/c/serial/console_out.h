@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Buffered console output
+ *
+ * Every printf/putchar on the USB stdio ends up as its own CDC transfer.
+ * Bulk emitters (progress bars, tables, dumps) write through this buffer
+ * instead, which is handed to stdio in packet-sized chunks.
+ *
+ * The buffer is flushed when it fills up, by console_out_poll() once nothing
+ * was written for CONSOLE_OUT_IDLE_US, and by console_out_flush(). Newlines
+ * don't flush: emitters call console_out_flush() when they're done, and
+ * before mixing in plain printf output or showing a prompt, to keep the
+ * ordering intact. Not thread safe: only use it from the console core.
+ */
+
+#define CONSOLE_OUT_PACKET_SIZE 64  // USB full-speed CDC bulk packet
+#define CONSOLE_OUT_BUFFER_SIZE (8 * CONSOLE_OUT_PACKET_SIZE)
+#define CONSOLE_OUT_IDLE_US 2000
+
+void console_out_write(const char *data, size_t len);
+void console_out_putc(char c);
+
+/**
+ * @brief Write @p c @p count times (bars, padding)
+ */
+void console_out_repeat(char c, size_t count);
+
+void console_out_printf(const char *fmt, ...);
+void console_out_flush();
+
+/**
+ * @brief Flush the buffer if nothing was written for CONSOLE_OUT_IDLE_US
+ */
+void console_out_poll();
+
+/**
+ * @brief Writes handed to stdio so far, one USB transfer or more each
+ */
+uint32_t console_out_writes();
+
+struct console_out_benchmark {
+  uint32_t direct_bps;    // putchar per character
+  uint32_t line_bps;      // console_out flushed at every newline, as it used to be
+  uint32_t buffered_bps;  // console_out flushed when full
+  uint32_t line_writes;   // stdio writes of the line-flushed run
+  uint32_t buffered_writes;
+};
+
+/**
+ * @brief Measure console throughput of 64-byte lines with each policy
+ * @param total_bytes Bytes to emit per run
+ */
+void console_out_benchmark(uint32_t total_bytes, struct console_out_benchmark *result);
@@ -0,0 +1,67 @@
+#include "core_link.h"
+
+#include "pico/multicore.h"
+
+#include "glitcher.h"
+#include "scan_job.h"
+#include "serial.h"
+
+#define CORE_LINK_TIMEOUT_US 1000000
+
+bool core_link_read(uint32_t timeout_us, uint32_t *value) {
+  if (timeout_us == 0) {
+    *value = multicore_fifo_pop_blocking();
+    return true;
+  }
+  return multicore_fifo_pop_timeout_us(timeout_us, value);
+}
+
+// A scan holds core 0 until it's done: keep waiting rather than leave a late
+// answer in the FIFO for the next call
+static bool read_answer(uint32_t *value) {
+  while (!core_link_read(CORE_LINK_TIMEOUT_US, value)) {
+    if (!scan_job_busy()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool core_link_call(uint32_t command, uint32_t *result) {
+  uint32_t value;
+  multicore_fifo_push_blocking(command);
+  if (!read_answer(&value)) {
+    return false;
+  }
+  if (result) {
+    *result = value;
+  }
+  return true;
+}
+
+bool core_link_call_arg(uint32_t command, uint32_t arg, uint32_t *result) {
+  uint32_t value;
+  multicore_fifo_push_blocking(command);
+  multicore_fifo_push_blocking(arg);
+  if (!read_answer(&value)) {
+    return false;
+  }
+  if (result) {
+    *result = value;
+  }
+  return true;
+}
+
+bool core_link_sync_glitcher() {
+  bool ok = true;
+  ok &= core_link_call_arg(SERIAL_CMD_config_trigger_type, glitcher.trigger_type, NULL);
+  ok &= core_link_call_arg(SERIAL_CMD_config_trigger_pull, glitcher.trigger_pull_configuration, NULL);
+  ok &= core_link_call_arg(SERIAL_CMD_config_glitch_output, glitcher.glitch_output, NULL);
+  ok &= core_link_call_arg(SERIAL_CMD_config_pulse_delay_cycles, glitcher.delay_before_pulse, NULL);
+  ok &= core_link_call_arg(SERIAL_CMD_config_pulse_time_cycles, glitcher.pulse_width, NULL);
+  if (glitcher.trigger_type == TriggersType_TRIGGER_SERIAL) {
+    ok &= core_link_call_arg(SERIAL_CMD_config_serial_baud, glitcher.serial_baud, NULL);
+    ok &= core_link_call_arg(SERIAL_CMD_config_serial_pin, glitcher.serial_pin, NULL);
+  }
+  return ok;
+}
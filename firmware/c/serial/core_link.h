@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Send a FIFO command to core 0 and wait for its result
+ * @param command One of the SERIAL_CMD_* values
+ * @param result Receives the result word, may be NULL
+ * @return false if core 0 did not answer within the timeout (which doesn't
+ *         run out while a scan job holds core 0)
+ */
+bool core_link_call(uint32_t command, uint32_t *result);
+
+/**
+ * @brief Send a FIFO command with one argument word to core 0
+ * @param command One of the SERIAL_CMD_config_* values
+ * @param arg The argument word
+ * @param result Receives the result word, may be NULL
+ * @return false if core 0 did not answer within the timeout
+ */
+bool core_link_call_arg(uint32_t command, uint32_t arg, uint32_t *result);
+
+/**
+ * @brief Read a follow-up word (e.g. the status value) from core 0
+ * @param timeout_us How long to wait, 0 waits forever
+ * @param value Receives the word
+ * @return false on timeout
+ */
+bool core_link_read(uint32_t timeout_us, uint32_t *value);
+
+/**
+ * @brief Push the shared glitcher configuration to core 0
+ * @return false if any of the updates timed out
+ */
+bool core_link_sync_glitcher();
@@ -0,0 +1,731 @@
+#include "machine.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "burst.h"
+#include "campaign.h"
+#include "config_store.h"
+#include "console_out.h"
+#include "core_link.h"
+#include "glitcher.h"
+#include "hv_autotune.h"
+#include "hv_sense.h"
+#include "hv_telemetry.h"
+#include "multishot.h"
+#include "picoemp.h"
+#include "scan_job.h"
+#include "serial.h"
+#include "serial_utils.h"
+
+typedef int (*machine_handler_t)(char *args);
+
+typedef struct {
+  const char *name;
+  const char *alias;
+  machine_handler_t handler;
+} machine_command_t;
+
+static bool machine_mode = false;
+
+bool machine_mode_active() {
+  return machine_mode;
+}
+
+void machine_mode_set(bool enabled) {
+  machine_mode = enabled;
+  glitcher_verbose = !enabled;
+}
+
+static void reply_ok() {
+  printf("OK\n");
+}
+
+static void reply_err(int code) {
+  printf("ERR %d\n", code);
+}
+
+// Split the next "key=value" pair off the argument string
+static bool next_arg(char **cursor, char **key, char **value) {
+  char *p = *cursor;
+  while (*p == ' ') p++;
+  if (*p == 0) {
+    return false;
+  }
+
+  *key = p;
+  while (*p != 0 && *p != ' ') p++;
+  if (*p != 0) {
+    *p++ = 0;
+  }
+  *cursor = p;
+
+  char *eq = strchr(*key, '=');
+  if (eq == NULL) {
+    *value = "";
+  } else {
+    *eq = 0;
+    *value = eq + 1;
+  }
+  return true;
+}
+
+// Send a command without arguments to core 0 and translate its result
+static int simple_command(uint32_t command) {
+  uint32_t result;
+  if (!core_link_call(command, &result)) {
+    return MACHINE_ERR_TIMEOUT;
+  }
+  return (result == return_ok) ? 0 : MACHINE_ERR_FAILED;
+}
+
+static int machine_arm(char *args) {
+  return simple_command(SERIAL_CMD_arm);
+}
+
+static int machine_disarm(char *args) {
+  return simple_command(SERIAL_CMD_disarm);
+}
+
+static int machine_pulse(char *args) {
+  return simple_command(SERIAL_CMD_pulse);
+}
+
+static int machine_enable_timeout(char *args) {
+  return simple_command(SERIAL_CMD_enable_timeout);
+}
+
+static int machine_disable_timeout(char *args) {
+  return simple_command(SERIAL_CMD_disable_timeout);
+}
+
+static int machine_internal_hvp(char *args) {
+  return simple_command(SERIAL_CMD_internal_hvp);
+}
+
+static int machine_external_hvp(char *args) {
+  return simple_command(SERIAL_CMD_external_hvp);
+}
+
+static int machine_status(char *args) {
+  uint32_t result;
+  uint32_t status;
+  if (!core_link_call(SERIAL_CMD_status, &result) || result != return_ok ||
+      !core_link_read(1000000, &status)) {
+    return MACHINE_ERR_TIMEOUT;
+  }
+  printf("OK st=%lu trig=%u pull=%u out=%u delay=%lu width=%lu adc=%lu recharge=%lu\n",
+         status, glitcher.trigger_type, glitcher.trigger_pull_configuration,
+         glitcher.glitch_output, glitcher.delay_before_pulse, glitcher.pulse_width,
+         adc_get_sample_count(), picoemp_last_recharge_us());
+  return -1;
+}
+
+// Glitch and fast trigger answer twice: accepted, then triggered / timed out
+static int run_glitch(uint32_t command) {
+  uint32_t result;
+  if (!core_link_call(command, &result)) {
+    return MACHINE_ERR_TIMEOUT;
+  }
+  if (result != return_ok) {
+    return MACHINE_ERR_FAILED;
+  }
+  core_link_read(0, &result);
+  printf("OK triggered=%d\n", result == return_ok);
+  return -1;
+}
+
+static int machine_glitch(char *args) {
+  return run_glitch(SERIAL_CMD_glitch);
+}
+
+static int machine_fast_trigger(char *args) {
+  return run_glitch(SERIAL_CMD_fast_trigger);
+}
+
+// Serial trigger parameters shared by gc and fc
+static bool parse_serial_arg(const char *key, const char *value, bool *valid) {
+  uint32_t val;
+  if (strcmp(key, "pat") == 0) {
+    *valid = value[0] != 0 && strlen(value) < sizeof(glitcher.serial_pattern);
+    if (*valid) {
+      strcpy(glitcher.serial_pattern, value);
+    }
+    return true;
+  }
+  if (strcmp(key, "pin") == 0) {
+    *valid = safe_strtoul(value, &val) && (val == 1 || val == 5);
+    if (*valid) glitcher.serial_pin = val;
+    return true;
+  }
+  if (strcmp(key, "baud") == 0) {
+    *valid = safe_strtoul(value, &val) && val >= 300 && val <= 1000000;
+    if (*valid) glitcher.serial_baud = val;
+    return true;
+  }
+  return false;
+}
+
+static int machine_configure_glitcher(char *args) {
+  char *key;
+  char *value;
+  uint32_t val;
+
+  while (next_arg(&args, &key, &value)) {
+    bool valid = false;
+    if (strcmp(key, "trig") == 0) {
+      valid = safe_strtoul(value, &val) && val <= 7;
+      if (valid) glitcher.trigger_type = (val == 7) ? TriggersType_TRIGGER_SERIAL : (TriggersType)val;
+    } else if (strcmp(key, "pull") == 0) {
+      valid = safe_strtoul(value, &val) && val <= 2;
+      if (valid) glitcher.trigger_pull_configuration = (TriggerPullConfiguration)val;
+    } else if (strcmp(key, "out") == 0) {
+      valid = safe_strtoul(value, &val) && val <= 3;
+      if (valid) glitcher.glitch_output = (GlitchOutput_t)val;
+    } else if (strcmp(key, "delay") == 0) {
+      valid = safe_strtoul(value, &val);
+      if (valid) glitcher.delay_before_pulse = val;
+    } else if (strcmp(key, "width") == 0) {
+      valid = safe_strtoul(value, &val) && val > 0;
+      if (valid) glitcher.pulse_width = val;
+    } else if (!parse_serial_arg(key, value, &valid)) {
+      valid = false;
+    }
+    if (!valid) {
+      return MACHINE_ERR_BAD_ARGUMENT;
+    }
+  }
+
+  return core_link_sync_glitcher() ? 0 : MACHINE_ERR_TIMEOUT;
+}
+
+static int machine_fast_trigger_configure(char *args) {
+  char *key;
+  char *value;
+  uint32_t val;
+
+  while (next_arg(&args, &key, &value)) {
+    bool valid = false;
+    if (strcmp(key, "edge") == 0) {
+      // Same numbering as the interactive wizard
+      valid = safe_strtoul(value, &val) && val <= 2;
+      if (valid) {
+        if (val == 0) glitcher.trigger_type = TriggersType_TRIGGER_RISING_EDGE;
+        else if (val == 1) glitcher.trigger_type = TriggersType_TRIGGER_FALLING_EDGE;
+        else glitcher.trigger_type = TriggersType_TRIGGER_SERIAL;
+      }
+    } else if (strcmp(key, "delay") == 0) {
+      valid = safe_strtoul(value, &val);
+      if (valid) glitcher.delay_before_pulse = val;
+    } else if (strcmp(key, "width") == 0) {
+      valid = safe_strtoul(value, &val) && val > 0;
+      if (valid) glitcher.pulse_width = val;
+    } else if (!parse_serial_arg(key, value, &valid)) {
+      valid = false;
+    }
+    if (!valid) {
+      return MACHINE_ERR_BAD_ARGUMENT;
+    }
+  }
+
+  return core_link_sync_glitcher() ? 0 : MACHINE_ERR_TIMEOUT;
+}
+
+static int machine_configure_faultier(char *args) {
+  char *key;
+  char *value;
+  uint32_t val;
+
+  while (next_arg(&args, &key, &value)) {
+    bool valid = false;
+    if (strcmp(key, "src") == 0) {
+      valid = safe_strtoul(value, &val) && val <= 2;
+      if (valid) glitcher.trigger_source = (TriggerSource)val;
+    } else if (strcmp(key, "pco") == 0) {
+      valid = safe_strtoul(value, &val) && val <= 7;
+      if (valid) glitcher.power_cycle_output = (GlitchOutput)val;
+    } else if (strcmp(key, "pcl") == 0) {
+      valid = safe_strtoul(value, &val);
+      if (valid) glitcher.power_cycle_length = val;
+    }
+    if (!valid) {
+      return MACHINE_ERR_BAD_ARGUMENT;
+    }
+  }
+  return 0;
+}
+
+static int machine_configure(char *args) {
+  char *key;
+  char *value;
+  uint32_t val;
+
+  while (next_arg(&args, &key, &value)) {
+    if (strcmp(key, "time") == 0) {
+      if (!safe_strtoul(value, &val)) {
+        return MACHINE_ERR_BAD_ARGUMENT;
+      }
+      if (!core_link_call_arg(SERIAL_CMD_config_pulse_time, val, NULL)) {
+        return MACHINE_ERR_TIMEOUT;
+      }
+    } else if (strcmp(key, "cycles") == 0) {
+      if (!safe_strtoul(value, &val)) {
+        return MACHINE_ERR_BAD_ARGUMENT;
+      }
+      if (!core_link_call_arg(SERIAL_CMD_config_pulse_cycles, val, NULL)) {
+        return MACHINE_ERR_TIMEOUT;
+      }
+    } else if (strcmp(key, "power") == 0) {
+      char *end;
+      union {
+        float f;
+        uint32_t ui32;
+      } power;
+      power.f = strtof(value, &end);
+      if (end == value || *end != 0 || power.f <= 0.0f || power.f >= 1.0f) {
+        return MACHINE_ERR_BAD_ARGUMENT;
+      }
+      if (!core_link_call_arg(SERIAL_CMD_config_pulse_power, power.ui32, NULL)) {
+        return MACHINE_ERR_TIMEOUT;
+      }
+      serial_set_pulse_power(power.f);
+    } else if (strcmp(key, "freq") == 0) {
+      if (!safe_strtoul(value, &val) || val < PICOEMP_PWM_FREQ_MIN || val > PICOEMP_PWM_FREQ_MAX) {
+        return MACHINE_ERR_BAD_ARGUMENT;
+      }
+      if (!core_link_call_arg(SERIAL_CMD_config_pwm_freq, val, NULL)) {
+        return MACHINE_ERR_TIMEOUT;
+      }
+    } else {
+      return MACHINE_ERR_BAD_ARGUMENT;
+    }
+  }
+  return 0;
+}
+
+static int machine_configure_adc(char *args) {
+  char *key;
+  char *value;
+  uint32_t val;
+
+  while (next_arg(&args, &key, &value)) {
+    if (strcmp(key, "n") != 0 || !safe_strtoul(value, &val) || !glitcher_set_adc_sample_count(val)) {
+      return MACHINE_ERR_BAD_ARGUMENT;
+    }
+  }
+  return 0;
+}
+
+static int profile_command(uint32_t command, char *args) {
+  char *key;
+  char *value;
+  uint32_t result;
+  if (!next_arg(&args, &key, &value) || strcmp(key, "name") != 0 || value[0] == 0 ||
+      strlen(value) > CONFIG_PROFILE_NAME_LEN) {
+    return MACHINE_ERR_BAD_ARGUMENT;
+  }
+  if (!core_link_call_arg(command, (uint32_t)(uintptr_t)value, &result)) {
+    return MACHINE_ERR_TIMEOUT;
+  }
+  return result == return_ok ? 0 : MACHINE_ERR_FAILED;
+}
+
+static int machine_save_profile(char *args) {
+  return profile_command(SERIAL_CMD_profile_save, args);
+}
+
+static int machine_load_profile(char *args) {
+  return profile_command(SERIAL_CMD_profile_load, args);
+}
+
+static void print_profile_name(const char *name, bool is_boot, void *ctx) {
+  bool *first = ctx;
+  printf("%s%s%s", *first ? "" : ",", name, is_boot ? "*" : "");
+  *first = false;
+}
+
+static int machine_list_profiles(char *args) {
+  bool first = true;
+  printf("OK profiles=");
+  config_store_list(print_profile_name, &first);
+  printf("\n");
+  return -1;
+}
+
+// bu n=<pulses> hz=<rate> | period=<us> [cycles=<width>]
+static int machine_burst(char *args) {
+  char *key;
+  char *value;
+  uint32_t val;
+  uint32_t result;
+  struct burst_config config = {.count = 1, .period_us = 0, .width_cycles = 0};
+
+  while (next_arg(&args, &key, &value)) {
+    if (!safe_strtoul(value, &val)) {
+      return MACHINE_ERR_BAD_ARGUMENT;
+    }
+    if (strcmp(key, "n") == 0) config.count = val;
+    else if (strcmp(key, "hz") == 0 && val > 0) config.period_us = 1000000 / val;
+    else if (strcmp(key, "period") == 0) config.period_us = val;
+    else if (strcmp(key, "cycles") == 0) config.width_cycles = val;
+    else return MACHINE_ERR_BAD_ARGUMENT;
+  }
+  if (!burst_valid(&config)) {
+    return MACHINE_ERR_BAD_ARGUMENT;
+  }
+
+  if (!core_link_call_arg(SERIAL_CMD_burst, (uint32_t)(uintptr_t)&config, &result)) {
+    return MACHINE_ERR_TIMEOUT;
+  }
+  if (result != return_ok) {
+    return MACHINE_ERR_FAILED;
+  }
+  core_link_read(0, &result);
+
+  // Fire times in us since the first slot, '-' for skipped slots,
+  // then the HV level per slot ('-' if not sampled)
+  const struct burst_result *burst = burst_get_result();
+  console_out_printf("OK fired=%lu skipped=%lu t=", burst->fired, burst->skipped);
+  for (uint32_t i = 0; i < burst->count; i++) {
+    if (i > 0) {
+      console_out_putc(',');
+    }
+    if (burst->timestamps_us[i] == BURST_SKIPPED) {
+      console_out_putc('-');
+    } else {
+      console_out_printf("%lu", burst->timestamps_us[i]);
+    }
+  }
+  console_out_write(" lv=", 4);
+  for (uint32_t i = 0; i < burst->count; i++) {
+    if (i > 0) {
+      console_out_putc(',');
+    }
+    if (burst->levels[i] == HV_SENSE_UNAVAILABLE) {
+      console_out_putc('-');
+    } else {
+      console_out_printf("%u", burst->levels[i]);
+    }
+  }
+  console_out_putc('\n');
+  console_out_flush();
+  return -1;
+}
+
+// One <freq>:<duty>:<count>:<min>:<mean>:<max> entry per PWM setting
+static int machine_hv_stats(char *args) {
+  console_out_write("OK stats=", 9);
+  bool first = true;
+  for (uint32_t i = 0; i < HV_TELEMETRY_SETTINGS; i++) {
+    const struct hv_charge_stats *stats = hv_telemetry_get(i);
+    if (stats == NULL) {
+      continue;
+    }
+    if (!first) {
+      console_out_putc(',');
+    }
+    first = false;
+    console_out_printf("%lu:%.4f:%lu:%lu:%lu:%lu", stats->freq_hz, stats->duty, stats->count, stats->min_us,
+                       (uint32_t)(stats->sum_us / stats->count), stats->max_us);
+  }
+  console_out_putc('\n');
+  console_out_flush();
+  return -1;
+}
+
+// Replies with the chosen setting, found=0 if none was stable
+static int machine_hv_autotune(char *args) {
+  uint32_t result;
+  if (!core_link_call(SERIAL_CMD_hv_autotune, &result)) {
+    return MACHINE_ERR_TIMEOUT;
+  }
+  if (result != return_ok) {
+    return MACHINE_ERR_FAILED;
+  }
+  core_link_read(0, &result);
+
+  const struct hv_autotune_result *tune = hv_autotune_get_result();
+  if (tune->found) {
+    // Core 0 switched to it; keep the console's copy in step, like the console command
+    serial_set_pulse_power(tune->best.duty);
+    printf("OK found=1 freq=%lu duty=%.4f mean=%lu\n", tune->best.freq_hz, tune->best.duty, tune->best_mean_us);
+  } else {
+    printf("OK found=0\n");
+  }
+  return -1;
+}
+
+// ms n=<shots> timeout=<ms>, delay/width/edge from the glitcher
+static int machine_multishot(char *args) {
+  char *key;
+  char *value;
+  uint32_t val;
+  uint32_t result;
+  struct multishot_config config = {.count = 1, .timeout_ms = 0};
+
+  while (next_arg(&args, &key, &value)) {
+    if (!safe_strtoul(value, &val)) {
+      return MACHINE_ERR_BAD_ARGUMENT;
+    }
+    if (strcmp(key, "n") == 0) config.count = val;
+    else if (strcmp(key, "timeout") == 0) config.timeout_ms = val;
+    else return MACHINE_ERR_BAD_ARGUMENT;
+  }
+  if (config.count == 0 || config.count > MULTISHOT_MAX_SHOTS || config.timeout_ms == 0 ||
+      config.timeout_ms > MULTISHOT_MAX_TIMEOUT_MS) {
+    return MACHINE_ERR_BAD_ARGUMENT;
+  }
+
+  if (!core_link_call_arg(SERIAL_CMD_multishot, (uint32_t)(uintptr_t)&config, &result)) {
+    return MACHINE_ERR_TIMEOUT;
+  }
+  if (result != return_ok) {
+    return MACHINE_ERR_FAILED;
+  }
+  core_link_read(0, &result);
+
+  // Trigger times in us since the run started
+  const struct multishot_result *shots = multishot_get_result();
+  console_out_printf("OK fired=%lu t=", shots->fired);
+  for (uint32_t i = 0; i < shots->fired; i++) {
+    if (i > 0) {
+      console_out_putc(',');
+    }
+    console_out_printf("%lu", shots->timestamps_us[i]);
+  }
+  console_out_putc('\n');
+  console_out_flush();
+  return -1;
+}
+
+static int machine_campaign(char *args) {
+  char *key;
+  char *value;
+  uint32_t val;
+  uint32_t result;
+  struct campaign_params params = {
+      .delay_min = 0, .delay_max = 0, .delay_step = 1,
+      .width_min = 0, .width_max = 0, .width_step = 1,
+      .repeats = 1, .seed = 0,
+  };
+
+  while (next_arg(&args, &key, &value)) {
+    if (!safe_strtoul(value, &val)) {
+      return MACHINE_ERR_BAD_ARGUMENT;
+    }
+    if (strcmp(key, "dmin") == 0) params.delay_min = val;
+    else if (strcmp(key, "dmax") == 0) params.delay_max = val;
+    else if (strcmp(key, "dstep") == 0) params.delay_step = val;
+    else if (strcmp(key, "wmin") == 0) params.width_min = val;
+    else if (strcmp(key, "wmax") == 0) params.width_max = val;
+    else if (strcmp(key, "wstep") == 0) params.width_step = val;
+    else if (strcmp(key, "n") == 0) params.repeats = val;
+    else if (strcmp(key, "seed") == 0) params.seed = val;
+    else return MACHINE_ERR_BAD_ARGUMENT;
+  }
+
+  // Core 0 copies the parameters before answering
+  if (!core_link_call_arg(SERIAL_CMD_campaign_start, (uint32_t)(uintptr_t)&params, &result)) {
+    return MACHINE_ERR_TIMEOUT;
+  }
+  return result == return_ok ? 0 : MACHINE_ERR_BAD_ARGUMENT;
+}
+
+static int machine_campaign_stop(char *args) {
+  return simple_command(SERIAL_CMD_campaign_stop);
+}
+
+static int machine_campaign_status(char *args) {
+  struct campaign_status status;
+  campaign_get_status(&status);
+  printf("OK id=%lu active=%d done=%lu total=%lu triggered=%lu timeouts=%lu skipped=%lu resumes=%lu resets=%lu "
+         "level=%u\n",
+         status.id, status.active, status.completed, status.total, status.triggered, status.timeouts, status.skipped,
+         status.resumes, status.resets, status.last_level);
+  return -1;
+}
+
+static bool read_hv_level(uint16_t *level) {
+  uint32_t result;
+  uint32_t value;
+  if (!core_link_call(SERIAL_CMD_hv_level, &result) || result != return_ok || !core_link_read(1000000, &value)) {
+    return false;
+  }
+  *level = value;
+  return true;
+}
+
+static int machine_hv_level(char *args) {
+  uint16_t level;
+  uint16_t target;
+  uint8_t pct;
+  if (!read_hv_level(&level)) {
+    return MACHINE_ERR_TIMEOUT;
+  }
+  hv_sense_get_window(&target, &pct);
+  if (level == HV_SENSE_UNAVAILABLE) {
+    printf("OK level=- target=%u pct=%u\n", target, pct);
+  } else {
+    printf("OK level=%u target=%u pct=%u\n", level, target, pct);
+  }
+  return -1;
+}
+
+// hw [target=<counts>] [pct=<percent>] [cal]: cal uses the current level as target
+static int machine_hv_window(char *args) {
+  char *key;
+  char *value;
+  uint32_t val;
+  uint16_t target;
+  uint8_t pct;
+  hv_sense_get_window(&target, &pct);
+
+  while (next_arg(&args, &key, &value)) {
+    if (strcmp(key, "cal") == 0) {
+      if (!read_hv_level(&target)) {
+        return MACHINE_ERR_TIMEOUT;
+      }
+      if (target == HV_SENSE_UNAVAILABLE) {
+        return MACHINE_ERR_FAILED;
+      }
+    } else if (safe_strtoul(value, &val) && strcmp(key, "target") == 0 && val < HV_SENSE_UNAVAILABLE) {
+      target = val;
+    } else if (safe_strtoul(value, &val) && strcmp(key, "pct") == 0 && val <= 100) {
+      pct = val;
+    } else {
+      return MACHINE_ERR_BAD_ARGUMENT;
+    }
+  }
+  hv_sense_set_window(target, pct);
+  return 0;
+}
+
+static int machine_version(char *args) {
+  printf("OK version=%s\n", FIRMWARE_VERSION);
+  return -1;
+}
+
+static int machine_mode_command(char *args) {
+  char *key;
+  char *value;
+  if (!next_arg(&args, &key, &value) || strcmp(key, "off") != 0) {
+    return MACHINE_ERR_BAD_ARGUMENT;
+  }
+  reply_ok();
+  machine_mode_set(false);
+  return -1;
+}
+
+// Commands that don't need core 0
+static bool scan_safe_command(machine_handler_t handler) {
+  return handler == machine_hv_stats || handler == machine_version || handler == machine_mode_command;
+}
+
+static const machine_command_t machine_commands[] = {
+    {"arm", "a", machine_arm},
+    {"disarm", "d", machine_disarm},
+    {"pulse", "p", machine_pulse},
+    {"enable timeout", "en", machine_enable_timeout},
+    {"disable timeout", "dt", machine_disable_timeout},
+    {"internal hvp", "in", machine_internal_hvp},
+    {"external hvp", "ex", machine_external_hvp},
+    {"status", "s", machine_status},
+    {"glitch", "g", machine_glitch},
+    {"fast trigger", "fq", machine_fast_trigger},
+    {"configure glitcher", "gc", machine_configure_glitcher},
+    {"fast trigger configure", "fc", machine_fast_trigger_configure},
+    {"configure faultier", "cf", machine_configure_faultier},
+    {"configure", "cfg", machine_configure},
+    {"configure adc", "ac", machine_configure_adc},
+    {"burst", "bu", machine_burst},
+    {"multishot", "ms", machine_multishot},
+    {"hv level", "hl", machine_hv_level},
+    {"hv window", "hw", machine_hv_window},
+    {"hv stats", "hs", machine_hv_stats},
+    {"hv autotune", "ha", machine_hv_autotune},
+    {"campaign", "cp", machine_campaign},
+    {"campaign stop", "cx", machine_campaign_stop},
+    {"campaign status", "ct", machine_campaign_status},
+    {"save profile", "sv", machine_save_profile},
+    {"load profile", "ld", machine_load_profile},
+    {"profiles", "pl", machine_list_profiles},
+    {"version", "v", machine_version},
+    {"machine", "mm", machine_mode_command},
+    {NULL, NULL, NULL}};
+
+// Match "<name>" or "<name> <args>", returning the argument string
+static char *match_command(char *command, const char *name) {
+  size_t len = strlen(name);
+  if (strncmp(command, name, len) != 0) {
+    return NULL;
+  }
+  if (command[len] == 0) {
+    return command + len;
+  }
+  if (command[len] == ' ') {
+    return command + len + 1;
+  }
+  return NULL;
+}
+
+static void machine_handle_command(char *command) {
+  while (*command == ' ') command++;
+  // "a;;b" still answers three times, scripts count the replies by the ';'
+  if (*command == 0) {
+    reply_err(MACHINE_ERR_UNKNOWN_COMMAND);
+    return;
+  }
+
+  // Prefer the longest matching name ("fast trigger configure" over "fast trigger")
+  const machine_command_t *found = NULL;
+  char *args = NULL;
+  size_t found_len = 0;
+  for (int i = 0; machine_commands[i].name != NULL; i++) {
+    const char *names[] = {machine_commands[i].name, machine_commands[i].alias};
+    for (int n = 0; n < 2; n++) {
+      char *rest = match_command(command, names[n]);
+      if (rest != NULL && strlen(names[n]) > found_len) {
+        found = &machine_commands[i];
+        found_len = strlen(names[n]);
+        args = rest;
+      }
+    }
+  }
+
+  if (found == NULL) {
+    reply_err(MACHINE_ERR_UNKNOWN_COMMAND);
+    return;
+  }
+  // Core 0 doesn't read the FIFO until the scan is done: answer right away
+  // rather than stall the script
+  if (scan_job_busy() && !scan_safe_command(found->handler)) {
+    reply_err(MACHINE_ERR_BUSY);
+    return;
+  }
+
+  int result = found->handler(args);
+  if (result == 0) {
+    reply_ok();
+  } else if (result > 0) {
+    reply_err(result);
+  }
+}
+
+void machine_handle_line(char *line) {
+  // A blank line (e.g. the \n of a \r\n) holds no command at all
+  if (line[strspn(line, " ")] == 0) {
+    return;
+  }
+
+  char *command = line;
+  while (command != NULL) {
+    char *next = strchr(command, ';');
+    if (next != NULL) {
+      *next++ = 0;
+    }
+    machine_handle_command(command);
+    command = next;
+  }
+  fflush(stdout);
+}
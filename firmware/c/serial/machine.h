@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+
+/**
+ * Machine mode for the text console
+ *
+ * Meant for host scripts rather than humans: no echo, no prompts or banners,
+ * every command takes its parameters on the same line and several commands
+ * can be chained with ';'. Each command answers with exactly one line, an
+ * empty one between or after ';' with ERR 1 (a blank line gets no answer):
+ *
+ *   OK [key=value ...]
+ *   ERR <code>
+ *
+ * Example: "gc trig=3 out=1 delay=1000 width=2500;a;g"
+ */
+
+#define MACHINE_ERR_UNKNOWN_COMMAND 1
+#define MACHINE_ERR_BAD_ARGUMENT 2
+#define MACHINE_ERR_TIMEOUT 3
+#define MACHINE_ERR_FAILED 4
+#define MACHINE_ERR_BUSY 5  // A pinout scan is running
+
+/**
+ * @brief Whether the console is currently in machine mode
+ */
+bool machine_mode_active();
+
+/**
+ * @brief Enter or leave machine mode
+ */
+void machine_mode_set(bool enabled);
+
+/**
+ * @brief Run one input line (one or more ';'-separated commands)
+ * @param line The line, modified in place
+ */
+void machine_handle_line(char *line);
@@ -4,26 +4,47 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "hardware/clocks.h"
 #include "hardware/watchdog.h"
 #include "pico/multicore.h"
 #include "pico/stdlib.h"
 
-#include "blueTag.h"
+#include "blueTag_api.h"
+#include "burst.h"
+#include "campaign.h"
+#include "config_store.h"
+#include "console_out.h"
+#include "core_link.h"
 #include "glitcher.h"
 #include "glitcher_commands.h"
+#include "hv_autotune.h"
+#include "hv_sense.h"
+#include "hv_telemetry.h"
+#include "jtag_bsr.h"
+#include "machine.h"
+#include "multishot.h"
+#include "picoemp.h"
+#include "pinout_cache.h"
+#include "protocol.h"
+#include "scan_job.h"
 #include "serial_utils.h"
+#include "swd_mem.h"
 #include "board_config.h"
 
-#define FIRMWARE_VERSION "2.1.0.0"
-
 static char serial_buffer[256];
 static char last_command[256];
 
+// Scan started from this console: its progress and results are printed at the prompt
+static uint32_t console_scan_id = 0;  // 0: none
+static uint32_t console_scan_event;
+static bool at_prompt = false;
+
 #define PULSE_DELAY_CYCLES_DEFAULT 0
 #define PULSE_TIME_CYCLES_DEFAULT 625  // 5us in 8ns cycles
 #define PULSE_TIME_US_DEFAULT 5        // 5us
 #define PULSE_POWER_DEFAULT 0.0122
 static uint32_t pulse_time;
+static uint32_t pulse_cycles;  // Manual pulse width in cycles, 0: use pulse_time
 static uint32_t pulse_delay_cycles;
 static uint32_t pulse_time_cycles;
 static union float_union {
@@ -58,7 +79,15 @@ bool handle_configure_faultier();
 bool handle_glitcher_status();
 bool handle_jtag_scan();
 bool handle_swd_scan();
+bool handle_scan_status();
+bool handle_verify();
+bool handle_scan_cancel();
+bool handle_swd_dump();
+bool handle_bsr_start();
+bool handle_bsr_stop();
+bool handle_bsr_status();
 bool handle_pin_pulsing();
+bool handle_quick_probe();
 bool handle_help();
 bool handle_toggle_all_gpios();
 bool handle_status();
@@ -66,6 +95,23 @@ bool handle_reset();
 bool handle_configure_adc();
 bool handle_display_adc();
 bool handle_firmware_version();
+bool handle_machine_mode();
+bool handle_console_benchmark();
+bool handle_burst();
+bool handle_hv_level();
+bool handle_hv_window();
+bool handle_hv_stats();
+bool handle_multishot();
+bool handle_hv_autotune();
+bool handle_campaign();
+bool handle_campaign_stop();
+bool handle_campaign_status();
+bool handle_save_profile();
+bool handle_load_profile();
+bool handle_list_profiles();
+
+static bool prompt_uint(const char *label, uint32_t *value);
+static void show_prompt();
 
 // Category
 #define CAT_FAULT_INJECTION "Fault Injection"
@@ -86,6 +132,12 @@ static const command_t commands[] = {
     {"internal hvp", "in", "Use internal HV source", handle_internal_hvp, CAT_FAULT_INJECTION},
     {"external hvp", "ex", "Use external HV source", handle_external_hvp, CAT_FAULT_INJECTION},
     {"configure", "cfg", "Configure FI parameters", handle_configure, CAT_FAULT_INJECTION},
+    {"burst", "bu", "Pulse N times at a fixed rate (arm first)", handle_burst, CAT_FAULT_INJECTION},
+    {"multishot", "ms", "Pulse on each trigger edge once charged, N times (arm first)", handle_multishot, CAT_FAULT_INJECTION},
+    {"hv level", "hl", "Show the HV level (needs PIN_HV_SENSE)", handle_hv_level, CAT_FAULT_INJECTION},
+    {"hv window", "hw", "Only fire within X% of a target HV level", handle_hv_window, CAT_FAULT_INJECTION},
+    {"hv stats", "hs", "Show time-to-charge statistics per PWM setting", handle_hv_stats, CAT_FAULT_INJECTION},
+    {"hv autotune", "ha", "Find the fastest stable charge pump setting (fires pulses)", handle_hv_autotune, CAT_FAULT_INJECTION},
 
     // Glitch Commands
     {"glitch", "g", "Trigger glitch", handle_glitch, CAT_GLITCH},
@@ -94,11 +146,22 @@ static const command_t commands[] = {
     {"glitcher status", "gs", "Show glitcher status", handle_glitcher_status, CAT_GLITCH},
     {"configure adc", "ac", "ADC: configure sampling", handle_configure_adc, CAT_GLITCH},
     {"display adc", "av", "ADC: view sampled data", handle_display_adc, CAT_GLITCH},
+    {"campaign", "cp", "Sweep delay/width on the device", handle_campaign, CAT_GLITCH},
+    {"campaign stop", "cx", "Stop the running campaign", handle_campaign_stop, CAT_GLITCH},
+    {"campaign status", "ct", "Show campaign progress", handle_campaign_status, CAT_GLITCH},
 
     // Pinout Scan Commands
     {"jtag scan", "j", "Scan JTAG chain", handle_jtag_scan, CAT_PINOUT_SCAN},
     {"swd scan", "sw", "Scan SWD targets", handle_swd_scan, CAT_PINOUT_SCAN},
+    {"verify", "vf", "Check the cached pinouts, full scan if none answers", handle_verify, CAT_PINOUT_SCAN},
+    {"scan status", "st", "Show the progress of the running scan", handle_scan_status, CAT_PINOUT_SCAN},
+    {"scan cancel", "sx", "Stop the running scan", handle_scan_cancel, CAT_PINOUT_SCAN},
+    {"swd dump", "sd", "Hex dump target memory on the pins found by swd scan", handle_swd_dump, CAT_PINOUT_SCAN},
+    {"bsr start", "bs", "Sample a TAP's boundary-scan register continuously", handle_bsr_start, CAT_PINOUT_SCAN},
+    {"bsr stop", "bx", "Stop boundary-scan sampling", handle_bsr_stop, CAT_PINOUT_SCAN},
+    {"bsr status", "bt", "Show the sample rate and the newest boundary-scan sample", handle_bsr_status, CAT_PINOUT_SCAN},
     {"pin pulsing", "pp", "Pulse test pins", handle_pin_pulsing, CAT_PINOUT_SCAN},
+    {"quick probe", "qp", "Toggle the JTAG quick-reject probe", handle_quick_probe, CAT_PINOUT_SCAN},
 
     // System Commands
     {"help", "h", "Help (this menu)", handle_help, CAT_SYSTEM},
@@ -106,19 +169,72 @@ static const command_t commands[] = {
     {"status", "s", "Show system status", handle_status, CAT_SYSTEM},
     {"reset", "r", "Reset device", handle_reset, CAT_SYSTEM},
     {"version", "v", "Show firmware version", handle_firmware_version, CAT_SYSTEM},
+    {"console bench", "cb", "Measure console throughput", handle_console_benchmark, CAT_SYSTEM},
+    {"save profile", "sv", "Save settings to flash (loaded at boot)", handle_save_profile, CAT_SYSTEM},
+    {"load profile", "ld", "Load settings from flash", handle_load_profile, CAT_SYSTEM},
+    {"profiles", "pl", "List saved profiles", handle_list_profiles, CAT_SYSTEM},
+    {"machine", "mm", "Machine mode for scripts (leave with 'mm off')", handle_machine_mode, CAT_SYSTEM},
 
     // End marker
     {NULL, NULL, NULL, NULL, NULL}};
 
+// Redraw the progress of the console's scan on each new event, print the
+// results once it's over. Only while the prompt is shown and nothing typed.
+static void scan_console_poll() {
+  if (console_scan_id == 0 || !at_prompt || serial_buffer[0] != 0 || machine_mode_active()) {
+    return;
+  }
+  struct scan_job_status status;
+  scan_job_get_status(&status);
+  if (status.id != console_scan_id || status.event == console_scan_event) {
+    return;
+  }
+  console_scan_event = status.event;
+
+  if (status.state == SCAN_JOB_RUNNING) {
+    scan_job_print_progress(&status);
+    return;
+  }
+  if (status.state == SCAN_JOB_PENDING) {
+    return;
+  }
+
+  console_scan_id = 0;
+  if (status.state == SCAN_JOB_DONE) {
+    status.progress = status.total;
+    scan_job_print_progress(&status);
+    printf("\n\n");
+    scan_job_print_result();
+    printf("     Scan took %lu ms\n\n", status.elapsed_ms);
+  } else {
+    printf("\n\n     Scan cancelled after %lu ms\n\n", status.elapsed_ms);
+  }
+  show_prompt();
+}
+
 void read_command() {
   memset(serial_buffer, 0, sizeof(serial_buffer));
+  console_out_flush();
   while (1) {
-    int c = getchar();
+    int c = getchar_timeout_us(CONSOLE_OUT_IDLE_US);
+    if (c == PICO_ERROR_TIMEOUT) {
+      console_out_poll();
+      scan_console_poll();
+      continue;
+    }
     if (c == EOF) {
       return;
     }
 
-    putchar(c);
+    // Binary request frames share the port with the text console
+    if (c == PROTOCOL_FRAME_DELIMITER) {
+      protocol_receive_frame();
+      continue;
+    }
+
+    if (!machine_mode_active()) {
+      putchar(c);
+    }
 
     if (c == '\r' || c == '\n') {
       if (strlen(serial_buffer) > 0) {
@@ -165,18 +281,18 @@ void print_status(uint32_t status) {
   }
 }
 
-static bool multicore_fifo_pop_safe(uint32_t *data) {
-    if (!multicore_fifo_pop_timeout_us(1000000, data)) { // 1 second timeout
-        printf("Error: Multicore response timeout!\n");
-        return false;
-    }
-    return true;
+// core_link_call() that reports a core 0 timeout on the console
+static bool console_call(uint32_t command, uint32_t *result) {
+  if (!core_link_call(command, result)) {
+    printf("Error: Multicore response timeout!\n");
+    return false;
+  }
+  return true;
 }
 
 bool handle_arm(void) {
-  multicore_fifo_push_blocking(SERIAL_CMD_arm);
   uint32_t result;
-  if (!multicore_fifo_pop_safe(&result)) return true;
+  if (!console_call(SERIAL_CMD_arm, &result)) return true;
   if (result == return_ok) {
     printf("Device armed!\n");
   } else {
@@ -186,9 +302,8 @@ bool handle_arm(void) {
 }
 
 bool handle_disarm(void) {
-  multicore_fifo_push_blocking(SERIAL_CMD_disarm);
   uint32_t result;
-  if (!multicore_fifo_pop_safe(&result)) return true;
+  if (!console_call(SERIAL_CMD_disarm, &result)) return true;
   if (result == return_ok) {
     printf("Device disarmed!\n");
   } else {
@@ -198,9 +313,8 @@ bool handle_disarm(void) {
 }
 
 bool handle_pulse(void) {
-  multicore_fifo_push_blocking(SERIAL_CMD_pulse);
   uint32_t result;
-  if (!multicore_fifo_pop_safe(&result)) return true;
+  if (!console_call(SERIAL_CMD_pulse, &result)) return true;
   if (result == return_ok) {
     printf("Pulsed!\n");
   } else {
@@ -210,9 +324,8 @@ bool handle_pulse(void) {
 }
 
 bool handle_enable_timeout(void) {
-  multicore_fifo_push_blocking(SERIAL_CMD_enable_timeout);
   uint32_t result;
-  if (!multicore_fifo_pop_safe(&result)) return true;
+  if (!console_call(SERIAL_CMD_enable_timeout, &result)) return true;
   if (result == return_ok) {
     printf("Timeout enabled!\n");
   } else {
@@ -222,9 +335,8 @@ bool handle_enable_timeout(void) {
 }
 
 bool handle_disable_timeout(void) {
-  multicore_fifo_push_blocking(SERIAL_CMD_disable_timeout);
   uint32_t result;
-  if (!multicore_fifo_pop_safe(&result)) return true;
+  if (!console_call(SERIAL_CMD_disable_timeout, &result)) return true;
   if (result == return_ok) {
     printf("Timeout disabled!\n");
   } else {
@@ -234,11 +346,12 @@ bool handle_disable_timeout(void) {
 }
 
 bool handle_fast_trigger(void) {
-  multicore_fifo_push_blocking(SERIAL_CMD_fast_trigger);
-  uint32_t result = multicore_fifo_pop_blocking();
+  uint32_t result;
+  if (!console_call(SERIAL_CMD_fast_trigger, &result)) return true;
   if (result == return_ok) {
     printf("Fast trigger active...\n");
-    uint32_t trigger_result = multicore_fifo_pop_blocking();
+    uint32_t trigger_result;
+    core_link_read(0, &trigger_result);
     if (trigger_result == return_ok) {
         printf("Triggered!\n");
     } else {
@@ -398,36 +511,35 @@ bool handle_fast_trigger_configure(void) {
   }
 
   // Send configuration to Core 0 (Main)
-  multicore_fifo_push_blocking(SERIAL_CMD_config_pulse_delay_cycles);
-  multicore_fifo_push_blocking(pulse_delay_cycles);
-  if (!multicore_fifo_pop_safe(NULL)) printf("Error: Timeout syncing pulse_delay_cycles.\n");
+  if (!core_link_call_arg(SERIAL_CMD_config_pulse_delay_cycles, pulse_delay_cycles, NULL)) {
+    printf("Error: Timeout syncing pulse_delay_cycles.\n");
+  }
 
-  multicore_fifo_push_blocking(SERIAL_CMD_config_pulse_time_cycles);
-  multicore_fifo_push_blocking(pulse_time_cycles);
-  if (!multicore_fifo_pop_safe(NULL)) printf("Error: Timeout syncing pulse_time_cycles.\n");
-  
-  multicore_fifo_push_blocking(SERIAL_CMD_config_trigger_type);
-  multicore_fifo_push_blocking(trigger_type);
-  if (!multicore_fifo_pop_safe(NULL)) printf("Error: Timeout syncing trigger_type.\n");
+  if (!core_link_call_arg(SERIAL_CMD_config_pulse_time_cycles, pulse_time_cycles, NULL)) {
+    printf("Error: Timeout syncing pulse_time_cycles.\n");
+  }
 
-  multicore_fifo_push_blocking(SERIAL_CMD_config_trigger_pull);
-  multicore_fifo_push_blocking(glitcher.trigger_pull_configuration);
-  if (!multicore_fifo_pop_safe(NULL)) printf("Error: Timeout syncing trigger_pull.\n");
+  if (!core_link_call_arg(SERIAL_CMD_config_trigger_type, trigger_type, NULL)) {
+    printf("Error: Timeout syncing trigger_type.\n");
+  }
 
-  multicore_fifo_push_blocking(SERIAL_CMD_config_glitch_output);
-  multicore_fifo_push_blocking(glitcher.glitch_output);
-  if (!multicore_fifo_pop_safe(NULL)) printf("Error: Timeout syncing glitch_output.\n");
+  if (!core_link_call_arg(SERIAL_CMD_config_trigger_pull, glitcher.trigger_pull_configuration, NULL)) {
+    printf("Error: Timeout syncing trigger_pull.\n");
+  }
+
+  if (!core_link_call_arg(SERIAL_CMD_config_glitch_output, glitcher.glitch_output, NULL)) {
+    printf("Error: Timeout syncing glitch_output.\n");
+  }
 
-  
   // Sincronización de parámetros de Serial con Core 0 (Añadido)
   if (trigger_type == TriggersType_TRIGGER_SERIAL) {
-      multicore_fifo_push_blocking(SERIAL_CMD_config_serial_baud);
-      multicore_fifo_push_blocking(glitcher.serial_baud);
-      if (!multicore_fifo_pop_safe(NULL)) printf("Error: Timeout syncing serial_baud.\n");
+      if (!core_link_call_arg(SERIAL_CMD_config_serial_baud, glitcher.serial_baud, NULL)) {
+        printf("Error: Timeout syncing serial_baud.\n");
+      }
 
-      multicore_fifo_push_blocking(SERIAL_CMD_config_serial_pin);
-      multicore_fifo_push_blocking(glitcher.serial_pin);
-      if (!multicore_fifo_pop_safe(NULL)) printf("Error: Timeout syncing serial_pin.\n");
+      if (!core_link_call_arg(SERIAL_CMD_config_serial_pin, glitcher.serial_pin, NULL)) {
+        printf("Error: Timeout syncing serial_pin.\n");
+      }
   }
 
   printf("\n=== Configuration Complete ===\n");
@@ -446,9 +558,8 @@ bool handle_fast_trigger_configure(void) {
 }
 
 bool handle_internal_hvp(void) {
-  multicore_fifo_push_blocking(SERIAL_CMD_internal_hvp);
   uint32_t result;
-  if (!multicore_fifo_pop_safe(&result)) return true;
+  if (!console_call(SERIAL_CMD_internal_hvp, &result)) return true;
   if (result == return_ok) {
     printf("Internal HVP mode active!\n");
   } else {
@@ -458,9 +569,8 @@ bool handle_internal_hvp(void) {
 }
 
 bool handle_external_hvp(void) {
-  multicore_fifo_push_blocking(SERIAL_CMD_external_hvp);
   uint32_t result;
-  if (!multicore_fifo_pop_safe(&result)) return true;
+  if (!console_call(SERIAL_CMD_external_hvp, &result)) return true;
   if (result == return_ok) {
     printf("External HVP mode active!\n");
   } else {
@@ -493,36 +603,67 @@ bool handle_configure(void) {
   else
     pulse_power.f = strtof(serial_buffer, unused);
 
-  multicore_fifo_push_blocking(SERIAL_CMD_config_pulse_time);
-  multicore_fifo_push_blocking(pulse_time);
-  uint32_t result = multicore_fifo_pop_blocking();
-  if (result != return_ok) {
+  printf(" pulse_cycles, exact width in %lu MHz cycles (current: %lu, 0 = use pulse_time)?\n> ",
+         clock_get_hz(clk_sys) / 1000000, pulse_cycles);
+  read_command();
+  printf("\n");
+  if (serial_buffer[0] != 0) {
+    uint32_t val;
+    if (safe_strtoul(serial_buffer, &val)) {
+        pulse_cycles = val;
+    } else {
+        printf("Invalid value, keeping current.\n");
+    }
+  }
+
+  uint32_t pwm_freq = picoemp_get_pwm_freq();
+  printf(" pwm_freq, charge pump Hz (current: %lu, default: %d)?\n> ", pwm_freq, PICOEMP_PWM_FREQ_DEFAULT);
+  read_command();
+  printf("\n");
+  if (serial_buffer[0] != 0) {
+    uint32_t val;
+    if (safe_strtoul(serial_buffer, &val) && val >= PICOEMP_PWM_FREQ_MIN && val <= PICOEMP_PWM_FREQ_MAX) {
+        pwm_freq = val;
+    } else {
+        printf("Invalid value (%d-%d), keeping current.\n", PICOEMP_PWM_FREQ_MIN, PICOEMP_PWM_FREQ_MAX);
+    }
+  }
+
+  uint32_t result;
+  if (!core_link_call_arg(SERIAL_CMD_config_pulse_time, pulse_time, &result) || result != return_ok) {
     printf("Config pulse_time failed.");
   }
 
-  multicore_fifo_push_blocking(SERIAL_CMD_config_pulse_power);
-  multicore_fifo_push_blocking(pulse_power.ui32);
-  result = multicore_fifo_pop_blocking();
-  if (result != return_ok) {
+  if (!core_link_call_arg(SERIAL_CMD_config_pulse_power, pulse_power.ui32, &result) || result != return_ok) {
     printf("Config pulse_power failed.");
   }
 
-  printf("pulse_time=%d, pulse_power=%f\n", pulse_time, pulse_power.f);
+  // Sent after pulse_time, which resets the cycle count on core 0
+  if (!core_link_call_arg(SERIAL_CMD_config_pulse_cycles, pulse_cycles, &result) || result != return_ok) {
+    printf("Config pulse_cycles failed.");
+  }
+
+  if (!core_link_call_arg(SERIAL_CMD_config_pwm_freq, pwm_freq, &result) || result != return_ok) {
+    printf("Config pwm_freq failed.");
+  }
+
+  printf("pulse_time=%d, pulse_cycles=%lu, pulse_power=%f, pwm_freq=%lu\n", pulse_time, pulse_cycles, pulse_power.f,
+         pwm_freq);
 
   return true;
 }
 
 bool handle_glitch(void) {
-  multicore_fifo_push_blocking(SERIAL_CMD_glitch);
-  
-  uint32_t resp1 = multicore_fifo_pop_blocking();
+  uint32_t resp1;
+  if (!console_call(SERIAL_CMD_glitch, &resp1)) return true;
   if (resp1 != return_ok) {
     printf("Glitch command rejected by core0.\n");
     return false;
   }
   
   // Wait for the trigger to finish or timeout
-  uint32_t resp2 = multicore_fifo_pop_blocking();
+  uint32_t resp2;
+  core_link_read(0, &resp2);
   if (resp2 == return_ok) {
       printf("\n[AUTO] Glitch complete.\n");
   } else {
@@ -706,37 +847,10 @@ bool handle_configure_glitcher(void) {
   glitcher_set_config(glitcher.trigger_type, glitcher.glitch_output, glitcher.delay_before_pulse, glitcher.pulse_width);
   
   // Synchronize ALL parameters with Core 0
-  multicore_fifo_push_blocking(SERIAL_CMD_config_trigger_type);
-  multicore_fifo_push_blocking(glitcher.trigger_type);
-  if (!multicore_fifo_pop_safe(NULL)) printf("     Error: Timeout syncing trigger_type.\n");
-
-  multicore_fifo_push_blocking(SERIAL_CMD_config_trigger_pull);
-  multicore_fifo_push_blocking(glitcher.trigger_pull_configuration);
-  if (!multicore_fifo_pop_safe(NULL)) printf("     Error: Timeout syncing trigger_pull.\n");
-
-  multicore_fifo_push_blocking(SERIAL_CMD_config_glitch_output);
-  multicore_fifo_push_blocking(glitcher.glitch_output);
-  if (!multicore_fifo_pop_safe(NULL)) printf("     Error: Timeout syncing glitch_output.\n");
-
-  multicore_fifo_push_blocking(SERIAL_CMD_config_pulse_delay_cycles);
-  multicore_fifo_push_blocking(glitcher.delay_before_pulse);
-  if (!multicore_fifo_pop_safe(NULL)) printf("     Error: Timeout syncing pulse_delay.\n");
-
-  multicore_fifo_push_blocking(SERIAL_CMD_config_pulse_time_cycles);
-  multicore_fifo_push_blocking(glitcher.pulse_width);
-  if (!multicore_fifo_pop_safe(NULL)) printf("     Error: Timeout syncing pulse_width.\n");
-
-  // Envío de parámetros Serial al otro núcleo (Añadido)
-  if (glitcher.trigger_type == TriggersType_TRIGGER_SERIAL) {
-      multicore_fifo_push_blocking(SERIAL_CMD_config_serial_baud);
-      multicore_fifo_push_blocking(glitcher.serial_baud);
-      if (!multicore_fifo_pop_safe(NULL)) printf("     Error: Timeout syncing serial_baud.\n");
-
-      multicore_fifo_push_blocking(SERIAL_CMD_config_serial_pin);
-      multicore_fifo_push_blocking(glitcher.serial_pin);
-      if (!multicore_fifo_pop_safe(NULL)) printf("     Error: Timeout syncing serial_pin.\n");
+  if (!core_link_sync_glitcher()) {
+    printf("     Error: Timeout syncing the glitcher configuration.\n");
   }
-  
+
   printf("     Glitcher configured successfully\n");
 
   printf("\n[AUTO] Arming Device and Waiting for Trigger...\n");
@@ -826,13 +940,275 @@ bool handle_configure_faultier(void) {
   return true;
 }
 
+static void queue_scan(const struct scan_job_params *params) {
+  uint32_t result;
+  if (!core_link_call_arg(SERIAL_CMD_scan_start, (uint32_t)(uintptr_t)params, &result)) {
+    printf("Error: Timeout starting scan.\n");
+  } else if (result == return_ok) {
+    struct scan_job_status status;
+    scan_job_get_status(&status);
+    console_scan_id = status.id;
+    console_scan_event = status.event;
+    printf("     Scan #%lu started in the background, 'scan cancel' (sx) stops it.\n", status.id);
+  } else {
+    printf("Can't scan now: disarm and stop any campaign or scan first.\n");
+  }
+}
+
+static void start_scan(enum scan_job_type type, uint32_t *channels) {
+  char label[32];
+  snprintf(label, sizeof(label), "Channels to scan (%d-%u)", type == SCAN_JOB_JTAG ? 4 : 2, maxChannels);
+  if (!prompt_uint(label, channels)) {
+    return;
+  }
+  struct scan_job_params params = {
+      .type = type,
+      .channels = *channels,
+      .pulse_pins = jPulsePins,
+      .quick_probe = jQuickProbe,
+  };
+  if (!scan_job_valid(&params)) {
+    printf(" Invalid number of channels\n");
+    return;
+  }
+  queue_scan(&params);
+}
+
+bool handle_verify(void) {
+  // Same kind of target as last time: check its cached pinouts, scan like
+  // back then if none of them answers
+  struct pinout_cache_entry latest;
+  if (pinout_cache_get(PINOUT_CACHE_ANY, &latest, 1) == 0) {
+    printf(" No pinout cached yet, run 'jtag scan' or 'swd scan' first\n");
+    return true;
+  }
+  struct scan_job_params params = {
+      .type = latest.type,
+      .channels = latest.channels,
+      .pulse_pins = jPulsePins,
+      .quick_probe = jQuickProbe,
+      .verify = true,
+  };
+  if (!scan_job_valid(&params)) {
+    printf(" The cached pinout doesn't fit the current channel map\n");
+    return true;
+  }
+  printf("     Checking cached %s pinouts, %lu channel scan if none answers\n",
+         latest.type == SCAN_JOB_JTAG ? "JTAG" : "SWD", params.channels);
+  queue_scan(&params);
+  return true;
+}
+
 bool handle_jtag_scan(void) {
-  jtagScan();
+  static uint32_t channels = 8;
+  start_scan(SCAN_JOB_JTAG, &channels);
   return true;
 }
 
 bool handle_swd_scan(void) {
-  swdScan();
+  static uint32_t channels = 8;
+  start_scan(SCAN_JOB_SWD, &channels);
+  return true;
+}
+
+bool handle_scan_status(void) {
+  static const char *const states[] = {"Idle", "Queued", "Running", "Done", "Cancelled"};
+  struct scan_job_status status;
+  scan_job_get_status(&status);
+  if (status.id == 0) {
+    printf("No scan since boot\n");
+    return true;
+  }
+  printf("Scan #%lu (%s, %lu channels): %s\n", status.id, status.params.type == SCAN_JOB_JTAG ? "JTAG" : "SWD",
+         status.params.channels, states[status.state]);
+  printf("- Permutations: %lu/%lu in this phase\n", status.progress, status.total);
+  printf("- Elapsed: %lu ms\n", status.elapsed_ms);
+  if (status.state == SCAN_JOB_DONE) {
+    printf("- Found: %s\n", status.cached ? "yes (cached pinout)" : status.found ? "yes" : "no");
+  }
+  return true;
+}
+
+bool handle_scan_cancel(void) {
+  if (!scan_job_busy()) {
+    printf("No scan running\n");
+    return true;
+  }
+  scan_job_cancel();
+  printf("Cancelling scan...\n");
+  return true;
+}
+
+bool handle_swd_dump(void) {
+  static uint32_t address = 0;
+  static uint32_t length = 256;
+
+  if (scan_job_busy()) {
+    printf(" Wait for the scan to finish\n");
+    return true;
+  }
+  if (swdTargetCount == 0) {
+    printf(" Run swd scan first\n");
+    return true;
+  }
+
+  printf(" Address (current: 0x%08lx)? ", address);
+  read_command();
+  printf("\n");
+  if (serial_buffer[0] != 0) {
+    char *end;
+    uint32_t value = strtoul(serial_buffer, &end, 0);
+    if (end == serial_buffer || (value & 3) != 0) {
+      printf(" Invalid address, it must be word aligned\n");
+      return true;
+    }
+    address = value;
+  }
+  if (!prompt_uint("Length (bytes)", &length)) {
+    return true;
+  }
+
+  const struct bluetag_swd_target *dp = &swdTargets[0];
+  struct swd_mem_target target = {
+      .swclk = channelGpio[dp->swclk],
+      .swdio = channelGpio[dp->swdio],
+      .apsel = 0,
+      .multidrop = dp->multidrop,
+      .targetsel = dp->targetsel,
+  };
+  if (!swd_mem_begin(&target)) {
+    printf(" Target didn't power up its debug domain\n");
+    return true;
+  }
+
+  uint32_t words[64];
+  uint32_t words_left = (length + 3) / 4;
+  uint32_t current = address;
+  uint64_t start = time_us_64();
+  while (words_left > 0) {
+    uint32_t count = MIN(words_left, count_of(words));
+    uint32_t done = swd_mem_read(current, words, count);
+    for (uint32_t i = 0; i < done; i += 4) {
+      console_out_printf(" %08lx:", current + i * 4);
+      for (uint32_t j = i; j < i + 4 && j < done; j++) {
+        console_out_printf(" %08lx", words[j]);
+      }
+      console_out_printf("\n");
+    }
+    current += done * 4;
+    words_left -= done;
+    if (done < count) {
+      console_out_printf(" Read failed at 0x%08lx\n", current);
+      break;
+    }
+  }
+  uint64_t elapsed_us = time_us_64() - start;
+  swd_mem_end();
+
+  console_out_printf(" %lu bytes in %llu us\n", current - address, elapsed_us);
+  console_out_flush();
+  return true;
+}
+
+// Sampler state and the newest sample, cell 0 (nearest TDO) rightmost
+static void print_bsr_status(void) {
+  struct jtag_bsr_status status;
+  jtag_bsr_get_status(&status);
+  if (status.bsr_length == 0) {
+    printf(" Sampler not started\n");
+    return;
+  }
+  printf(" %s: %lu-bit BSR, %lu TCK clocks per sample\n", status.running ? "Sampling" : "Stopped", status.bsr_length,
+         status.period_clocks);
+  printf(" %lu samples at %lu samples/s\n", status.samples, status.sample_rate);
+
+  uint32_t words[JTAG_BSR_SAMPLE_WORDS(JTAG_BSR_MAX_LEN)];
+  uint32_t first = status.samples > 0 ? status.samples - 1 : 0;
+  if (jtag_bsr_read(&first, words, 1) == 0) {
+    return;
+  }
+  console_out_printf(" Sample %lu:", first);
+  for (int i = JTAG_BSR_SAMPLE_WORDS(status.bsr_length) - 1; i >= 0; i--) {
+    console_out_printf(" %08lx", words[i]);
+  }
+  console_out_printf("\n");
+  console_out_flush();
+}
+
+bool handle_bsr_start(void) {
+  static uint32_t device = 0;
+  static uint32_t opcode = 0;
+  static uint32_t bsr_length = 0;
+
+  if (scan_job_busy()) {
+    printf(" Wait for the scan to finish\n");
+    return true;
+  }
+  if (jtag_bsr_running()) {
+    printf(" Already sampling, stop it first\n");
+    return true;
+  }
+  if (jtagChainCount == 0) {
+    printf(" Run jtag scan first\n");
+    return true;
+  }
+  const struct bluetag_jtag_chain *chain = &jtagChains[0];
+  if (!chain->ir_exact) {
+    printf(" The IR lengths of the chain are unknown\n");
+    return true;
+  }
+
+  if (!prompt_uint("Device", &device)) {
+    return true;
+  }
+  if (device >= chain->device_count) {
+    printf(" The chain has %u device(s)\n", chain->device_count);
+    return true;
+  }
+  printf(" SAMPLE/PRELOAD opcode (current: 0x%lx)? ", opcode);
+  read_command();
+  printf("\n");
+  if (serial_buffer[0] != 0) {
+    char *end;
+    uint32_t value = strtoul(serial_buffer, &end, 0);
+    if (end == serial_buffer) {
+      printf(" Invalid opcode\n");
+      return true;
+    }
+    opcode = value;
+  }
+  if (!prompt_uint("BSR length (0 = measure)", &bsr_length)) {
+    return true;
+  }
+
+  struct jtag_bsr_target target = {
+      .tdi = channelGpio[chain->tdi],
+      .tdo = channelGpio[chain->tdo],
+      .tck = channelGpio[chain->tck],
+      .tms = channelGpio[chain->tms],
+      .device = device,
+      .device_count = chain->device_count,
+      .ir_lengths = chain->ir_lengths,
+      .opcode = opcode,
+      .bsr_length = bsr_length,
+  };
+  if (!jtag_bsr_start(&target)) {
+    printf(" Sampler didn't start: check the opcode (not 0, fits the IR) and the BSR length\n");
+    return true;
+  }
+  sleep_ms(100);  // Long enough for a meaningful rate
+  print_bsr_status();
+  return true;
+}
+
+bool handle_bsr_stop(void) {
+  jtag_bsr_stop();
+  print_bsr_status();
+  return true;
+}
+
+bool handle_bsr_status(void) {
+  print_bsr_status();
   return true;
 }
 
@@ -846,16 +1222,24 @@ bool handle_pin_pulsing(void) {
   return true;
 }
 
+bool handle_quick_probe(void) {
+  jQuickProbe = !jQuickProbe;
+  if (jQuickProbe) {
+    printf("     Quick-reject probe activated.\n\n");
+  } else {
+    printf("     Quick-reject probe deactivated.\n\n");
+  }
+  return true;
+}
+
 bool handle_help(void) {
   // Return false to show help menu
   return false;
 }
 
 bool handle_toggle_all_gpios(void) {
-  multicore_fifo_push_blocking(SERIAL_CMD_toggle_gp_all);
-
   uint32_t result;
-  if (!multicore_fifo_pop_safe(&result)) return true;
+  if (!console_call(SERIAL_CMD_toggle_gp_all, &result)) return true;
   if (result == return_ok) {
     printf("All GPIOs (0-7) toggled successfully.\n");
   } else {
@@ -866,14 +1250,14 @@ bool handle_toggle_all_gpios(void) {
 }
 
 bool handle_status(void) {
-  multicore_fifo_push_blocking(SERIAL_CMD_status);
   uint32_t result;
-// ...
-  if (!multicore_fifo_pop_safe(&result)) return true;
+  if (!console_call(SERIAL_CMD_status, &result)) return true;
   if (result == return_ok) {
     uint32_t status_val;
-    if (multicore_fifo_pop_safe(&status_val)) {
+    if (core_link_read(1000000, &status_val)) {
       print_status(status_val);
+      printf("- Last recharge: %lu us\n", picoemp_last_recharge_us());
+      printf("- Charge pump: %lu Hz, duty %.4f\n", picoemp_get_pwm_freq(), pulse_power.f);
     }
   } else {
     printf("Getting status failed!\n");
@@ -913,6 +1297,12 @@ void display_command_help(const char* command_name) {
   printf("Command '%s' not found. Type 'help' for a list of commands.\n", command_name);
 }
 
+// Commands that don't need core 0, which is busy while a scan runs
+static bool scan_safe_command(command_handler_t handler) {
+  return handler == handle_scan_status || handler == handle_scan_cancel || handler == handle_bsr_status ||
+         handler == handle_firmware_version;
+}
+
 bool handle_command(char* command) {
   // Check for empty command (repeat last command)
   if (command[0] == 0 && last_command[0] != 0) {
@@ -949,6 +1339,10 @@ bool handle_command(char* command) {
   for (int i = 0; commands[i].name != NULL; i++) {
     if (strcmp(command, commands[i].name) == 0 ||
         strcmp(command, commands[i].alias) == 0) {
+      if (scan_job_busy() && !scan_safe_command(commands[i].handler)) {
+        printf("A scan is running: 'scan status' (st) or 'scan cancel' (sx)\n");
+        return true;
+      }
       return commands[i].handler();
     }
   }
@@ -958,7 +1352,7 @@ bool handle_command(char* command) {
 }
 
 void display_help() {
-  printf("=== FaultyCat 2 Command Menu ===\n\n");
+  console_out_printf("=== FaultyCat 2 Command Menu ===\n\n");
 
   // Track the current category
   const char* current_category = NULL;
@@ -968,17 +1362,18 @@ void display_help() {
     // If we're entering a new category, print the category header
     if (current_category == NULL || strcmp(current_category, commands[i].category) != 0) {
       current_category = commands[i].category;
-      printf("\n%s:\n", current_category);
+      console_out_printf("\n%s:\n", current_category);
     }
 
     // Print the command
-    printf("[%s] - %s\n",
+    console_out_printf("[%s] - %s\n",
            commands[i].alias,
            commands[i].description);
   }
 
-  printf("\n");
-  printf("- <Enter> - Repeat last command\n");
+  console_out_printf("\n");
+  console_out_printf("- <Enter> - Repeat last command\n");
+  console_out_flush();
 }
 
 // Add these functions at the end of the file before serial_console()
@@ -1033,21 +1428,20 @@ bool handle_display_adc(void) {
   if (step == 0)
     step = 1;
 
-  // Display samples
+  // Display samples, one buffered write per row
   for (uint32_t i = 0; i < sample_count; i += step) {
     if (i >= display_count * step)
       break;
 
     // Print index and value
-    printf(" %5lu | %5u | ", i, buffer[i]);
+    console_out_printf(" %5lu | %5u | ", i, buffer[i]);
 
     // Print simple bar chart representation
     int bar_length = buffer[i] / 10;  // Scale to reasonable length
-    for (int j = 0; j < bar_length; j++) {
-      printf("#");
-    }
-    printf("\n");
+    console_out_repeat('#', bar_length);
+    console_out_putc('\n');
   }
+  console_out_flush();
 
   printf("\n Note: Displaying %lu out of %lu samples\n", display_count, sample_count);
   printf(" To see all data, use a data visualization tool with the raw values\n");
@@ -1060,6 +1454,417 @@ bool handle_firmware_version(void) {
   return true;
 }
 
+bool handle_console_benchmark(void) {
+  const uint32_t total_bytes = 16 * 1024;
+  struct console_out_benchmark result;
+
+  printf("Writing %lu bytes per run...\n", total_bytes);
+  console_out_benchmark(total_bytes, &result);
+  printf("\nConsole throughput:\n");
+  printf("- putchar:                  %lu bytes/s\n", result.direct_bps);
+  printf("- console_out, line flush:  %lu bytes/s, %lu writes\n", result.line_bps, result.line_writes);
+  printf("- console_out:              %lu bytes/s, %lu writes\n", result.buffered_bps, result.buffered_writes);
+  return true;
+}
+
+static void show_prompt() {
+  if (last_command[0] != 0) {
+    printf("[%s] > ", last_command);
+  } else {
+    printf(" > ");
+  }
+}
+
+static bool prompt_uint(const char *label, uint32_t *value) {
+  printf(" %s (current: %lu)? ", label, *value);
+  read_command();
+  printf("\n");
+  if (serial_buffer[0] == 0) {
+    return true;
+  }
+  if (!safe_strtoul(serial_buffer, value)) {
+    printf(" Invalid value\n");
+    return false;
+  }
+  return true;
+}
+
+bool handle_burst(void) {
+  static uint32_t count = 10;
+  static uint32_t rate_hz = 10;
+
+  if (!prompt_uint("Pulses", &count) || !prompt_uint("Rate (pulses/s)", &rate_hz)) {
+    return true;
+  }
+  if (rate_hz == 0) {
+    printf(" Invalid rate\n");
+    return true;
+  }
+
+  struct burst_config config = {.count = count, .period_us = 1000000 / rate_hz, .width_cycles = 0};
+  uint32_t result;
+  if (!core_link_call_arg(SERIAL_CMD_burst, (uint32_t)(uintptr_t)&config, &result)) {
+    printf("Error: Timeout starting burst.\n");
+    return true;
+  }
+  if (result != return_ok) {
+    printf("Burst rejected: arm first, use internal HVP, at most %d pulses.\n", BURST_MAX_PULSES);
+    return true;
+  }
+  printf("Bursting...\n");
+  core_link_read(0, &result);
+
+  const struct burst_result *burst = burst_get_result();
+  printf("Fired %lu, skipped %lu (not charged or outside the HV window)\n", burst->fired, burst->skipped);
+  for (uint32_t i = 0; i < burst->count; i++) {
+    if (burst->timestamps_us[i] == BURST_SKIPPED) {
+      console_out_printf(" %4lu  skipped      ", i);
+    } else {
+      console_out_printf(" %4lu  %10lu us", i, burst->timestamps_us[i]);
+    }
+    if (burst->levels[i] != HV_SENSE_UNAVAILABLE) {
+      console_out_printf("  level %u", burst->levels[i]);
+    }
+    console_out_putc('\n');
+  }
+  console_out_flush();
+  return true;
+}
+
+// How often the console checks for a key while multishot runs
+#define MULTISHOT_POLL_US 20000
+
+bool handle_multishot(void) {
+  static uint32_t count = 10;
+  static uint32_t timeout_s = 60;
+
+  if (!prompt_uint("Shots", &count) || !prompt_uint("Timeout (s)", &timeout_s)) {
+    return true;
+  }
+  if (timeout_s == 0 || timeout_s > MULTISHOT_MAX_TIMEOUT_MS / 1000) {
+    printf("Timeout must be 1 to %d s.\n", MULTISHOT_MAX_TIMEOUT_MS / 1000);
+    return true;
+  }
+
+  // Delay, width and edge come from the glitcher configuration on core 0
+  struct multishot_config config = {.count = count, .timeout_ms = timeout_s * 1000};
+  uint32_t result;
+  if (!core_link_call_arg(SERIAL_CMD_multishot, (uint32_t)(uintptr_t)&config, &result)) {
+    printf("Error: Timeout starting multishot.\n");
+    return true;
+  }
+  if (result != return_ok) {
+    printf("Multishot rejected: arm first, use internal HVP, at most %d shots, glitcher width >= 2.\n",
+           MULTISHOT_MAX_SHOTS);
+    return true;
+  }
+  printf("Waiting for %s edges on GP%d (delay %lu, width %lu cycles), any key cancels...\n",
+         glitcher.trigger_type == TriggersType_TRIGGER_FALLING_EDGE ? "falling" : "rising", PIN_TRIGGER,
+         glitcher.delay_before_pulse, glitcher.pulse_width);
+  while (!core_link_read(MULTISHOT_POLL_US, &result)) {
+    if (getchar_timeout_us(0) != PICO_ERROR_TIMEOUT) {
+      multishot_cancel();
+    }
+  }
+
+  const struct multishot_result *shots = multishot_get_result();
+  printf("Fired %lu of %lu%s\n", shots->fired, shots->count, shots->cancelled ? " (cancelled)" : "");
+  for (uint32_t i = 0; i < shots->fired; i++) {
+    console_out_printf(" %4lu  %10lu us\n", i, shots->timestamps_us[i]);
+  }
+  console_out_flush();
+  return true;
+}
+
+static bool read_hv_level(uint16_t *level) {
+  uint32_t result;
+  uint32_t value;
+  if (!core_link_call(SERIAL_CMD_hv_level, &result) || result != return_ok || !core_link_read(1000000, &value)) {
+    printf("Error: Timeout reading HV level.\n");
+    return false;
+  }
+  *level = value;
+  return true;
+}
+
+bool handle_hv_level(void) {
+  uint16_t level;
+  uint16_t target;
+  uint8_t pct;
+  if (!read_hv_level(&level)) {
+    return true;
+  }
+  if (level == HV_SENSE_UNAVAILABLE) {
+    printf("No HV sense input (define PIN_HV_SENSE in board_config.h).\n");
+    return true;
+  }
+  hv_sense_get_window(&target, &pct);
+  printf("HV level: %u\n", level);
+  if (target) {
+    printf("Window:   %u +/- %u%% (%s)\n", target, pct, hv_sense_in_window(level) ? "inside" : "outside");
+  } else {
+    printf("Window:   off\n");
+  }
+  return true;
+}
+
+bool handle_hv_window(void) {
+  uint16_t target;
+  uint8_t pct;
+  hv_sense_get_window(&target, &pct);
+
+  printf(" Target level (current: %u, 0 = off, 'c' = use the level now; arm and let it charge first)? ", target);
+  read_command();
+  printf("\n");
+  if (strcmp(serial_buffer, "c") == 0) {
+    if (!read_hv_level(&target)) {
+      return true;
+    }
+    if (target == HV_SENSE_UNAVAILABLE) {
+      printf(" No HV sense input.\n");
+      return true;
+    }
+  } else if (serial_buffer[0] != 0) {
+    uint32_t val;
+    if (!safe_strtoul(serial_buffer, &val) || val >= HV_SENSE_UNAVAILABLE) {
+      printf(" Invalid value\n");
+      return true;
+    }
+    target = val;
+  }
+
+  uint32_t window = pct;
+  if (!prompt_uint("Window (%)", &window) || window > 100) {
+    return true;
+  }
+  hv_sense_set_window(target, window);
+  if (target) {
+    printf("Pulses fire only at HV level %u +/- %lu%%.\n", target, window);
+  } else {
+    printf("HV window off.\n");
+  }
+  return true;
+}
+
+bool handle_hv_stats(void) {
+  bool any = false;
+  for (uint32_t i = 0; i < HV_TELEMETRY_SETTINGS; i++) {
+    const struct hv_charge_stats *stats = hv_telemetry_get(i);
+    if (stats == NULL) {
+      continue;
+    }
+    any = true;
+    console_out_printf("%5lu Hz, duty %.4f: %lu charges, min %lu us, mean %lu us, max %lu us\n", stats->freq_hz,
+                       stats->duty, stats->count, stats->min_us, (uint32_t)(stats->sum_us / stats->count),
+                       stats->max_us);
+    for (uint32_t b = 0; b < HV_TELEMETRY_BUCKETS; b++) {
+      if (stats->buckets[b] > 0) {
+        console_out_printf("   >= %6lu us: %lu\n", hv_telemetry_bucket_floor_us(b), stats->buckets[b]);
+      }
+    }
+  }
+  console_out_flush();
+  if (!any) {
+    printf("No charge cycles recorded yet (arm, then pulse).\n");
+  }
+  return true;
+}
+
+bool handle_hv_autotune(void) {
+  printf(" This fires up to %d pulses. Continue (y/n)? ", (HV_AUTOTUNE_SHOTS + 1) * HV_AUTOTUNE_CANDIDATES);
+  read_command();
+  printf("\n");
+  if (strcmp(serial_buffer, "y") != 0) {
+    return true;
+  }
+
+  uint32_t result;
+  if (!core_link_call(SERIAL_CMD_hv_autotune, &result)) {
+    printf("Error: Timeout starting autotune.\n");
+    return true;
+  }
+  if (result != return_ok) {
+    printf("Autotune rejected: arm first and use internal HVP.\n");
+    return true;
+  }
+  printf("Tuning...\n");
+  core_link_read(0, &result);
+
+  const struct hv_autotune_result *tune = hv_autotune_get_result();
+  for (uint32_t i = 0; i < tune->count; i++) {
+    const struct hv_autotune_candidate *candidate = &tune->candidates[i];
+    if (candidate->mean_us == 0) {
+      printf(" %5lu Hz, duty %.4f: did not charge\n", candidate->freq_hz, candidate->duty);
+    } else {
+      printf(" %5lu Hz, duty %.4f: mean %lu us (%lu-%lu)%s\n", candidate->freq_hz, candidate->duty,
+             candidate->mean_us, candidate->min_us, candidate->max_us, candidate->stable ? "" : ", unstable");
+    }
+  }
+  if (!tune->found) {
+    printf("No stable setting found, keeping the current one.\n");
+    return true;
+  }
+  pulse_power.f = tune->best.duty;
+  printf("Using %lu Hz, duty %.4f (save a profile to keep it). Disarmed.\n", tune->best.freq_hz, tune->best.duty);
+  return true;
+}
+
+bool handle_campaign(void) {
+  static struct campaign_params params = {
+      .delay_min = 0, .delay_max = 1000, .delay_step = 100,
+      .width_min = 100, .width_max = 1000, .width_step = 100,
+      .repeats = 1, .seed = 0,
+  };
+
+  printf(" Delay and width are in cycles. Uses the current trigger and output.\n");
+  if (!prompt_uint("Delay from", &params.delay_min) || !prompt_uint("Delay to", &params.delay_max) ||
+      !prompt_uint("Delay step", &params.delay_step) || !prompt_uint("Width from", &params.width_min) ||
+      !prompt_uint("Width to", &params.width_max) || !prompt_uint("Width step", &params.width_step) ||
+      !prompt_uint("Attempts per point", &params.repeats) || !prompt_uint("Seed (0 = in order)", &params.seed)) {
+    return true;
+  }
+
+  uint32_t result;
+  if (!core_link_call_arg(SERIAL_CMD_campaign_start, (uint32_t)(uintptr_t)&params, &result)) {
+    printf("Error: Timeout starting campaign.\n");
+  } else if (result == return_ok) {
+    printf("Campaign started, see 'campaign status'.\n");
+  } else {
+    printf("Invalid campaign (empty grid?)\n");
+  }
+  return true;
+}
+
+bool handle_campaign_stop(void) {
+  if (!core_link_call(SERIAL_CMD_campaign_stop, NULL)) {
+    printf("Error: Timeout stopping campaign.\n");
+  } else {
+    printf("Campaign stopped.\n");
+  }
+  return true;
+}
+
+bool handle_campaign_status(void) {
+  struct campaign_status status;
+  campaign_get_status(&status);
+  if (status.id == 0) {
+    printf("No campaign run yet.\n");
+    return true;
+  }
+  printf("Campaign #%lu: %s\n", status.id, status.active ? "running" : "stopped");
+  printf("- Delay:     %lu..%lu step %lu\n", status.params.delay_min, status.params.delay_max, status.params.delay_step);
+  printf("- Width:     %lu..%lu step %lu\n", status.params.width_min, status.params.width_max, status.params.width_step);
+  printf("- Repeats:   %lu, seed %lu\n", status.params.repeats, status.params.seed);
+  printf("- Progress:  %lu / %lu\n", status.completed, status.total);
+  printf("- Triggered: %lu, timeouts: %lu\n", status.triggered, status.timeouts);
+  if (status.skipped > 0) {
+    printf("- Postponed: %lu (HV not ready), last level %u\n", status.skipped, status.last_level);
+  }
+  if (status.resumes > 0) {
+    printf("- Resumed %lu time(s) after a reset\n", status.resumes);
+  }
+  if (status.resets > 0) {
+    printf("- Reset:     %lu attempt(s) took the board down, not retried\n", status.resets);
+  }
+  return true;
+}
+
+// Update the console's copies of the pulse settings from a profile
+void serial_set_pulse_power(float power) {
+  pulse_power.f = power;
+}
+
+static void use_profile(const struct config_profile *profile) {
+  pulse_time = profile->pulse_time_us;
+  pulse_cycles = profile->pulse_cycles;
+  pulse_power.f = profile->pulse_power;
+  pulse_delay_cycles = profile->delay_before_pulse;
+  pulse_time_cycles = profile->pulse_width;
+}
+
+static bool read_profile_name(char name[CONFIG_PROFILE_NAME_LEN + 1]) {
+  printf(" Profile name (max %d chars): ", CONFIG_PROFILE_NAME_LEN);
+  read_command();
+  printf("\n");
+  if (serial_buffer[0] == 0 || strlen(serial_buffer) > CONFIG_PROFILE_NAME_LEN) {
+    printf(" Invalid name\n");
+    return false;
+  }
+  strcpy(name, serial_buffer);
+  return true;
+}
+
+bool handle_save_profile(void) {
+  char name[CONFIG_PROFILE_NAME_LEN + 1];
+  if (!read_profile_name(name)) {
+    return true;
+  }
+
+  // Core 0 owns the live settings and all flash writes
+  uint32_t result;
+  if (!core_link_call_arg(SERIAL_CMD_profile_save, (uint32_t)(uintptr_t)name, &result)) {
+    printf("Error: Timeout saving profile.\n");
+  } else if (result == return_ok) {
+    printf("Profile '%s' saved.\n", name);
+  } else {
+    printf("Saving profile failed.\n");
+  }
+  return true;
+}
+
+bool handle_load_profile(void) {
+  char name[CONFIG_PROFILE_NAME_LEN + 1];
+  if (!read_profile_name(name)) {
+    return true;
+  }
+
+  uint32_t result;
+  if (!core_link_call_arg(SERIAL_CMD_profile_load, (uint32_t)(uintptr_t)name, &result)) {
+    printf("Error: Timeout loading profile.\n");
+    return true;
+  }
+  if (result != return_ok) {
+    printf("No valid profile named '%s'.\n", name);
+    return true;
+  }
+
+  struct config_profile profile;
+  if (config_store_read(name, &profile)) {
+    use_profile(&profile);
+  }
+  printf("Profile '%s' loaded.\n", name);
+  return true;
+}
+
+static void print_profile(const char *name, bool is_boot, void *ctx) {
+  struct config_profile profile;
+  uint32_t *count = ctx;
+  (*count)++;
+  if (!config_store_read(name, &profile)) {
+    printf(" %-16s (unreadable)\n", name);
+    return;
+  }
+  printf(" %-16s %s trig=%lu out=%lu delay=%lu width=%lu time=%luus power=%f\n", name, is_boot ? "*" : " ",
+         profile.trigger_type, profile.glitch_output, profile.delay_before_pulse, profile.pulse_width,
+         profile.pulse_time_us, profile.pulse_power);
+}
+
+bool handle_list_profiles(void) {
+  uint32_t count = 0;
+  printf("Saved profiles (* = loaded at boot):\n");
+  config_store_list(print_profile, &count);
+  if (count == 0) {
+    printf(" none\n");
+  }
+  return true;
+}
+
+bool handle_machine_mode(void) {
+  machine_mode_set(true);
+  printf("OK\n");
+  return true;
+}
+
 void serial_console() {
   multicore_fifo_drain();
   gpio_init(statusLED);
@@ -1071,26 +1876,39 @@ void serial_console() {
   memset(last_command, 0, sizeof(last_command));
 
   pulse_time = PULSE_TIME_US_DEFAULT;
+  pulse_cycles = 0;
   pulse_power.f = PULSE_POWER_DEFAULT;
   pulse_delay_cycles = PULSE_DELAY_CYCLES_DEFAULT;
   pulse_time_cycles = PULSE_TIME_CYCLES_DEFAULT;
 
-  // BlueTag init
-  initChannels();
+  // Core 0 restored the boot profile before starting us
+  struct config_profile profile;
+  if (config_store_read_boot(NULL, &profile)) {
+    use_profile(&profile);
+  }
+
+  struct campaign_status campaign;
+  campaign_get_status(&campaign);
+  if (campaign.active && campaign.resumes > 0) {
+    sleep_ms(1000);
+    printf("Resumed campaign #%lu at attempt %lu/%lu\n", campaign.id, campaign.completed, campaign.total);
+  }
 
   // Show help on startup
   sleep_ms(1000);
   display_help();
 
   while (1) {
-    // Show prompt
-    if (last_command[0] != 0) {
-      printf("[%s] > ", last_command);
-    } else {
-      printf(" > ");
+    if (machine_mode_active()) {
+      read_command();
+      machine_handle_line(serial_buffer);
+      continue;
     }
 
+    show_prompt();
+    at_prompt = true;
     read_command();
+    at_prompt = false;
     printf("\n");
 
     // Handle command (show help if command returns false)
@@ -21,8 +21,39 @@
 #define SERIAL_CMD_glitch 17
 #define SERIAL_CMD_config_glitch_output 18
 #define SERIAL_CMD_config_trigger_pull 19
+// Argument word is a pointer to the NUL-terminated profile name
+#define SERIAL_CMD_profile_save 20
+#define SERIAL_CMD_profile_load 21
+// Argument word is a pointer to a struct campaign_params
+#define SERIAL_CMD_campaign_start 22
+#define SERIAL_CMD_campaign_stop 23
+#define SERIAL_CMD_config_pulse_cycles 24
+// Argument word is a pointer to a struct burst_config. Answers twice:
+// accepted, then done (results via burst_get_result())
+#define SERIAL_CMD_burst 25
+// Answers return_ok, then the HV level (see hv_sense.h)
+#define SERIAL_CMD_hv_level 26
+// Answers twice: accepted, then done (results via hv_autotune_get_result())
+#define SERIAL_CMD_hv_autotune 27
+#define SERIAL_CMD_config_pwm_freq 28
+// Argument word is a pointer to a struct multishot_config (delay, width and
+// edge are taken from the glitcher). Answers twice: accepted, then done
+// (results via multishot_get_result())
+#define SERIAL_CMD_multishot 29
+// Argument word is a pointer to a struct scan_job_params. Answers once the
+// scan is queued; progress and results via scan_job_get_status()
+#define SERIAL_CMD_scan_start 30
+
+#define FIRMWARE_VERSION "2.1.0.0"
 
 #define return_ok 0
 #define return_failed 1
 
 void serial_console();
+
+/**
+ * @brief Update the console's pulse power after machine mode changed it on core 0
+ * @details The console offers its copy as the default in `configure` and sends it
+ *          back to core 0 from there.
+ */
+void serial_set_pulse_power(float power);
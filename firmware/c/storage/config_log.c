@@ -0,0 +1,380 @@
+#include "config_log.h"
+
+#include <string.h>
+
+#define SECTOR_MAGIC 0x324C4346  // "FCL2": the sector after the active one is kept erased
+#define RECORD_MAGIC 0xC0F1
+#define RECORD_ERASED 0xFFFF
+#define RECORD_FLAG_DELETED 0x01
+#define RECORD_ALIGN 8
+
+struct sector_header {
+  uint32_t magic;
+  uint32_t seq;
+};
+
+struct record_header {
+  uint16_t magic;
+  uint8_t kind;
+  uint8_t flags;
+  char name[CONFIG_LOG_NAME_LEN];
+  uint16_t length;
+  uint16_t reserved;
+  uint32_t crc;  // Over the header (crc field as 0) and the payload
+};
+
+// Copy of the sector being reclaimed
+static uint8_t reclaim_buffer[CONFIG_LOG_SECTOR_MAX];
+
+static uint32_t align_up(uint32_t value) {
+  return (value + RECORD_ALIGN - 1) & ~(uint32_t)(RECORD_ALIGN - 1);
+}
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len) {
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+  }
+  return ~crc;
+}
+
+static uint32_t sector_base(const struct config_log *log, uint32_t sector) {
+  return log->flash->base + sector * log->flash->sector_size;
+}
+
+static bool read_sector_header(const struct config_log *log, uint32_t sector, struct sector_header *header) {
+  log->flash->read(sector_base(log, sector), header, sizeof(*header));
+  return header->magic == SECTOR_MAGIC;
+}
+
+static bool names_equal(const char *a, const char *b) {
+  return strncmp(a, b, CONFIG_LOG_NAME_LEN) == 0;
+}
+
+// Compute the record's CRC, reading the payload back from flash
+static uint32_t record_crc(const struct config_log *log, uint32_t offset, const struct record_header *header) {
+  struct record_header copy = *header;
+  copy.crc = 0;
+  uint32_t crc = crc32_update(0, (const uint8_t *)&copy, sizeof(copy));
+
+  uint8_t chunk[64];
+  uint32_t pos = offset + sizeof(copy);
+  uint32_t left = header->length;
+  while (left > 0) {
+    uint32_t n = left < sizeof(chunk) ? left : sizeof(chunk);
+    log->flash->read(pos, chunk, n);
+    crc = crc32_update(crc, chunk, n);
+    pos += n;
+    left -= n;
+  }
+  return crc;
+}
+
+/*
+ * Walk the records of one sector. Returns the offset (relative to the sector)
+ * just past the last valid record. The callback may stop the walk by
+ * returning false.
+ */
+typedef bool (*record_callback_t)(const struct config_log *log, uint32_t offset, const struct record_header *header, void *ctx);
+
+static uint32_t walk_sector(const struct config_log *log, uint32_t sector, record_callback_t callback, void *ctx) {
+  uint32_t base = sector_base(log, sector);
+  uint32_t pos = sizeof(struct sector_header);
+  struct record_header header;
+
+  while (pos + sizeof(header) <= log->flash->sector_size) {
+    log->flash->read(base + pos, &header, sizeof(header));
+    if (header.magic != RECORD_MAGIC) {
+      break;
+    }
+    uint32_t size = align_up(sizeof(header) + header.length);
+    if (pos + size > log->flash->sector_size) {
+      break;
+    }
+    // A torn write ends the sector: nothing valid can follow it
+    if (record_crc(log, base + pos, &header) != header.crc) {
+      break;
+    }
+    if (callback && !callback(log, base + pos, &header, ctx)) {
+      break;
+    }
+    pos += size;
+  }
+  return pos;
+}
+
+// Sectors from oldest to newest, so later matches supersede earlier ones
+static uint32_t sector_in_order(const struct config_log *log, uint32_t index) {
+  return (log->active_sector + 1 + index) % log->sector_count;
+}
+
+struct find_ctx {
+  uint8_t kind;
+  const char *name;
+  bool found;
+  uint32_t offset;
+  struct record_header header;
+};
+
+static bool find_callback(const struct config_log *log, uint32_t offset, const struct record_header *header, void *ctx) {
+  struct find_ctx *find = ctx;
+  if (header->kind == find->kind && names_equal(header->name, find->name)) {
+    find->found = true;
+    find->offset = offset;
+    find->header = *header;
+  }
+  return true;
+}
+
+// Locate the latest record for a key, deleted or not
+static bool find_latest(const struct config_log *log, uint8_t kind, const char *name, struct find_ctx *find) {
+  find->kind = kind;
+  find->name = name;
+  find->found = false;
+
+  for (uint32_t i = 0; i < log->sector_count; i++) {
+    uint32_t sector = sector_in_order(log, i);
+    struct sector_header sh;
+    if (read_sector_header(log, sector, &sh)) {
+      walk_sector(log, sector, find_callback, find);
+    }
+  }
+  return find->found;
+}
+
+static bool append_record(struct config_log *log, const struct record_header *header, const void *data) {
+  uint32_t base = sector_base(log, log->active_sector);
+  if (header->length > 0 && !log->flash->program(base + log->write_offset + sizeof(*header), data, header->length)) {
+    return false;
+  }
+  // Header last: a record only becomes visible once its payload is in place
+  if (!log->flash->program(base + log->write_offset, header, sizeof(*header))) {
+    return false;
+  }
+  log->write_offset += align_up(sizeof(*header) + header->length);
+  return true;
+}
+
+static bool start_sector(struct config_log *log, uint32_t sector, uint32_t seq) {
+  struct sector_header header = {.magic = SECTOR_MAGIC, .seq = seq};
+  if (!log->flash->erase(sector_base(log, sector)) ||
+      !log->flash->program(sector_base(log, sector), &header, sizeof(header))) {
+    return false;
+  }
+  log->active_sector = sector;
+  log->active_seq = seq;
+  log->write_offset = sizeof(header);
+  return true;
+}
+
+/*
+ * Copy the current records of @p source to the active sector, then erase it.
+ * Tombstones are dropped: no older copy of their key can exist elsewhere.
+ * Records already carried over are superseded by their copy, so running this
+ * again after an interruption only copies what's left.
+ */
+static bool reclaim(struct config_log *log, uint32_t source) {
+  uint32_t base = sector_base(log, source);
+  uint32_t used = walk_sector(log, source, NULL, NULL);
+  log->flash->read(base, reclaim_buffer, used);
+
+  uint16_t live[CONFIG_LOG_SECTOR_MAX / sizeof(struct record_header)];
+  uint32_t live_count = 0;
+  uint32_t pos = sizeof(struct sector_header);
+  while (pos < used) {
+    struct record_header header;
+    memcpy(&header, reclaim_buffer + pos, sizeof(header));
+    struct find_ctx find;
+    find_latest(log, header.kind, header.name, &find);
+    if (find.offset == base + pos && !(header.flags & RECORD_FLAG_DELETED)) {
+      live[live_count++] = pos;
+    }
+    pos += align_up(sizeof(header) + header.length);
+  }
+
+  for (uint32_t i = 0; i < live_count; i++) {
+    struct record_header header;
+    memcpy(&header, reclaim_buffer + live[i], sizeof(header));
+    uint32_t size = align_up(sizeof(header) + header.length);
+    if (log->write_offset + size > log->flash->sector_size ||
+        !append_record(log, &header, reclaim_buffer + live[i] + sizeof(header))) {
+      return false;
+    }
+  }
+  // Only now that every record has a second copy. Clear the magic first: an
+  // erase cut short could leave the header readable but lose a tombstone
+  // further in, bringing a deleted key back.
+  static const uint32_t retired = 0;
+  return log->flash->program(base, &retired, sizeof(retired)) && log->flash->erase(base);
+}
+
+/*
+ * Move on to the spare sector after the active one, carry the current records
+ * of the oldest sector (the one after the spare) over and erase it: it
+ * becomes the next spare. A reset at any point leaves every record in flash
+ * at least once.
+ */
+static bool rotate(struct config_log *log) {
+  uint32_t next = (log->active_sector + 1) % log->sector_count;
+  uint32_t oldest = (log->active_sector + 2) % log->sector_count;
+  struct sector_header sh;
+
+  if (!start_sector(log, next, log->active_seq + 1)) {
+    return false;
+  }
+  if (!read_sector_header(log, oldest, &sh)) {
+    return true;
+  }
+  return reclaim(log, oldest);
+}
+
+static bool erased_from(const struct config_log *log, uint32_t sector, uint32_t offset) {
+  uint32_t base = sector_base(log, sector);
+  uint8_t chunk[64];
+  for (uint32_t pos = offset; pos < log->flash->sector_size; pos += sizeof(chunk)) {
+    uint32_t n = log->flash->sector_size - pos < sizeof(chunk) ? log->flash->sector_size - pos : sizeof(chunk);
+    log->flash->read(base + pos, chunk, n);
+    for (uint32_t i = 0; i < n; i++) {
+      if (chunk[i] != 0xFF) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// The sector after the active one holds a header only if rotate() was cut
+// short: finish carrying its records over
+static bool finish_rotate(struct config_log *log, bool torn) {
+  uint32_t oldest = (log->active_sector + 1) % log->sector_count;
+  struct sector_header sh;
+  if (!read_sector_header(log, oldest, &sh)) {
+    return true;
+  }
+  // A torn copy: the oldest sector is still whole (it's only erased after
+  // the last copy), so start the copy over
+  if (torn && !start_sector(log, log->active_sector, log->active_seq)) {
+    return false;
+  }
+  return reclaim(log, oldest);
+}
+
+bool config_log_init(struct config_log *log, const struct config_log_flash *flash) {
+  log->flash = flash;
+  log->sector_count = flash->size / flash->sector_size;
+  if (flash->sector_size > CONFIG_LOG_SECTOR_MAX || log->sector_count < 3) {
+    return false;
+  }
+
+  bool found = false;
+  for (uint32_t sector = 0; sector < log->sector_count; sector++) {
+    struct sector_header sh;
+    if (read_sector_header(log, sector, &sh) && (!found || (int32_t)(sh.seq - log->active_seq) > 0)) {
+      found = true;
+      log->active_sector = sector;
+      log->active_seq = sh.seq;
+    }
+  }
+
+  if (!found) {
+    return start_sector(log, 0, 1);
+  }
+
+  log->write_offset = walk_sector(log, log->active_sector, NULL, NULL);
+
+  // Leftovers of an interrupted write: don't program over them, move on instead
+  bool torn = !erased_from(log, log->active_sector, log->write_offset);
+  if (torn) {
+    log->write_offset = flash->sector_size;
+  }
+  return finish_rotate(log, torn);
+}
+
+static bool write_record(struct config_log *log, uint8_t kind, uint8_t flags, const char *name, const void *data, uint16_t len) {
+  if (len > CONFIG_LOG_MAX_RECORD) {
+    return false;
+  }
+
+  struct record_header header;
+  memset(&header, 0, sizeof(header));
+  header.magic = RECORD_MAGIC;
+  header.kind = kind;
+  header.flags = flags;
+  strncpy(header.name, name, CONFIG_LOG_NAME_LEN);
+  header.length = len;
+  header.reserved = 0xFFFF;
+  header.crc = 0;
+  uint32_t crc = crc32_update(0, (const uint8_t *)&header, sizeof(header));
+  header.crc = crc32_update(crc, data, len);
+
+  uint32_t size = align_up(sizeof(header) + len);
+  if (log->write_offset + size > log->flash->sector_size) {
+    if (!rotate(log)) {
+      return false;
+    }
+    if (log->write_offset + size > log->flash->sector_size) {
+      return false;
+    }
+  }
+  return append_record(log, &header, data);
+}
+
+bool config_log_write(struct config_log *log, uint8_t kind, const char *name, const void *data, uint16_t len) {
+  return write_record(log, kind, 0, name, data, len);
+}
+
+bool config_log_delete(struct config_log *log, uint8_t kind, const char *name) {
+  struct find_ctx find;
+  if (!find_latest(log, kind, name, &find) || (find.header.flags & RECORD_FLAG_DELETED)) {
+    return false;
+  }
+  return write_record(log, kind, RECORD_FLAG_DELETED, name, NULL, 0);
+}
+
+int config_log_read(const struct config_log *log, uint8_t kind, const char *name, void *data, size_t max) {
+  struct find_ctx find;
+  if (!find_latest(log, kind, name, &find) || (find.header.flags & RECORD_FLAG_DELETED)) {
+    return -1;
+  }
+  size_t n = find.header.length < max ? find.header.length : max;
+  log->flash->read(find.offset + sizeof(struct record_header), data, n);
+  return find.header.length;
+}
+
+struct list_ctx {
+  uint8_t kind;
+  config_log_visitor_t visitor;
+  void *ctx;
+};
+
+static bool list_callback(const struct config_log *log, uint32_t offset, const struct record_header *header, void *ctx) {
+  struct list_ctx *list = ctx;
+  if (header->kind != list->kind || (header->flags & RECORD_FLAG_DELETED)) {
+    return true;
+  }
+
+  // Only report the current version of each key
+  struct find_ctx find;
+  find_latest(log, header->kind, header->name, &find);
+  if (find.offset == offset) {
+    char name[CONFIG_LOG_NAME_LEN + 1];
+    memcpy(name, header->name, CONFIG_LOG_NAME_LEN);
+    name[CONFIG_LOG_NAME_LEN] = 0;
+    list->visitor(header->kind, name, header->length, list->ctx);
+  }
+  return true;
+}
+
+void config_log_list(const struct config_log *log, uint8_t kind, config_log_visitor_t visitor, void *ctx) {
+  struct list_ctx list = {.kind = kind, .visitor = visitor, .ctx = ctx};
+  for (uint32_t i = 0; i < log->sector_count; i++) {
+    uint32_t sector = sector_in_order(log, i);
+    struct sector_header sh;
+    if (read_sector_header(log, sector, &sh)) {
+      walk_sector(log, sector, list_callback, &list);
+    }
+  }
+}
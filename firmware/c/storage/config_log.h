@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Wear-leveled key/value log
+ *
+ * Records are appended to a ring of flash sectors. Each sector starts with a
+ * small header carrying a sequence number; the sector with the highest
+ * sequence is the one being written. The sector after it is kept erased as a
+ * spare. When the active sector fills up, writing moves on to the spare and
+ * the oldest sector's still-current records are copied there; only then is
+ * the oldest sector erased, becoming the new spare. A reset mid-way is
+ * finished off by config_log_init(). A later record with the same kind and
+ * name supersedes an earlier one, so every key rotates through all sectors.
+ *
+ * The log only talks to flash through struct config_log_flash, so it can be
+ * run against a RAM-backed stub on a host.
+ */
+
+#define CONFIG_LOG_NAME_LEN 16
+#define CONFIG_LOG_MAX_RECORD 1024
+#define CONFIG_LOG_SECTOR_MAX 4096
+
+struct config_log_flash {
+  uint32_t base;         // Region start, added to every offset passed to the ops
+  uint32_t size;         // Region size in bytes, a multiple of sector_size
+  uint32_t sector_size;  // Erase unit
+  void (*read)(uint32_t offset, void *dst, size_t len);
+  // Erase one sector (all bytes read back as 0xFF)
+  bool (*erase)(uint32_t offset);
+  // Program bytes at any offset; only clears bits (NOR semantics)
+  bool (*program)(uint32_t offset, const void *src, size_t len);
+};
+
+struct config_log {
+  const struct config_log_flash *flash;
+  uint32_t sector_count;
+  uint32_t active_sector;
+  uint32_t active_seq;
+  uint32_t write_offset;  // Offset of the next record within the active sector
+};
+
+typedef void (*config_log_visitor_t)(uint8_t kind, const char *name, uint16_t length, void *ctx);
+
+/**
+ * @brief Mount the log, formatting the region if it holds no valid sector
+ * @return false if the region could not be formatted or its geometry is
+ *         unsupported (at least 3 sectors are needed)
+ */
+bool config_log_init(struct config_log *log, const struct config_log_flash *flash);
+
+/**
+ * @brief Store a record, superseding any older one with the same kind & name
+ */
+bool config_log_write(struct config_log *log, uint8_t kind, const char *name, const void *data, uint16_t len);
+
+/**
+ * @brief Mark a record as deleted
+ */
+bool config_log_delete(struct config_log *log, uint8_t kind, const char *name);
+
+/**
+ * @brief Read the current version of a record
+ * @return Length of the record, or -1 if it doesn't exist. At most @p max
+ *         bytes are copied.
+ */
+int config_log_read(const struct config_log *log, uint8_t kind, const char *name, void *data, size_t max);
+
+/**
+ * @brief Call @p visitor for every current record of the given kind
+ */
+void config_log_list(const struct config_log *log, uint8_t kind, config_log_visitor_t visitor, void *ctx);
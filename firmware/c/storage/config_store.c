@@ -0,0 +1,146 @@
+#include "config_store.h"
+
+#include <string.h>
+
+#include "flash_layout.h"
+#include "flash_rp2040.h"
+#include "hv_sense.h"
+#include "picoemp.h"
+
+#define KIND_PROFILE 1
+#define KIND_BOOT 2
+
+#define BOOT_KEY "boot"
+
+static struct config_log store;
+static bool mounted = false;
+
+static const struct config_log_flash flash_ops = {
+    .base = FLASH_CONFIG_OFFSET,
+    .size = FLASH_CONFIG_SECTORS * FLASH_SECTOR_SIZE,
+    .sector_size = FLASH_SECTOR_SIZE,
+    .read = flash_rp2040_read,
+    .erase = flash_rp2040_erase,
+    .program = flash_rp2040_program,
+};
+
+bool config_store_init() {
+  mounted = config_log_init(&store, &flash_ops);
+  return mounted;
+}
+
+static bool set_boot(const char *name) {
+  char current[CONFIG_PROFILE_NAME_LEN];
+  memset(current, 0, sizeof(current));
+  int len = config_log_read(&store, KIND_BOOT, BOOT_KEY, current, sizeof(current));
+  if (len == CONFIG_PROFILE_NAME_LEN && strncmp(current, name, CONFIG_PROFILE_NAME_LEN) == 0) {
+    return true;  // Don't wear the flash for nothing
+  }
+
+  char padded[CONFIG_PROFILE_NAME_LEN];
+  memset(padded, 0, sizeof(padded));
+  strncpy(padded, name, CONFIG_PROFILE_NAME_LEN);
+  return config_log_write(&store, KIND_BOOT, BOOT_KEY, padded, sizeof(padded));
+}
+
+bool config_store_save(const char *name, const struct config_profile *profile) {
+  if (!mounted || name[0] == 0) {
+    return false;
+  }
+  return config_log_write(&store, KIND_PROFILE, name, profile, sizeof(*profile)) && set_boot(name);
+}
+
+bool config_store_read(const char *name, struct config_profile *profile) {
+  if (!mounted) {
+    return false;
+  }
+  // Profiles from older versions are shorter: their newer fields read as 0
+  memset(profile, 0, sizeof(*profile));
+  int len = config_log_read(&store, KIND_PROFILE, name, profile, sizeof(*profile));
+  return len >= 4 && len <= (int)sizeof(*profile) && profile->size == len && profile->version <= CONFIG_PROFILE_VERSION;
+}
+
+bool config_store_load(const char *name, struct config_profile *profile) {
+  return config_store_read(name, profile) && set_boot(name);
+}
+
+bool config_store_read_boot(char name[CONFIG_PROFILE_NAME_LEN + 1], struct config_profile *profile) {
+  char boot[CONFIG_PROFILE_NAME_LEN + 1];
+  memset(boot, 0, sizeof(boot));
+  if (!mounted || config_log_read(&store, KIND_BOOT, BOOT_KEY, boot, CONFIG_PROFILE_NAME_LEN) < 0) {
+    return false;
+  }
+  if (name) {
+    memcpy(name, boot, sizeof(boot));
+  }
+  return config_store_read(boot, profile);
+}
+
+struct list_ctx {
+  char boot[CONFIG_PROFILE_NAME_LEN + 1];
+  config_store_visitor_t visitor;
+  void *ctx;
+};
+
+static void list_visitor(uint8_t kind, const char *name, uint16_t length, void *ctx) {
+  struct list_ctx *list = ctx;
+  list->visitor(name, strcmp(name, list->boot) == 0, list->ctx);
+}
+
+void config_store_list(config_store_visitor_t visitor, void *ctx) {
+  if (!mounted) {
+    return;
+  }
+  struct list_ctx list = {.visitor = visitor, .ctx = ctx};
+  memset(list.boot, 0, sizeof(list.boot));
+  config_log_read(&store, KIND_BOOT, BOOT_KEY, list.boot, CONFIG_PROFILE_NAME_LEN);
+  config_log_list(&store, KIND_PROFILE, list_visitor, &list);
+}
+
+void config_profile_capture(struct config_profile *profile, const struct glitcher_configuration *config,
+                            uint32_t pulse_time_us, uint32_t pulse_cycles, float pulse_power,
+                            uint32_t adc_sample_count) {
+  memset(profile, 0, sizeof(*profile));
+  profile->version = CONFIG_PROFILE_VERSION;
+  profile->size = sizeof(*profile);
+
+  profile->trigger_type = config->trigger_type;
+  profile->trigger_pull = config->trigger_pull_configuration;
+  profile->glitch_output = config->glitch_output;
+  profile->delay_before_pulse = config->delay_before_pulse;
+  profile->pulse_width = config->pulse_width;
+  profile->serial_pin = config->serial_pin;
+  profile->serial_baud = config->serial_baud;
+  memcpy(profile->serial_pattern, config->serial_pattern, sizeof(profile->serial_pattern));
+  profile->trigger_source = config->trigger_source;
+  profile->power_cycle_output = config->power_cycle_output;
+  profile->power_cycle_length = config->power_cycle_length;
+
+  profile->pulse_time_us = pulse_time_us;
+  profile->pulse_cycles = pulse_cycles;
+  profile->pulse_power = pulse_power;
+  profile->adc_sample_count = adc_sample_count;
+
+  uint16_t target;
+  uint8_t window_pct;
+  hv_sense_get_window(&target, &window_pct);
+  profile->hv_target = target;
+  profile->hv_window_pct = window_pct;
+
+  profile->pwm_freq_hz = picoemp_get_pwm_freq();
+}
+
+void config_profile_apply(const struct config_profile *profile, struct glitcher_configuration *config) {
+  config->trigger_type = (TriggersType)profile->trigger_type;
+  config->trigger_pull_configuration = (TriggerPullConfiguration)profile->trigger_pull;
+  config->glitch_output = (GlitchOutput_t)profile->glitch_output;
+  config->delay_before_pulse = profile->delay_before_pulse;
+  config->pulse_width = profile->pulse_width;
+  config->serial_pin = profile->serial_pin;
+  config->serial_baud = profile->serial_baud;
+  memcpy(config->serial_pattern, profile->serial_pattern, sizeof(config->serial_pattern));
+  config->serial_pattern[sizeof(config->serial_pattern) - 1] = 0;
+  config->trigger_source = (TriggerSource)profile->trigger_source;
+  config->power_cycle_output = (GlitchOutput)profile->power_cycle_output;
+  config->power_cycle_length = profile->power_cycle_length;
+}
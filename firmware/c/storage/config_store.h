@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config_log.h"
+#include "glitcher.h"
+
+#define CONFIG_PROFILE_VERSION 4
+#define CONFIG_PROFILE_NAME_LEN CONFIG_LOG_NAME_LEN
+
+/**
+ * Everything needed to restore a fault injection setup. The layout is stored
+ * as-is in flash, so only append fields and bump CONFIG_PROFILE_VERSION.
+ */
+struct config_profile {
+  uint16_t version;
+  uint16_t size;
+
+  // Glitcher
+  uint32_t trigger_type;
+  uint32_t trigger_pull;
+  uint32_t glitch_output;
+  uint32_t delay_before_pulse;
+  uint32_t pulse_width;
+  uint32_t serial_pin;
+  uint32_t serial_baud;
+  char serial_pattern[32];
+  uint32_t trigger_source;
+  uint32_t power_cycle_output;
+  uint32_t power_cycle_length;
+
+  // Manual pulse
+  uint32_t pulse_time_us;
+  float pulse_power;
+
+  uint32_t adc_sample_count;
+
+  // Version 2
+  uint32_t pulse_cycles;  // Manual pulse width in cycles, 0 = from pulse_time_us
+
+  // Version 3: HV energy window (hv_sense.h), target 0 = off
+  uint32_t hv_target;
+  uint32_t hv_window_pct;
+
+  // Version 4: charge pump PWM frequency, 0 = keep the current one
+  uint32_t pwm_freq_hz;
+};
+
+typedef void (*config_store_visitor_t)(const char *name, bool is_boot, void *ctx);
+
+/**
+ * @brief Mount the profile store, formatting it on first use
+ * @note Writes to flash: call from core 0, which owns all flash writes
+ */
+bool config_store_init();
+
+/**
+ * @brief Save a profile and make it the one loaded at boot
+ */
+bool config_store_save(const char *name, const struct config_profile *profile);
+
+/**
+ * @brief Load a profile and make it the one loaded at boot
+ * @return false if there's no valid profile with this name
+ */
+bool config_store_load(const char *name, struct config_profile *profile);
+
+/**
+ * @brief Read a profile without changing the boot selection
+ */
+bool config_store_read(const char *name, struct config_profile *profile);
+
+/**
+ * @brief Read the profile selected for boot
+ * @param name Receives the profile name, may be NULL
+ * @return false if no profile has been saved or loaded yet
+ */
+bool config_store_read_boot(char name[CONFIG_PROFILE_NAME_LEN + 1], struct config_profile *profile);
+
+/**
+ * @brief Call @p visitor for every stored profile
+ */
+void config_store_list(config_store_visitor_t visitor, void *ctx);
+
+/**
+ * @brief Fill a profile from the glitcher configuration, pulse settings and
+ *        the current HV energy window
+ */
+void config_profile_capture(struct config_profile *profile, const struct glitcher_configuration *config,
+                            uint32_t pulse_time_us, uint32_t pulse_cycles, float pulse_power,
+                            uint32_t adc_sample_count);
+
+/**
+ * @brief Copy the glitcher part of a profile into @p config
+ */
+void config_profile_apply(const struct config_profile *profile, struct glitcher_configuration *config);
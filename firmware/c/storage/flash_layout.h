@@ -0,0 +1,22 @@
+#pragma once
+
+#include "hardware/flash.h"
+
+/*
+ * Regions reserved at the end of the QSPI flash, below PICO_FLASH_SIZE_BYTES.
+ * The firmware image is linked from the start of flash and stays far below.
+ */
+
+// Each region is a config_log (storage/config_log.h), at least 3 sectors
+
+// Configuration profiles
+#define FLASH_CONFIG_SECTORS 4
+#define FLASH_CONFIG_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_CONFIG_SECTORS * FLASH_SECTOR_SIZE)
+
+// Campaign journal (see campaign/campaign.c)
+#define FLASH_CAMPAIGN_SECTORS 3
+#define FLASH_CAMPAIGN_OFFSET (FLASH_CONFIG_OFFSET - FLASH_CAMPAIGN_SECTORS * FLASH_SECTOR_SIZE)
+
+// Pinouts found by JTAG/SWD scans (see scan/pinout_cache.c)
+#define FLASH_PINOUT_SECTORS 3
+#define FLASH_PINOUT_OFFSET (FLASH_CAMPAIGN_OFFSET - FLASH_PINOUT_SECTORS * FLASH_SECTOR_SIZE)
@@ -0,0 +1,66 @@
+#include "flash_rp2040.h"
+
+#include <string.h>
+
+#include "hardware/flash.h"
+#include "pico/flash.h"
+#include "pico/mutex.h"
+#include "pico/stdlib.h"
+
+#define FLASH_SAFE_TIMEOUT_MS 100
+
+/*
+ * While flash is erased or programmed, XIP reads return garbage or stall.
+ * The image runs from RAM (copy_to_ram), so the only XIP access left is
+ * flash_rp2040_read(), from either core: it takes the same mutex as the
+ * writes and can't overlap them. flash_safe_execute() masks interrupts on the
+ * writing core; it is built with PICO_FLASH_ASSUME_CORE1_SAFE because the
+ * SDK's multicore lockout runs over the inter-core FIFO, which carries the
+ * core_link commands.
+ */
+auto_init_mutex(flash_mutex);
+
+// Page used to turn byte writes into page programs (0xFF leaves bits alone)
+static uint8_t page_buffer[FLASH_PAGE_SIZE];
+
+void flash_rp2040_read(uint32_t offset, void *dst, size_t len) {
+  mutex_enter_blocking(&flash_mutex);
+  memcpy(dst, (const void *)(XIP_BASE + offset), len);
+  mutex_exit(&flash_mutex);
+}
+
+static void erase_sector(void *param) {
+  flash_range_erase((uint32_t)(uintptr_t)param, FLASH_SECTOR_SIZE);
+}
+
+static void program_page(void *param) {
+  flash_range_program((uint32_t)(uintptr_t)param, page_buffer, FLASH_PAGE_SIZE);
+}
+
+bool flash_rp2040_erase(uint32_t offset) {
+  mutex_enter_blocking(&flash_mutex);
+  bool ok = flash_safe_execute(erase_sector, (void *)(uintptr_t)offset, FLASH_SAFE_TIMEOUT_MS) == PICO_OK;
+  mutex_exit(&flash_mutex);
+  return ok;
+}
+
+bool flash_rp2040_program(uint32_t offset, const void *src, size_t len) {
+  const uint8_t *data = src;
+  bool ok = true;
+  mutex_enter_blocking(&flash_mutex);
+  while (ok && len > 0) {
+    uint32_t page = offset & ~(FLASH_PAGE_SIZE - 1);
+    uint32_t start = offset - page;
+    uint32_t n = FLASH_PAGE_SIZE - start < len ? FLASH_PAGE_SIZE - start : len;
+
+    memset(page_buffer, 0xFF, sizeof(page_buffer));
+    memcpy(page_buffer + start, data, n);
+    ok = flash_safe_execute(program_page, (void *)(uintptr_t)page, FLASH_SAFE_TIMEOUT_MS) == PICO_OK;
+
+    offset += n;
+    data += n;
+    len -= n;
+  }
+  mutex_exit(&flash_mutex);
+  return ok;
+}
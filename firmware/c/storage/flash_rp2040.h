@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Flash access for config_log regions. Offsets are relative to the start of
+ * flash. Reads are safe from either core while the other one writes; writes
+ * must only be issued from core 0.
+ */
+
+void flash_rp2040_read(uint32_t offset, void *dst, size_t len);
+
+/**
+ * @brief Erase the sector at @p offset
+ * @return false if flash_safe_execute() failed
+ */
+bool flash_rp2040_erase(uint32_t offset);
+
+/**
+ * @brief Program bytes at any offset, padding partial pages with 0xFF
+ */
+bool flash_rp2040_program(uint32_t offset, const void *src, size_t len);
@@ -0,0 +1,139 @@
+#include "swd_mem.h"
+
+#include "pico/stdlib.h"
+
+#include "swd_pio.h"
+
+// CTRL/STAT
+#define CSYSPWRUPACK (1u << 31)
+#define CSYSPWRUPREQ (1u << 30)
+#define CDBGPWRUPACK (1u << 29)
+#define CDBGPWRUPREQ (1u << 28)
+#define ORUNDETECT (1u << 0)
+
+// ABORT: clear STKCMP, STKERR, WDERR and ORUNERR
+#define ABORT_CLEAR_ALL 0x1E
+
+// MEM-AP registers
+#define AP_CSW 0x00
+#define AP_TAR 0x04
+#define AP_DRW 0x0C
+
+#define CSW_SIZE_MASK 0x7
+#define CSW_SIZE_32 0x2
+#define CSW_ADDRINC_MASK (0x3 << 4)
+#define CSW_ADDRINC_SINGLE (0x1 << 4)
+
+#define POWER_UP_TIMEOUT_US 100000
+
+static uint8_t apsel;
+
+static bool power_up() {
+  swd_dp_write(SWD_DP_ABORT, ABORT_CLEAR_ALL);
+  if (swd_dp_write(SWD_DP_CTRL_STAT, CSYSPWRUPREQ | CDBGPWRUPREQ) != SWD_ACK_OK) {
+    return false;
+  }
+
+  absolute_time_t timeout = make_timeout_time_us(POWER_UP_TIMEOUT_US);
+  uint32_t status = 0;
+  do {
+    if (swd_dp_read(SWD_DP_CTRL_STAT, &status) == SWD_ACK_OK &&
+        (status & (CSYSPWRUPACK | CDBGPWRUPACK)) == (CSYSPWRUPACK | CDBGPWRUPACK)) {
+      break;
+    }
+    if (time_reached(timeout)) {
+      return false;
+    }
+  } while (true);
+
+  // Overrun detection lets DRW reads go out back to back
+  if (swd_dp_write(SWD_DP_CTRL_STAT, CSYSPWRUPREQ | CDBGPWRUPREQ | ORUNDETECT) != SWD_ACK_OK) {
+    return false;
+  }
+  swd_pio_set_overrun_detect(true);
+  return true;
+}
+
+bool swd_mem_begin(const struct swd_mem_target *target) {
+  if (!swd_pio_begin(target->swclk, target->swdio)) {
+    return false;
+  }
+  swd_pio_connect();
+  if (target->multidrop) {
+    swd_pio_targetsel(target->targetsel);
+  }
+
+  // A DPIDR read is required after the line reset
+  uint32_t dpidr;
+  if (swd_dp_read(SWD_DP_DPIDR, &dpidr) != SWD_ACK_OK || !power_up()) {
+    swd_pio_end();
+    return false;
+  }
+
+  apsel = target->apsel;
+  uint32_t csw;
+  if (swd_ap_read(apsel, AP_CSW, &csw) != SWD_ACK_OK) {
+    swd_mem_end();
+    return false;
+  }
+  csw = (csw & ~(CSW_SIZE_MASK | CSW_ADDRINC_MASK)) | CSW_SIZE_32 | CSW_ADDRINC_SINGLE;
+  if (swd_ap_write(apsel, AP_CSW, csw) != SWD_ACK_OK) {
+    swd_mem_end();
+    return false;
+  }
+  return true;
+}
+
+// Read up to the end of the current TAR block, returns the words read
+static uint32_t read_block(uint32_t address, uint32_t *words, uint32_t count) {
+  if (swd_ap_write(apsel, AP_TAR, address) != SWD_ACK_OK) {
+    return 0;
+  }
+
+  // Posted reads: each DRW read returns the previous one's data, the first
+  // one goes to words[0] and is overwritten by the second
+  int ack;
+  uint8_t drw_read = swd_request(true, true, AP_DRW);
+  uint32_t done = swd_pio_read_repeated(drw_read, words, 1, &ack);
+  if (done == 1 && count > 1) {
+    done += swd_pio_read_repeated(drw_read, words, count - 1, &ack);
+  }
+  if (done < count) {
+    // The last good packet carried words[done - 2]
+    return done > 1 ? done - 1 : 0;
+  }
+  if (swd_dp_read(SWD_DP_RDBUFF, &words[count - 1]) != SWD_ACK_OK) {
+    return count - 1;
+  }
+  return count;
+}
+
+uint32_t swd_mem_read(uint32_t address, uint32_t *words, uint32_t count) {
+  uint32_t total = 0;
+  int retries = SWD_MEM_RETRIES;
+
+  while (total < count) {
+    uint32_t block_left = (SWD_MEM_TAR_BLOCK - (address & (SWD_MEM_TAR_BLOCK - 1))) / 4;
+    uint32_t chunk = MIN(count - total, block_left);
+    uint32_t done = read_block(address, words + total, chunk);
+    total += done;
+    address += done * 4;
+
+    if (done < chunk) {
+      // WAIT or FAULT: clear the sticky flags and carry on from the first
+      // word that didn't make it
+      swd_dp_write(SWD_DP_ABORT, ABORT_CLEAR_ALL);
+      if (--retries < 0) {
+        break;
+      }
+    }
+  }
+  return total;
+}
+
+void swd_mem_end() {
+  swd_dp_write(SWD_DP_CTRL_STAT, CSYSPWRUPREQ | CDBGPWRUPREQ);
+  swd_pio_set_overrun_detect(false);
+  swd_pio_send(&swd_seq_line_reset);
+  swd_pio_end();
+}
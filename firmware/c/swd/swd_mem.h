@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pico/types.h"
+
+/**
+ * Target memory reads through a MEM-AP, on top of the SWD engine
+ * (swd_pio.h). Reads use TAR auto-increment and back-to-back posted DRW
+ * reads, so each word costs one SWD packet.
+ */
+
+// TAR only auto-increments within a 1 KB block (ADIv5 C2.2.2)
+#define SWD_MEM_TAR_BLOCK 1024
+
+#define SWD_MEM_RETRIES 8
+
+/**
+ * Where to find the target. @p targetsel is only used if @p multidrop is
+ * set (see bluetag_swd_target).
+ */
+struct swd_mem_target {
+  uint swclk;  // GPIOs, not scan channels
+  uint swdio;
+  uint8_t apsel;
+  bool multidrop;
+  uint32_t targetsel;
+};
+
+/**
+ * @brief Connect, power up the debug and system domains and set the MEM-AP
+ *        up for 32-bit auto-incrementing accesses
+ * @return false if the DP doesn't answer or the power up doesn't complete
+ */
+bool swd_mem_begin(const struct swd_mem_target *target);
+
+/**
+ * @brief Read @p count words starting at @p address (word aligned)
+ * @note Restarts from the first missing word after a WAIT or FAULT, up to
+ *       SWD_MEM_RETRIES times per call
+ * @return Number of words read, less than @p count if the target kept failing
+ */
+uint32_t swd_mem_read(uint32_t address, uint32_t *words, uint32_t count);
+
+/**
+ * @brief Turn overrun detection off again and release the pins
+ */
+void swd_mem_end();
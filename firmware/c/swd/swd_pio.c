@@ -0,0 +1,220 @@
+#include "swd_pio.h"
+
+#include "hardware/clocks.h"
+#include "hardware/gpio.h"
+#include "hardware/pio.h"
+
+#include "swd.pio.h"
+#include "pio_shared.h"
+
+// pio1 sm0 is the manual EMP pulse (core 0), sm1 the JTAG shifter
+#define SWD_PIO pio1
+#define SWD_SM 2
+
+static int program_offset = -1;
+static uint32_t clock_hz = SWD_PIO_CLOCK_DEFAULT_HZ;
+static uint pin_swclk;
+static uint pin_swdio;
+static bool overrun_detect = false;
+
+void swd_pio_set_clock(uint32_t hz) {
+  clock_hz = hz;
+}
+
+uint32_t swd_pio_get_clock() {
+  return clock_hz;
+}
+
+void swd_pio_set_overrun_detect(bool enabled) {
+  overrun_detect = enabled;
+}
+
+bool swd_pio_begin(uint swclk, uint swdio) {
+  if (program_offset < 0) {
+    if (!pio_can_add_program(SWD_PIO, &swd_program)) {
+      return false;
+    }
+    pio_sm_claim(SWD_PIO, SWD_SM);
+    program_offset = pio_add_program(SWD_PIO, &swd_program);
+  }
+
+  float clkdiv = (float)clock_get_hz(clk_sys) / ((float)clock_hz * SWD_CYCLES_PER_CLOCK);
+  if (clkdiv < 1.0f) {
+    clkdiv = 1.0f;
+  }
+  pin_swclk = swclk;
+  pin_swdio = swdio;
+  overrun_detect = false;
+  swd_program_init(SWD_PIO, SWD_SM, program_offset, clkdiv, swclk, swdio);
+  return true;
+}
+
+void swd_pio_end() {
+  // Done once the program stalls on the next command
+  SWD_PIO->fdebug = 1u << (PIO_FDEBUG_TXSTALL_LSB + SWD_SM);
+  while (!(SWD_PIO->fdebug & (1u << (PIO_FDEBUG_TXSTALL_LSB + SWD_SM)))) {
+    tight_loop_contents();
+  }
+  pio_shared_sm_set_enabled(SWD_PIO, SWD_SM, false);
+
+  gpio_put(pin_swclk, false);
+  gpio_set_function(pin_swclk, GPIO_FUNC_SIO);
+  gpio_set_function(pin_swdio, GPIO_FUNC_SIO);
+}
+
+static void write_bits(uint32_t bits, uint32_t value) {
+  pio_sm_put_blocking(SWD_PIO, SWD_SM, SWD_CMD_WRITE(bits));
+  pio_sm_put_blocking(SWD_PIO, SWD_SM, value);
+}
+
+static uint32_t read_bits(uint32_t bits) {
+  pio_sm_put_blocking(SWD_PIO, SWD_SM, SWD_CMD_READ(bits));
+  // Bits come in from the top
+  return pio_sm_get_blocking(SWD_PIO, SWD_SM) >> (32 - bits);
+}
+
+void swd_pio_send(const struct swd_sequence *sequence) {
+  for (uint32_t i = 0; i < sequence->count; i++) {
+    pio_sm_put_blocking(SWD_PIO, SWD_SM, sequence->words[i]);
+  }
+}
+
+void swd_pio_connect() {
+  // Needed for devices like the RP2040 whose DPs start dormant
+  swd_pio_send(&swd_seq_dormant_wakeup);
+  swd_pio_send(&swd_seq_jtag_to_swd);
+}
+
+int swd_pio_transfer(uint8_t request, uint32_t *data) {
+  bool read = request & 0x04;
+
+  write_bits(8, request);
+  // Turnaround, then the 3 ACK bits
+  int ack = read_bits(4) >> 1;
+
+  if (ack != SWD_ACK_OK) {
+    if (overrun_detect && read) {
+      // Data phase nobody drives, then the turnaround
+      read_bits(32);
+      read_bits(2);
+    } else {
+      // Turnaround back to the host
+      read_bits(1);
+      if (overrun_detect) {
+        write_bits(32, 0);
+        write_bits(1, 0);
+      }
+    }
+    return ack;
+  }
+
+  if (read) {
+    uint32_t value = read_bits(32);
+    // Parity, then the turnaround back to the host
+    bool parity = read_bits(2) & 1;
+    *data = value;
+    return parity == swd_parity(value) ? SWD_ACK_OK : SWD_ERROR_PARITY;
+  }
+
+  read_bits(1);
+  write_bits(32, *data);
+  write_bits(1, swd_parity(*data));
+  return SWD_ACK_OK;
+}
+
+static void queue_read(uint8_t request) {
+  pio_sm_put_blocking(SWD_PIO, SWD_SM, SWD_CMD_WRITE(8));
+  pio_sm_put_blocking(SWD_PIO, SWD_SM, request);
+  pio_sm_put_blocking(SWD_PIO, SWD_SM, SWD_CMD_READ(4));
+  pio_sm_put_blocking(SWD_PIO, SWD_SM, SWD_CMD_READ(32));
+  pio_sm_put_blocking(SWD_PIO, SWD_SM, SWD_CMD_READ(2));
+}
+
+static int collect_read(uint32_t *value) {
+  int ack = (pio_sm_get_blocking(SWD_PIO, SWD_SM) >> 29) & 7;
+  uint32_t data = pio_sm_get_blocking(SWD_PIO, SWD_SM);
+  bool parity = (pio_sm_get_blocking(SWD_PIO, SWD_SM) >> 30) & 1;
+  if (ack != SWD_ACK_OK) {
+    return ack;
+  }
+  *value = data;
+  return parity == swd_parity(data) ? SWD_ACK_OK : SWD_ERROR_PARITY;
+}
+
+uint32_t swd_pio_read_repeated(uint8_t request, uint32_t *values, uint32_t count, int *ack) {
+  uint32_t done = 0;
+  *ack = SWD_ACK_OK;
+  if (count == 0) {
+    return 0;
+  }
+
+  // The PIO stalls on a full RX FIFO, so queueing one packet ahead is safe
+  queue_read(request);
+  for (uint32_t i = 0; i < count; i++) {
+    if (i + 1 < count) {
+      queue_read(request);
+    }
+    int result = collect_read(&values[i]);
+    if (result != SWD_ACK_OK) {
+      *ack = result;
+      if (i + 1 < count) {
+        uint32_t dummy;
+        collect_read(&dummy);
+      }
+      break;
+    }
+    done++;
+  }
+  return done;
+}
+
+int swd_dp_read(uint8_t addr, uint32_t *value) {
+  return swd_pio_transfer(swd_request(false, true, addr), value);
+}
+
+int swd_dp_write(uint8_t addr, uint32_t value) {
+  return swd_pio_transfer(swd_request(false, false, addr), &value);
+}
+
+int swd_dp_read_bank(uint8_t bank, uint8_t addr, uint32_t *value) {
+  int ack = swd_dp_write(SWD_DP_SELECT, bank & 0xF);
+  if (ack != SWD_ACK_OK) {
+    return ack;
+  }
+  ack = swd_dp_read(addr, value);
+  swd_dp_write(SWD_DP_SELECT, 0);
+  return ack;
+}
+
+void swd_pio_targetsel(uint32_t targetsel) {
+  write_bits(8, swd_request(false, false, SWD_DP_TARGETSEL));
+  // Turnaround, ACK and turnaround: the line is left floating
+  read_bits(5);
+  write_bits(32, targetsel);
+  write_bits(1, swd_parity(targetsel));
+}
+
+static int ap_select(uint8_t apsel, uint8_t addr) {
+  return swd_dp_write(SWD_DP_SELECT, ((uint32_t)apsel << 24) | (addr & 0xF0));
+}
+
+int swd_ap_read(uint8_t apsel, uint8_t addr, uint32_t *value) {
+  int ack = ap_select(apsel, addr);
+  if (ack != SWD_ACK_OK) {
+    return ack;
+  }
+  // AP reads are posted: the data comes with the next read
+  ack = swd_pio_transfer(swd_request(true, true, addr), value);
+  if (ack != SWD_ACK_OK) {
+    return ack;
+  }
+  return swd_dp_read(SWD_DP_RDBUFF, value);
+}
+
+int swd_ap_write(uint8_t apsel, uint8_t addr, uint32_t value) {
+  int ack = ap_select(apsel, addr);
+  if (ack != SWD_ACK_OK) {
+    return ack;
+  }
+  return swd_pio_transfer(swd_request(true, false, addr), &value);
+}
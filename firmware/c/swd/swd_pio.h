@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pico/types.h"
+
+#include "swd_stream.h"
+
+/**
+ * SWD host on pio1 sm2. swd_pio_begin() hands SWCLK/SWDIO to the PIO and
+ * swd_pio_end() gives them back to the CPU, so a scan can move the engine
+ * from one pin pair to the next.
+ */
+
+#define SWD_PIO_CLOCK_DEFAULT_HZ 4000000
+
+/**
+ * @brief SWCLK frequency for the next swd_pio_begin() (rounded to the PIO clock divider)
+ */
+void swd_pio_set_clock(uint32_t hz);
+uint32_t swd_pio_get_clock();
+
+/**
+ * @brief Tell the engine that CTRL/STAT.ORUNDETECT is set
+ * @details Packets that get WAIT or FAULT then still have a data phase.
+ */
+void swd_pio_set_overrun_detect(bool enabled);
+
+/**
+ * @brief Take over @p swclk and @p swdio
+ * @return false if the program doesn't fit into pio1
+ */
+bool swd_pio_begin(uint swclk, uint swdio);
+
+/**
+ * @brief Wait for the last bits to go out and release the pins
+ */
+void swd_pio_end();
+
+/**
+ * @brief Clock out a pre-built sequence
+ */
+void swd_pio_send(const struct swd_sequence *sequence);
+
+/**
+ * @brief Wake up (dormant or JTAG) and reset the line into SWD
+ */
+void swd_pio_connect();
+
+/**
+ * @brief One SWD packet
+ * @param request See swd_request()
+ * @param data Written for writes, filled in for reads
+ * @return The ACK (SWD_ACK_*) or SWD_ERROR_PARITY
+ */
+int swd_pio_transfer(uint8_t request, uint32_t *data);
+
+/**
+ * @brief The same read packet @p count times, back to back
+ * @details The next packet is queued before the previous one is collected, so
+ *          SWCLK never stops between packets. Needs CTRL/STAT.ORUNDETECT: a
+ *          packet that gets WAIT or FAULT still has its data phase then.
+ * @param ack The ACK of the packet that stopped the run, SWD_ACK_OK if none
+ * @return Number of packets that got ACK OK with good parity
+ */
+uint32_t swd_pio_read_repeated(uint8_t request, uint32_t *values, uint32_t count, int *ack);
+
+int swd_dp_read(uint8_t addr, uint32_t *value);
+int swd_dp_write(uint8_t addr, uint32_t value);
+
+/**
+ * @brief Read a banked DP register (DPv2), then select bank 0 again
+ */
+int swd_dp_read_bank(uint8_t bank, uint8_t addr, uint32_t *value);
+
+/**
+ * @brief Select one DP on a multi-drop bus, must follow a line reset
+ * @note Nobody drives the ACK of a TARGETSEL write, so there's nothing to
+ *       check: read DPIDR next to see if a DP answered
+ */
+void swd_pio_targetsel(uint32_t targetsel);
+
+/**
+ * @brief Read an AP register (selects the AP and bank, then reads through RDBUFF)
+ */
+int swd_ap_read(uint8_t apsel, uint8_t addr, uint32_t *value);
+int swd_ap_write(uint8_t apsel, uint8_t addr, uint32_t value);
@@ -0,0 +1,52 @@
+#include "swd_stream.h"
+
+#define JTAG_TO_SWD_CMD 0xE79E
+#define SWD_TO_JTAG_CMD 0xE73C
+#define SWDP_ACTIVATION_CODE 0x1A
+
+#define LINE_RESET_WORDS                            \
+  SWD_CMD_WRITE(32), 0xFFFFFFFF,                    \
+  SWD_CMD_WRITE(32), 0xFFFFFFFF
+
+#define IDLE_WORDS SWD_CMD_WRITE(4), 0
+
+#define SEQUENCE(name, ...)                                     \
+  static const uint32_t name##_words[] = {__VA_ARGS__};         \
+  const struct swd_sequence name = {name##_words, sizeof(name##_words) / sizeof(uint32_t)}
+
+SEQUENCE(swd_seq_line_reset, LINE_RESET_WORDS, IDLE_WORDS);
+
+SEQUENCE(swd_seq_dormant_wakeup,
+         SWD_CMD_WRITE(8), 0xFF,
+         // Selection alert 0x19BC0EA2 E3DDAFE9 86852D95 6209F392, LSB first
+         SWD_CMD_WRITE(32), 0x6209F392,
+         SWD_CMD_WRITE(32), 0x86852D95,
+         SWD_CMD_WRITE(32), 0xE3DDAFE9,
+         SWD_CMD_WRITE(32), 0x19BC0EA2,
+         IDLE_WORDS,
+         SWD_CMD_WRITE(8), SWDP_ACTIVATION_CODE);
+
+SEQUENCE(swd_seq_jtag_to_swd,
+         LINE_RESET_WORDS,
+         SWD_CMD_WRITE(16), JTAG_TO_SWD_CMD,
+         LINE_RESET_WORDS,
+         IDLE_WORDS);
+
+SEQUENCE(swd_seq_swd_to_jtag,
+         LINE_RESET_WORDS,
+         SWD_CMD_WRITE(16), SWD_TO_JTAG_CMD);
+
+bool swd_parity(uint32_t value) {
+  value ^= value >> 16;
+  value ^= value >> 8;
+  value ^= value >> 4;
+  value ^= value >> 2;
+  value ^= value >> 1;
+  return value & 1;
+}
+
+uint8_t swd_request(bool ap, bool read, uint8_t addr) {
+  uint8_t bits = (ap ? 1 : 0) | (read ? 2 : 0) | (addr & 0xC);
+  // Start, APnDP, RnW, A[2:3], parity, stop (0), park (1)
+  return 0x81 | (bits << 1) | (swd_parity(bits) << 5);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * SWD command words for the PIO engine (swd.pio) and the fixed sequences
+ * needed to get a target talking, pre-built so they go out in one burst.
+ */
+
+#define SWD_CMD_WRITE(bits) ((((uint32_t)(bits) - 1) << 1) | 1)
+#define SWD_CMD_READ(bits) (((uint32_t)(bits) - 1) << 1)
+
+// ACK values
+#define SWD_ACK_OK 1
+#define SWD_ACK_WAIT 2
+#define SWD_ACK_FAULT 4
+#define SWD_ACK_NONE 7       // Nobody drove the line (pulled high)
+#define SWD_ERROR_PARITY 8   // ACK was OK but the read data had a bad parity bit
+
+// DP registers (A[3:2] << 2)
+#define SWD_DP_DPIDR 0x0     // Read
+#define SWD_DP_ABORT 0x0     // Write
+#define SWD_DP_CTRL_STAT 0x4
+#define SWD_DP_SELECT 0x8    // Write
+#define SWD_DP_RDBUFF 0xC    // Read
+#define SWD_DP_TARGETSEL 0xC // Write, DPv2
+
+// Banked DP registers (DPv2, SELECT.DPBANKSEL)
+#define SWD_DP_TARGETID 0x4  // Bank 2
+#define SWD_DP_DLPIDR 0x4    // Bank 3
+#define SWD_DP_BANK_TARGETID 2
+#define SWD_DP_BANK_DLPIDR 3
+
+// DPIDR.VERSION, TARGETSEL needs 2 or later
+#define SWD_DPIDR_VERSION(dpidr) (((dpidr) >> 12) & 0xF)
+// DLPIDR.TINSTANCE, also the top nibble of a TARGETSEL value
+#define SWD_TINSTANCE(value) ((value) >> 28)
+
+struct swd_sequence {
+  const uint32_t *words;
+  uint32_t count;
+};
+
+// Line reset: 64 clocks with SWDIO high, then 4 idle clocks
+extern const struct swd_sequence swd_seq_line_reset;
+
+// Dormant wakeup: 8 ones, the 128-bit selection alert, 4 idle clocks and the
+// SWD activation code (ADIv5.2 B5.3.4)
+extern const struct swd_sequence swd_seq_dormant_wakeup;
+
+// Line reset, JTAG-to-SWD select sequence, line reset, idle
+extern const struct swd_sequence swd_seq_jtag_to_swd;
+
+// Line reset, then the SWD-to-JTAG select sequence
+extern const struct swd_sequence swd_seq_swd_to_jtag;
+
+/**
+ * @brief Packet request byte for a DP or AP access
+ * @param addr Register address, only A[3:2] are used
+ */
+uint8_t swd_request(bool ap, bool read, uint8_t addr);
+
+/**
+ * @brief Even parity of @p value
+ */
+bool swd_parity(uint32_t value);
@@ -0,0 +1,4 @@
+#pragma once
+
+// config_store.h only passes the glitcher configuration by pointer
+struct glitcher_configuration;
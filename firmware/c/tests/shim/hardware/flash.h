@@ -0,0 +1,4 @@
+#pragma once
+
+#define FLASH_SECTOR_SIZE 4096
+#define PICO_FLASH_SIZE_BYTES (2 * 1024 * 1024)
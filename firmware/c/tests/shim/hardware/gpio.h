@@ -0,0 +1,8 @@
+#pragma once
+
+#include "pico/types.h"
+
+#define GPIO_IN false
+#define GPIO_OUT true
+
+void gpio_set_dir(uint gpio, bool out);
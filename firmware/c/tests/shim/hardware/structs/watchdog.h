@@ -0,0 +1,10 @@
+#pragma once
+
+#include "pico/types.h"
+
+// The scratch registers, kept by the test across simulated resets
+typedef struct {
+  uint32_t scratch[8];
+} watchdog_hw_t;
+
+extern watchdog_hw_t *watchdog_hw;
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "pico/types.h"
+
+// Single-threaded tests: the locks only have to exist
+typedef volatile uint32_t spin_lock_t;
+
+static inline uint spin_lock_claim_unused(bool required) {
+  return 0;
+}
+
+static inline spin_lock_t *spin_lock_init(uint lock_num) {
+  static spin_lock_t locks[32];
+  return &locks[lock_num];
+}
+
+static inline uint32_t spin_lock_blocking(spin_lock_t *lock) {
+  return 0;
+}
+
+static inline void spin_unlock(spin_lock_t *lock, uint32_t saved_irq) {}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "pico/types.h"
+
+void stdio_put_string(const char *s, int len, bool newline, bool cr_translation);
+void stdio_flush();
+uint32_t time_us_32();
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "pico/types.h"
+
+uint64_t time_us_64();
@@ -0,0 +1,12 @@
+#pragma once
+
+// Just enough of the Pico SDK for the host tests
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+
+#ifndef MIN
+#define MIN(a, b) ((b) < (a) ? (b) : (a))
+#endif
@@ -0,0 +1,152 @@
+#include "tap_model.h"
+
+#include <string.h>
+
+enum {
+  TEST_LOGIC_RESET,
+  RUN_TEST_IDLE,
+  SELECT_DR,
+  CAPTURE_DR,
+  SHIFT_DR,
+  EXIT1_DR,
+  PAUSE_DR,
+  EXIT2_DR,
+  UPDATE_DR,
+  SELECT_IR,
+  CAPTURE_IR,
+  SHIFT_IR,
+  EXIT1_IR,
+  PAUSE_IR,
+  EXIT2_IR,
+  UPDATE_IR,
+};
+
+// Next state for TMS low, TMS high
+static const uint8_t next_state[16][2] = {
+    [TEST_LOGIC_RESET] = {RUN_TEST_IDLE, TEST_LOGIC_RESET},
+    [RUN_TEST_IDLE] = {RUN_TEST_IDLE, SELECT_DR},
+    [SELECT_DR] = {CAPTURE_DR, SELECT_IR},
+    [CAPTURE_DR] = {SHIFT_DR, EXIT1_DR},
+    [SHIFT_DR] = {SHIFT_DR, EXIT1_DR},
+    [EXIT1_DR] = {PAUSE_DR, UPDATE_DR},
+    [PAUSE_DR] = {PAUSE_DR, EXIT2_DR},
+    [EXIT2_DR] = {SHIFT_DR, UPDATE_DR},
+    [UPDATE_DR] = {RUN_TEST_IDLE, SELECT_DR},
+    [SELECT_IR] = {CAPTURE_IR, TEST_LOGIC_RESET},
+    [CAPTURE_IR] = {SHIFT_IR, EXIT1_IR},
+    [SHIFT_IR] = {SHIFT_IR, EXIT1_IR},
+    [EXIT1_IR] = {PAUSE_IR, UPDATE_IR},
+    [PAUSE_IR] = {PAUSE_IR, EXIT2_IR},
+    [EXIT2_IR] = {SHIFT_IR, UPDATE_IR},
+    [UPDATE_IR] = {RUN_TEST_IDLE, SELECT_DR},
+};
+
+// What Test-Logic-Reset selects in place of an instruction
+#define INSTRUCTION_IDCODE 0xFFFFFFFE
+
+struct tap {
+  struct tap_model_tap config;
+  uint32_t instruction;
+  uint64_t ir;  // Shift register
+  uint64_t dr;
+  uint32_t dr_length;
+  uint32_t samples;
+};
+
+static struct tap chain[TAP_MODEL_MAX_TAPS];
+static uint32_t tap_count;
+static int state;
+static uint64_t pins;
+
+static void capture_dr(struct tap *tap) {
+  uint32_t bsr_length = tap->config.bsr_length;
+  if (tap->instruction == INSTRUCTION_IDCODE && tap->config.idcode != 0) {
+    tap->dr = tap->config.idcode;
+    tap->dr_length = 32;
+  } else if (tap->config.sample != 0 && tap->instruction == tap->config.sample) {
+    tap->dr = bsr_length == 64 ? pins : pins & ((1ull << bsr_length) - 1);
+    tap->dr_length = bsr_length;
+    tap->samples++;
+  } else {
+    // BYPASS, and anything else the model doesn't implement
+    tap->dr = 0;
+    tap->dr_length = 1;
+  }
+}
+
+static void reset() {
+  for (uint32_t i = 0; i < tap_count; i++) {
+    chain[i].instruction = INSTRUCTION_IDCODE;
+  }
+}
+
+void tap_model_init(const struct tap_model_tap *taps, uint32_t count) {
+  memset(chain, 0, sizeof(chain));
+  tap_count = count;
+  for (uint32_t i = 0; i < count; i++) {
+    chain[i].config = taps[i];
+  }
+  state = TEST_LOGIC_RESET;
+  pins = 0;
+  reset();
+}
+
+// One TCK cycle: TDO is driven from the falling edge before, TMS/TDI are
+// sampled on the rising edge
+static bool clock(bool tms, bool tdi) {
+  bool tdo = true;  // Pulled up while not shifting
+  if (state == SHIFT_DR || state == SHIFT_IR) {
+    tdo = (state == SHIFT_DR ? chain[0].dr : chain[0].ir) & 1;
+    bool in = tdi;
+    for (int32_t i = tap_count - 1; i >= 0; i--) {
+      struct tap *tap = &chain[i];
+      uint64_t *reg = state == SHIFT_DR ? &tap->dr : &tap->ir;
+      uint32_t length = state == SHIFT_DR ? tap->dr_length : tap->config.ir_length;
+      bool out = *reg & 1;
+      *reg = (*reg >> 1) | ((uint64_t)in << (length - 1));
+      in = out;
+    }
+  }
+
+  state = next_state[state][tms];
+  for (uint32_t i = 0; i < tap_count; i++) {
+    struct tap *tap = &chain[i];
+    if (state == CAPTURE_DR) {
+      capture_dr(tap);
+    } else if (state == CAPTURE_IR) {
+      tap->ir = tap->config.ir_capture ? tap->config.ir_capture : 0b01;
+    } else if (state == UPDATE_IR) {
+      tap->instruction = tap->ir;
+    }
+  }
+  if (state == TEST_LOGIC_RESET) {
+    reset();
+  }
+  return tdo;
+}
+
+void tap_model_run(const struct jtag_stream *stream, uint32_t *tdo) {
+  memset(tdo, 0, JTAG_TDO_WORDS(stream->clocks) * sizeof(uint32_t));
+  for (uint32_t c = 0; c < stream->clocks; c++) {
+    uint32_t bits = stream->words[c / JTAG_STREAM_CLOCKS_PER_WORD] >> ((c % JTAG_STREAM_CLOCKS_PER_WORD) * 2);
+    if (clock((bits >> 1) & 1, bits & 1)) {
+      tdo[c / JTAG_TDO_CLOCKS_PER_WORD] |= 1u << (c % JTAG_TDO_CLOCKS_PER_WORD);
+    }
+  }
+}
+
+void tap_model_set_pins(uint64_t value) {
+  pins = value;
+}
+
+bool tap_model_in_idle() {
+  return state == RUN_TEST_IDLE;
+}
+
+uint32_t tap_model_instruction(uint32_t tap) {
+  return chain[tap].instruction;
+}
+
+uint32_t tap_model_samples(uint32_t tap) {
+  return chain[tap].samples;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "jtag_stream.h"
+
+/**
+ * IEEE 1149.1 TAP chain model for the host tests. It stands in for the PIO
+ * engine: tap_model_run() clocks a finished jtag_stream through the chain and
+ * returns TDO in the engine's layout.
+ *
+ * TAP 0 is nearest TDO. Each TAP has an IR (capture value ending in 01), BYPASS
+ * (IR all ones), IDCODE selected by Test-Logic-Reset (or BYPASS for TAPs
+ * without one) and optionally a boundary-scan register.
+ */
+
+#define TAP_MODEL_MAX_TAPS 8
+
+struct tap_model_tap {
+  uint8_t ir_length;
+  uint32_t ir_capture;    // Loaded on Capture-IR, 0 = binary 01
+  uint32_t idcode;        // 0 = no IDCODE register, reset selects BYPASS
+  uint32_t sample;        // SAMPLE/PRELOAD opcode, 0 = no boundary scan
+  uint32_t bsr_length;    // At most 64
+};
+
+/**
+ * @brief Set up a chain, all TAPs in Test-Logic-Reset
+ */
+void tap_model_init(const struct tap_model_tap *taps, uint32_t count);
+
+/**
+ * @brief Clock a stream through the chain
+ * @param tdo Receives JTAG_TDO_WORDS(stream->clocks) words
+ */
+void tap_model_run(const struct jtag_stream *stream, uint32_t *tdo);
+
+/**
+ * @brief Set the pins the next Capture-DR of a SAMPLE/PRELOAD TAP sees
+ */
+void tap_model_set_pins(uint64_t pins);
+
+bool tap_model_in_idle();
+
+/**
+ * @brief Instruction a TAP is executing (after the last Update-IR or reset)
+ */
+uint32_t tap_model_instruction(uint32_t tap);
+
+/**
+ * @brief Captures done by a TAP in SAMPLE/PRELOAD
+ */
+uint32_t tap_model_samples(uint32_t tap);
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/**
+ * Minimal checks for the host tests: a failed check is reported and counted,
+ * and test_exit() turns the count into the exit status ctest reads.
+ */
+
+static int test_failures;
+
+static inline void check_at(bool ok, const char *expr, const char *file, int line) {
+  if (!ok) {
+    fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, expr);
+    test_failures++;
+  }
+}
+
+static inline void check_eq_at(long long a, long long b, const char *expr_a, const char *expr_b, const char *file,
+                               int line) {
+  if (a != b) {
+    fprintf(stderr, "%s:%d: %s == %s failed: %lld != %lld\n", file, line, expr_a, expr_b, a, b);
+    test_failures++;
+  }
+}
+
+#define CHECK(cond) check_at((cond), #cond, __FILE__, __LINE__)
+#define CHECK_EQ(a, b) check_eq_at((long long)(a), (long long)(b), #a, #b, __FILE__, __LINE__)
+
+static inline int test_exit() {
+  if (test_failures) {
+    fprintf(stderr, "%d check(s) failed\n", test_failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
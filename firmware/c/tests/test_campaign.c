@@ -0,0 +1,223 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "campaign.h"
+#include "flash_layout.h"
+#include "flash_rp2040.h"
+#include "hardware/structs/watchdog.h"
+#include "test.h"
+
+/*
+ * campaign.c on a RAM copy of its flash region and fake watchdog scratch
+ * registers. A "reset" is campaign_init() again: the scratch registers
+ * survive it, a power loss also clears them.
+ */
+
+#define REGION_SIZE (FLASH_CAMPAIGN_SECTORS * FLASH_SECTOR_SIZE)
+
+static uint8_t flash[REGION_SIZE];
+static watchdog_hw_t watchdog;
+watchdog_hw_t *watchdog_hw = &watchdog;
+
+static uint8_t *region(uint32_t offset, size_t len) {
+  CHECK(offset >= FLASH_CAMPAIGN_OFFSET && offset + len <= FLASH_CAMPAIGN_OFFSET + REGION_SIZE);
+  return flash + (offset - FLASH_CAMPAIGN_OFFSET);
+}
+
+void flash_rp2040_read(uint32_t offset, void *dst, size_t len) {
+  memcpy(dst, region(offset, len), len);
+}
+
+bool flash_rp2040_erase(uint32_t offset) {
+  memset(region(offset, FLASH_SECTOR_SIZE), 0xFF, FLASH_SECTOR_SIZE);
+  return true;
+}
+
+bool flash_rp2040_program(uint32_t offset, const void *src, size_t len) {
+  uint8_t *dst = region(offset, len);
+  for (size_t i = 0; i < len; i++) {
+    dst[i] &= ((const uint8_t *)src)[i];
+  }
+  return true;
+}
+
+static struct config_profile profile(uint32_t tag) {
+  struct config_profile setup;
+  memset(&setup, 0, sizeof(setup));
+  setup.version = CONFIG_PROFILE_VERSION;
+  setup.size = sizeof(setup);
+  setup.pulse_width = tag;
+  return setup;
+}
+
+static void power_on() {
+  memset(flash, 0xFF, sizeof(flash));
+  memset(&watchdog, 0, sizeof(watchdog));
+}
+
+static bool reset(struct config_profile *resumed) {
+  return campaign_init(resumed);
+}
+
+static struct campaign_params grid(uint32_t delays, uint32_t widths, uint32_t repeats) {
+  return (struct campaign_params){
+      .delay_min = 100,
+      .delay_max = 100 + (delays - 1) * 2,
+      .delay_step = 2,
+      .width_min = 10,
+      .width_max = 10 + (widths - 1),
+      .width_step = 1,
+      .repeats = repeats,
+      .seed = 0x12345,
+  };
+}
+
+static void test_grid_size() {
+  struct config_profile setup = profile(1);
+  struct config_profile resumed;
+  power_on();
+  reset(&resumed);
+
+  // 65536 x 65536 points wraps to 0 in 32 bits
+  struct campaign_params params = {
+      .delay_min = 0, .delay_max = 0xFFFF, .delay_step = 1, .width_min = 0, .width_max = 0xFFFF, .width_step = 1,
+      .repeats = 1};
+  CHECK(!campaign_start(&params, &setup));
+  // The points fit, the attempts don't
+  params.width_max = 0xFFFE;
+  params.repeats = 2;
+  CHECK(!campaign_start(&params, &setup));
+  params.repeats = 1;
+  CHECK(campaign_start(&params, &setup));
+  struct campaign_status status;
+  campaign_get_status(&status);
+  CHECK_EQ(status.total, 0xFFFFull * 0x10000);
+
+  // Empty grids
+  params = grid(3, 3, 0);
+  CHECK(!campaign_start(&params, &setup));
+  params = grid(3, 3, 1);
+  params.delay_step = 0;
+  CHECK(!campaign_start(&params, &setup));
+  campaign_stop();
+}
+
+// Every point is visited repeats times, and a reset doesn't change the walk
+static void test_walk() {
+  struct config_profile setup = profile(7);
+  struct config_profile resumed;
+  struct campaign_params params = grid(5, 7, 2);
+  uint8_t visits[5][7] = {0};
+  power_on();
+  reset(&resumed);
+  CHECK(campaign_start(&params, &setup));
+
+  struct campaign_attempt attempt;
+  uint32_t count = 0;
+  while (campaign_next(&attempt)) {
+    CHECK_EQ(attempt.index, count);
+    uint32_t d = (attempt.delay - params.delay_min) / params.delay_step;
+    uint32_t w = (attempt.width - params.width_min) / params.width_step;
+    CHECK(d < 5 && w < 7);
+    visits[d][w]++;
+    campaign_record(count % 3 == 0, 0);
+    count++;
+    if (count == 40) {
+      memset(&resumed, 0, sizeof(resumed));
+      CHECK(reset(&resumed));
+      CHECK_EQ(resumed.pulse_width, 7);
+    }
+  }
+  CHECK_EQ(count, 5 * 7 * 2);
+  for (int d = 0; d < 5; d++) {
+    for (int w = 0; w < 7; w++) {
+      CHECK_EQ(visits[d][w], 2);
+    }
+  }
+  struct campaign_status status;
+  campaign_get_status(&status);
+  CHECK(!status.active);
+  CHECK_EQ(status.completed, 70);
+  CHECK_EQ(status.triggered, 24);
+  CHECK_EQ(status.timeouts, 46);
+  CHECK_EQ(status.resumes, 1);
+  CHECK(!reset(&resumed));
+}
+
+// An attempt the board resets during is not tried again, whether the scratch
+// registers survive the reset or not
+static void test_reset_in_flight() {
+  struct config_profile setup = profile(3);
+  struct config_profile resumed;
+  struct campaign_params params = grid(4, 4, 1);
+  struct campaign_attempt attempt;
+  power_on();
+  reset(&resumed);
+  CHECK(campaign_start(&params, &setup));
+  for (int i = 0; i < 3; i++) {
+    CHECK(campaign_next(&attempt));
+    campaign_fire();
+    campaign_record(true, 0);
+  }
+
+  // Watchdog reset while attempt 3 fires
+  CHECK(campaign_next(&attempt));
+  CHECK_EQ(attempt.index, 3);
+  campaign_fire();
+  CHECK(reset(&resumed));
+  struct campaign_status status;
+  campaign_get_status(&status);
+  CHECK_EQ(status.completed, 4);
+  CHECK_EQ(status.resets, 1);
+  CHECK(campaign_next(&attempt));
+  CHECK_EQ(attempt.index, 4);
+
+  // Power loss after two more attempts: back to the journal at 4
+  campaign_fire();
+  campaign_record(false, 0);
+  CHECK(campaign_next(&attempt));
+  campaign_fire();
+  campaign_record(false, 0);
+  memset(&watchdog, 0, sizeof(watchdog));
+  CHECK(reset(&resumed));
+  campaign_get_status(&status);
+  CHECK_EQ(status.completed, 4);
+  CHECK_EQ(status.resets, 1);
+
+  // Power loss while attempt 4 fires again: the journal has it in flight
+  CHECK(campaign_next(&attempt));
+  CHECK_EQ(attempt.index, 4);
+  campaign_fire();
+  memset(&watchdog, 0, sizeof(watchdog));
+  CHECK(reset(&resumed));
+  campaign_get_status(&status);
+  CHECK_EQ(status.completed, 5);
+  CHECK_EQ(status.resets, 2);
+
+  // A recorded attempt clears it in the journal too
+  CHECK(campaign_next(&attempt));
+  campaign_fire();
+  campaign_record(true, 0);
+  memset(&watchdog, 0, sizeof(watchdog));
+  CHECK(reset(&resumed));
+  campaign_get_status(&status);
+  CHECK_EQ(status.completed, 6);
+  CHECK_EQ(status.resets, 2);
+
+  while (campaign_next(&attempt)) {
+    campaign_fire();
+    campaign_record(false, 0);
+  }
+  campaign_get_status(&status);
+  CHECK(!status.active);
+  CHECK_EQ(status.completed, 16);
+  CHECK_EQ(status.triggered + status.timeouts + status.resets, 16);
+  CHECK(!reset(&resumed));
+}
+
+int main() {
+  test_grid_size();
+  test_walk();
+  test_reset_in_flight();
+  return test_exit();
+}
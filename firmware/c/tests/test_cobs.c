@@ -0,0 +1,147 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cobs.h"
+#include "test.h"
+
+static void check_encode(const uint8_t *src, size_t len, const uint8_t *expected, size_t expected_len) {
+  uint8_t out[COBS_ENCODED_MAX(600)];
+  CHECK_EQ(cobs_encode(src, len, out, sizeof(out)), expected_len);
+  CHECK(memcmp(out, expected, expected_len) == 0);
+}
+
+// The examples from the COBS paper / Wikipedia
+static void test_vectors() {
+  check_encode((const uint8_t[]){0x00}, 1, (const uint8_t[]){0x01, 0x01}, 2);
+  check_encode((const uint8_t[]){0x00, 0x00}, 2, (const uint8_t[]){0x01, 0x01, 0x01}, 3);
+  check_encode((const uint8_t[]){0x11, 0x22, 0x00, 0x33}, 4, (const uint8_t[]){0x03, 0x11, 0x22, 0x02, 0x33}, 5);
+  check_encode((const uint8_t[]){0x11, 0x22, 0x33, 0x44}, 4, (const uint8_t[]){0x05, 0x11, 0x22, 0x33, 0x44}, 5);
+  check_encode((const uint8_t[]){0x11, 0x00, 0x00, 0x00}, 4, (const uint8_t[]){0x02, 0x11, 0x01, 0x01, 0x01}, 5);
+  check_encode(NULL, 0, (const uint8_t[]){0x01}, 1);
+
+  // 254 non-zero bytes fill a block, with no implicit zero after it
+  uint8_t src[255];
+  uint8_t expected[257];
+  for (int i = 0; i < 254; i++) {
+    src[i] = i + 1;
+    expected[i + 1] = i + 1;
+  }
+  expected[0] = 0xFF;
+  expected[255] = 0x01;
+  check_encode(src, 254, expected, 256);
+
+  src[254] = 0xFF;
+  expected[255] = 0x02;
+  expected[256] = 0xFF;
+  check_encode(src, 255, expected, 257);
+}
+
+static void test_round_trip() {
+  uint8_t src[600];
+  uint8_t encoded[COBS_ENCODED_MAX(sizeof(src))];
+  uint8_t decoded[sizeof(src)];
+  srand(1);
+  for (int round = 0; round < 2000; round++) {
+    size_t len = rand() % sizeof(src);
+    int zeros = rand() % 4;  // Dense, sparse or no zeros at all
+    for (size_t i = 0; i < len; i++) {
+      src[i] = (zeros && rand() % (zeros * 8) == 0) ? 0 : 1 + rand() % 255;
+    }
+    size_t n = cobs_encode(src, len, encoded, sizeof(encoded));
+    CHECK(n > 0 && n <= COBS_ENCODED_MAX(len));
+    CHECK(memchr(encoded, 0, n) == NULL);
+    CHECK_EQ(cobs_decode(encoded, n, decoded, sizeof(decoded)), len);
+    CHECK(memcmp(src, decoded, len) == 0);
+
+    // In place, as protocol_receive_frame() may do
+    CHECK_EQ(cobs_decode(encoded, n, encoded, sizeof(encoded)), len);
+    CHECK(memcmp(src, encoded, len) == 0);
+  }
+}
+
+static void test_bounds() {
+  uint8_t src[10] = {1, 2, 3};
+  uint8_t out[16];
+  CHECK_EQ(cobs_encode(src, 10, out, COBS_ENCODED_MAX(10) - 1), 0);
+
+  // Code byte pointing past the end, a zero code byte, no room for the output
+  CHECK_EQ(cobs_decode((const uint8_t[]){0x05, 0x11, 0x22}, 3, out, sizeof(out)), 0);
+  CHECK_EQ(cobs_decode((const uint8_t[]){0x02, 0x11, 0x00, 0x22}, 4, out, sizeof(out)), 0);
+  CHECK_EQ(cobs_decode((const uint8_t[]){0x03, 0x11, 0x22, 0x02, 0x33}, 5, out, 3), 0);
+  CHECK_EQ(cobs_decode((const uint8_t[]){0x03, 0x11, 0x22, 0x02, 0x33}, 5, out, 4), 4);
+}
+
+static void test_crc() {
+  // CRC-16/CCITT-FALSE check value
+  CHECK_EQ(crc16_ccitt((const uint8_t *)"123456789", 9), 0x29B1);
+  CHECK_EQ(crc16_ccitt(NULL, 0), 0xFFFF);
+}
+
+static void test_frames() {
+  uint8_t payload[640 + 2];
+  uint8_t frame[COBS_FRAME_MAX(640)];
+  uint8_t decoded[640 + 2];
+  size_t len;
+
+  for (size_t n = 0; n <= 640; n += 37) {
+    for (size_t i = 0; i < n; i++) {
+      payload[i] = i % 5 == 0 ? 0 : i;
+    }
+    size_t framed = cobs_frame_encode(payload, n, frame, sizeof(frame));
+    CHECK(framed > 2 && framed <= COBS_FRAME_MAX(n));
+    CHECK_EQ(frame[0], 0);
+    CHECK_EQ(frame[framed - 1], 0);
+    CHECK(memchr(frame + 1, 0, framed - 2) == NULL);
+
+    CHECK(cobs_frame_decode(frame + 1, framed - 2, decoded, sizeof(decoded), &len));
+    CHECK_EQ(len, n);
+    CHECK(memcmp(payload, decoded, n) == 0);
+  }
+
+  // An empty payload is still a frame: an all-defaults message
+  CHECK_EQ(cobs_frame_encode(payload, 0, frame, sizeof(frame)), COBS_FRAME_MAX(0));
+  CHECK(cobs_frame_decode(frame + 1, COBS_FRAME_MAX(0) - 2, decoded, sizeof(decoded), &len));
+  CHECK_EQ(len, 0);
+
+  CHECK_EQ(cobs_frame_encode(payload, 100, frame, COBS_FRAME_MAX(100) - 1), 0);
+}
+
+static void test_frame_errors() {
+  uint8_t payload[64 + 2];
+  uint8_t frame[COBS_FRAME_MAX(64)];
+  uint8_t decoded[64 + 2];
+  size_t len;
+  for (int i = 0; i < 64; i++) {
+    payload[i] = i * 7;
+  }
+  size_t framed = cobs_frame_encode(payload, 64, frame, sizeof(frame));
+
+  // Any single flipped bit is caught, by the CRC or by COBS itself
+  for (size_t byte = 1; byte < framed - 1; byte++) {
+    for (int bit = 0; bit < 8; bit++) {
+      frame[byte] ^= 1 << bit;
+      if (frame[byte] != 0) {
+        CHECK(!cobs_frame_decode(frame + 1, framed - 2, decoded, sizeof(decoded), &len));
+      }
+      frame[byte] ^= 1 << bit;
+    }
+  }
+
+  // Console text between frames, a truncated frame, one too large to hold
+  const char *text = "Device armed!\r\n";
+  CHECK(!cobs_frame_decode((const uint8_t *)text, strlen(text), decoded, sizeof(decoded), &len));
+  CHECK(!cobs_frame_decode(frame + 1, framed - 4, decoded, sizeof(decoded), &len));
+  CHECK(!cobs_frame_decode(frame + 1, framed - 2, decoded, 65, &len));
+  CHECK(!cobs_frame_decode((const uint8_t[]){0x02, 0x11}, 2, decoded, sizeof(decoded), &len));
+}
+
+int main() {
+  test_vectors();
+  test_round_trip();
+  test_bounds();
+  test_crc();
+  test_frames();
+  test_frame_errors();
+  return test_exit();
+}
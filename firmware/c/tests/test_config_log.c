@@ -0,0 +1,254 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "config_log.h"
+#include "test.h"
+
+/*
+ * RAM-backed flash that loses power after a set number of erase/program
+ * operations: the operation it dies in is only partly done, and nothing
+ * after it reaches the flash until the next "boot".
+ */
+
+#define SECTOR_SIZE 1024
+#define MAX_SECTORS 4
+#define KEYS 4
+#define STEPS 120
+
+static uint8_t flash[MAX_SECTORS * SECTOR_SIZE];
+static long budget;  // Operations left before the power fails, -1 = never
+static bool dead;
+static long operations;
+static uint32_t erase_cut = SECTOR_SIZE / 2;  // An erase cut short only reaches the end of the sector
+
+enum power { POWER_ON, POWER_FAILING, POWER_OFF };
+
+static enum power spend() {
+  if (dead) {
+    return POWER_OFF;
+  }
+  operations++;
+  if (budget == 0) {
+    dead = true;
+    return POWER_FAILING;
+  }
+  if (budget > 0) {
+    budget--;
+  }
+  return POWER_ON;
+}
+
+static void flash_read(uint32_t offset, void *dst, size_t len) {
+  memcpy(dst, flash + offset, len);
+}
+
+static bool flash_erase(uint32_t offset) {
+  enum power power = spend();
+  if (power == POWER_FAILING) {
+    memset(flash + offset + erase_cut, 0xFF, SECTOR_SIZE - erase_cut);
+  } else if (power == POWER_ON) {
+    memset(flash + offset, 0xFF, SECTOR_SIZE);
+  }
+  return power == POWER_ON;
+}
+
+static bool flash_program(uint32_t offset, const void *src, size_t len) {
+  enum power power = spend();
+  size_t n = power == POWER_ON ? len : power == POWER_FAILING ? len / 2 : 0;
+  for (size_t i = 0; i < n; i++) {
+    flash[offset + i] &= ((const uint8_t *)src)[i];
+  }
+  return power == POWER_ON;
+}
+
+static struct config_log_flash ops = {
+    .base = 0,
+    .sector_size = SECTOR_SIZE,
+    .read = flash_read,
+    .erase = flash_erase,
+    .program = flash_program,
+};
+
+static void power_on(long ops_left) {
+  budget = ops_left;
+  dead = false;
+}
+
+// What the log should hold: length -1 for a missing key
+struct model {
+  int length[KEYS];
+  uint8_t data[KEYS][128];
+};
+
+static void key_name(int key, char *name) {
+  strcpy(name, "key0");
+  name[3] += key;
+}
+
+// Keys 0 and 1 are written once and rarely touched again, so rotations have
+// to carry them over; keys 2 and 3 churn
+static int step_key(int i) {
+  if (i < 2 || i % 30 == 29) {
+    return i % 2;
+  }
+  return 2 + (i * 7 + i / 5) % 2;
+}
+
+// Step i of the workload: mostly overwrites of varying size, some deletes
+static bool step(struct config_log *log, int i, struct model *model) {
+  int key = step_key(i);
+  char name[8];
+  key_name(key, name);
+  if (i % 9 == 8) {
+    if (model->length[key] < 0) {
+      return true;
+    }
+    if (!config_log_delete(log, 1, name)) {
+      return false;
+    }
+    model->length[key] = -1;
+    return true;
+  }
+
+  uint8_t data[128];
+  int length = 8 + (i * 37) % 120;
+  for (int b = 0; b < length; b++) {
+    data[b] = i + b * 3;
+  }
+  if (!config_log_write(log, 1, name, data, length)) {
+    return false;
+  }
+  model->length[key] = length;
+  memcpy(model->data[key], data, length);
+  return true;
+}
+
+static bool key_matches(const struct config_log *log, int key, const struct model *model) {
+  char name[8];
+  uint8_t data[256];
+  key_name(key, name);
+  int length = config_log_read(log, 1, name, data, sizeof(data));
+  if (length != model->length[key]) {
+    return false;
+  }
+  return length < 0 || memcmp(data, model->data[key], length) == 0;
+}
+
+static void check_all(const struct config_log *log, const struct model *model, int except) {
+  for (int key = 0; key < KEYS; key++) {
+    if (key != except) {
+      CHECK(key_matches(log, key, model));
+    }
+  }
+}
+
+// The log keeps working after a recovery: more writes, rotations included
+static void check_continues(struct config_log *log, struct model *model) {
+  for (int i = STEPS; i < STEPS + 40; i++) {
+    CHECK(step(log, i, model));
+  }
+  check_all(log, model, -1);
+
+  struct config_log again;
+  CHECK(config_log_init(&again, &ops));
+  check_all(&again, model, -1);
+}
+
+/*
+ * Run the workload with the power failing after @p crash_at operations, then
+ * boot again (with the recovery itself failing after @p recovery_crash_at
+ * operations, if not -1). Every write that returned must still be there, and
+ * the one that was cut short is either there or not at all.
+ */
+static void run(uint32_t sectors, long crash_at, long recovery_crash_at) {
+  struct config_log log;
+  struct model model;
+  struct model before;
+  for (int key = 0; key < KEYS; key++) {
+    model.length[key] = -1;
+  }
+  memset(flash, 0xFF, sizeof(flash));
+  ops.size = sectors * SECTOR_SIZE;
+
+  power_on(crash_at);
+  int i = 0;
+  int pending = -1;
+  if (config_log_init(&log, &ops)) {
+    for (; i < STEPS; i++) {
+      before = model;
+      if (!step(&log, i, &model)) {
+        pending = step_key(i);
+        break;
+      }
+    }
+  }
+  CHECK(i == STEPS || dead);
+
+  if (recovery_crash_at >= 0) {
+    power_on(recovery_crash_at);
+    struct config_log interrupted;
+    config_log_init(&interrupted, &ops);
+  }
+
+  power_on(-1);
+  struct config_log rebooted;
+  CHECK(config_log_init(&rebooted, &ops));
+  if (pending < 0) {
+    check_all(&rebooted, &model, -1);
+    check_continues(&rebooted, &model);
+    return;
+  }
+  check_all(&rebooted, &before, pending);
+  if (key_matches(&rebooted, pending, &model)) {
+    check_continues(&rebooted, &model);
+  } else {
+    CHECK(key_matches(&rebooted, pending, &before));
+    check_continues(&rebooted, &before);
+  }
+}
+
+static long count_operations(uint32_t sectors) {
+  struct config_log log;
+  struct model model;
+  for (int key = 0; key < KEYS; key++) {
+    model.length[key] = -1;
+  }
+  memset(flash, 0xFF, sizeof(flash));
+  ops.size = sectors * SECTOR_SIZE;
+  power_on(-1);
+  operations = 0;
+  CHECK(config_log_init(&log, &ops));
+  for (int i = 0; i < STEPS; i++) {
+    CHECK(step(&log, i, &model));
+  }
+  return operations;
+}
+
+static void test_geometry() {
+  struct config_log log;
+  ops.size = 2 * SECTOR_SIZE;
+  power_on(-1);
+  CHECK(!config_log_init(&log, &ops));
+}
+
+int main() {
+  test_geometry();
+  for (uint32_t sectors = 3; sectors <= MAX_SECTORS; sectors++) {
+    long total = count_operations(sectors);
+    CHECK(total > 100);  // Enough writes for several rotations
+
+    for (erase_cut = SECTOR_SIZE / 4; erase_cut < SECTOR_SIZE; erase_cut += SECTOR_SIZE / 4) {
+      for (long crash_at = 0; crash_at <= total; crash_at++) {
+        run(sectors, crash_at, -1);
+      }
+    }
+    erase_cut = SECTOR_SIZE / 2;
+    // Resets during the recovery of a reset
+    for (long crash_at = 0; crash_at <= total; crash_at += 5) {
+      for (long recovery_crash_at = 0; recovery_crash_at < 10; recovery_crash_at++) {
+        run(sectors, crash_at, recovery_crash_at);
+      }
+    }
+  }
+  return test_exit();
+}
@@ -0,0 +1,104 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "console_out.h"
+#include "pico/stdlib.h"
+#include "test.h"
+
+/*
+ * console_out.c against a fake stdio that records every write, with a clock
+ * the test moves by hand.
+ */
+
+static char written[64 * 1024];
+static size_t written_len;
+static uint32_t writes;
+static uint32_t now_us;
+
+void stdio_put_string(const char *s, int len, bool newline, bool cr_translation) {
+  CHECK(written_len + len <= sizeof(written));
+  memcpy(written + written_len, s, len);
+  written_len += len;
+  writes++;
+}
+
+void stdio_flush() {}
+
+uint32_t time_us_32() {
+  return now_us;
+}
+
+static void reset() {
+  console_out_flush();
+  written_len = 0;
+  writes = 0;
+}
+
+static void test_newlines_dont_flush() {
+  reset();
+  console_out_printf("Line %d\n", 1);
+  console_out_write("Line 2\n", 7);
+  CHECK_EQ(writes, 0);
+  console_out_flush();
+  CHECK_EQ(writes, 1);
+  CHECK(written_len == 14 && memcmp(written, "Line 1\nLine 2\n", 14) == 0);
+  console_out_flush();
+  CHECK_EQ(writes, 1);
+}
+
+static void test_full_buffer() {
+  reset();
+  console_out_repeat('#', CONSOLE_OUT_BUFFER_SIZE + 10);
+  CHECK_EQ(writes, 1);
+  CHECK_EQ(written_len, CONSOLE_OUT_BUFFER_SIZE);
+  console_out_flush();
+  CHECK_EQ(writes, 2);
+  CHECK_EQ(written_len, CONSOLE_OUT_BUFFER_SIZE + 10);
+}
+
+// Idle time counts from the last write, not from the first buffered byte
+static void test_idle() {
+  reset();
+  now_us = 1000;
+  console_out_putc('a');
+  now_us += CONSOLE_OUT_IDLE_US - 500;
+  console_out_putc('b');
+  now_us += 1000;
+  console_out_poll();
+  CHECK_EQ(writes, 0);
+  now_us += CONSOLE_OUT_IDLE_US;
+  console_out_poll();
+  CHECK_EQ(writes, 1);
+  CHECK_EQ(written_len, 2);
+
+  // The clock wrapping around between writes
+  now_us = UINT32_MAX - 100;
+  console_out_putc('c');
+  now_us += CONSOLE_OUT_IDLE_US + 1;
+  console_out_poll();
+  CHECK_EQ(writes, 2);
+}
+
+// The `cb` workload, 16 KB in 64-byte lines: one write per line with the
+// old newline flush, one per full buffer now
+static void test_benchmark_workload() {
+  reset();
+  uint32_t before = console_out_writes();
+  for (int i = 0; i < 16 * 1024 / 64; i++) {
+    console_out_repeat('#', 63);
+    console_out_putc('\n');
+  }
+  console_out_flush();
+  CHECK_EQ(console_out_writes() - before, 16 * 1024 / CONSOLE_OUT_BUFFER_SIZE);
+  CHECK_EQ(written_len, 16 * 1024);
+  CHECK_EQ(written[63], '\n');
+  CHECK_EQ(written[16 * 1024 - 2], '#');
+}
+
+int main() {
+  test_newlines_dont_flush();
+  test_full_buffer();
+  test_idle();
+  test_benchmark_workload();
+  return test_exit();
+}
@@ -0,0 +1,125 @@
+#include <stdlib.h>
+
+#include "hv_regulator.h"
+#include "test.h"
+
+static void test_charge_cycle() {
+  struct hv_regulator reg;
+  hv_regulator_init(&reg);
+  CHECK_EQ(reg.state, HV_REG_OFF);
+  CHECK(!reg.pwm_on);
+
+  CHECK_EQ(hv_regulator_enable(&reg, false), HV_REG_PWM_START);
+  CHECK_EQ(reg.state, HV_REG_CHARGING);
+  CHECK_EQ(hv_regulator_feedback(&reg, false), HV_REG_PWM_KEEP);
+
+  CHECK_EQ(hv_regulator_feedback(&reg, true), HV_REG_PWM_STOP);
+  CHECK_EQ(reg.state, HV_REG_HOLDING);
+  CHECK_EQ(reg.charge_cycles, 1);
+  CHECK_EQ(hv_regulator_feedback(&reg, true), HV_REG_PWM_KEEP);
+
+  // Leakage or a pulse drains the capacitor: charge again
+  CHECK_EQ(hv_regulator_feedback(&reg, false), HV_REG_PWM_START);
+  CHECK_EQ(reg.state, HV_REG_CHARGING);
+  CHECK_EQ(hv_regulator_feedback(&reg, true), HV_REG_PWM_STOP);
+  CHECK_EQ(reg.charge_cycles, 2);
+}
+
+static void test_enable_charged() {
+  struct hv_regulator reg;
+  hv_regulator_init(&reg);
+
+  // Still charged from the last arm: hold without pumping
+  CHECK_EQ(hv_regulator_enable(&reg, true), HV_REG_PWM_KEEP);
+  CHECK_EQ(reg.state, HV_REG_HOLDING);
+  CHECK(!reg.pwm_on);
+  CHECK_EQ(reg.charge_cycles, 0);
+
+  // Enabling again is just a re-sample
+  CHECK_EQ(hv_regulator_enable(&reg, true), HV_REG_PWM_KEEP);
+  CHECK_EQ(hv_regulator_enable(&reg, false), HV_REG_PWM_START);
+  CHECK_EQ(reg.state, HV_REG_CHARGING);
+  CHECK_EQ(hv_regulator_enable(&reg, false), HV_REG_PWM_KEEP);
+}
+
+static void test_disable() {
+  struct hv_regulator reg;
+  hv_regulator_init(&reg);
+
+  hv_regulator_enable(&reg, false);
+  CHECK_EQ(hv_regulator_disable(&reg), HV_REG_PWM_STOP);
+  CHECK_EQ(reg.state, HV_REG_OFF);
+  CHECK_EQ(hv_regulator_disable(&reg), HV_REG_PWM_KEEP);
+
+  // Edges that arrive after disarming never restart the pump
+  CHECK_EQ(hv_regulator_feedback(&reg, false), HV_REG_PWM_KEEP);
+  CHECK_EQ(hv_regulator_feedback(&reg, true), HV_REG_PWM_KEEP);
+  CHECK_EQ(reg.state, HV_REG_OFF);
+
+  hv_regulator_enable(&reg, true);
+  CHECK_EQ(hv_regulator_disable(&reg), HV_REG_PWM_KEEP);
+  CHECK_EQ(reg.state, HV_REG_OFF);
+
+  // Counting carries on across arms
+  hv_regulator_enable(&reg, false);
+  hv_regulator_feedback(&reg, true);
+  hv_regulator_disable(&reg);
+  hv_regulator_enable(&reg, false);
+  hv_regulator_feedback(&reg, true);
+  CHECK_EQ(reg.charge_cycles, 2);
+}
+
+/*
+ * A bouncing feedback pin and random arm/disarm: the actions alone must keep
+ * a PWM model in sync, with no redundant start or stop, and the PWM runs
+ * exactly while charging.
+ */
+static void test_random_edges() {
+  struct hv_regulator reg;
+  hv_regulator_init(&reg);
+  bool pwm = false;
+  uint32_t cycles = 0;
+  hv_reg_state_t before;
+  srand(2);
+  for (int i = 0; i < 100000; i++) {
+    bool charged = rand() & 1;
+    hv_reg_action_t action;
+    before = reg.state;
+    switch (rand() % 16) {
+      case 0:
+        action = hv_regulator_enable(&reg, charged);
+        break;
+      case 1:
+        action = hv_regulator_disable(&reg);
+        break;
+      default:
+        action = hv_regulator_feedback(&reg, charged);
+        break;
+    }
+
+    if (action == HV_REG_PWM_START) {
+      CHECK(!pwm);
+      pwm = true;
+    } else if (action == HV_REG_PWM_STOP) {
+      CHECK(pwm);
+      pwm = false;
+    }
+    CHECK_EQ(pwm, reg.pwm_on);
+    CHECK_EQ(pwm, reg.state == HV_REG_CHARGING);
+    if (before == HV_REG_CHARGING && reg.state == HV_REG_HOLDING) {
+      cycles++;
+    }
+    CHECK_EQ(reg.charge_cycles, cycles);
+    if (test_failures) {
+      return;
+    }
+  }
+}
+
+int main() {
+  test_charge_cycle();
+  test_enable_charged();
+  test_disable();
+  test_random_edges();
+  return test_exit();
+}
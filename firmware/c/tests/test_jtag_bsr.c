@@ -0,0 +1,147 @@
+#include <string.h>
+
+#include "jtag_bsr.h"
+#include "jtag_pio.h"
+#include "tap_model.h"
+#include "test.h"
+
+/*
+ * jtag_bsr.c on a fake JTAG engine: runs go through the TAP model, and loop
+ * mode is stepped by the test one period at a time, TDO wrapping around the
+ * ring as the DMA would.
+ */
+
+#define BSR_LENGTH 37
+#define SAMPLE 0x2
+
+static const struct jtag_stream *loop_stream;
+static uint32_t *loop_ring;
+static uint32_t loop_mask;
+static uint32_t loop_words;
+static bool looping;
+
+void jtag_pio_set_pins(uint tdi, uint tdo, uint tck, uint tms) {}
+
+void gpio_set_dir(uint gpio, bool out) {}
+
+uint64_t time_us_64() {
+  static uint64_t now;
+  return now += 1000;
+}
+
+bool jtag_pio_run(const struct jtag_stream *stream, uint32_t *tdo) {
+  CHECK(!looping);
+  CHECK_EQ(stream->clocks % JTAG_TDO_CLOCKS_PER_WORD, 0);
+  tap_model_run(stream, tdo);
+  return true;
+}
+
+bool jtag_pio_loop_start(const struct jtag_stream *stream, uint32_t *ring, uint ring_bits) {
+  if (looping) {
+    return false;
+  }
+  loop_stream = stream;
+  loop_ring = ring;
+  loop_mask = (1u << ring_bits) / sizeof(uint32_t) - 1;
+  loop_words = 0;
+  looping = true;
+  return true;
+}
+
+uint32_t jtag_pio_loop_words() {
+  return loop_words;
+}
+
+void jtag_pio_loop_stop() {
+  looping = false;
+}
+
+// The pins the target shows at its n-th capture
+static uint64_t pins(uint32_t n) {
+  return (0x1234567ull * n + 5) & ((1ull << BSR_LENGTH) - 1);
+}
+
+static void loop_periods(uint32_t count) {
+  uint32_t tdo[JTAG_TDO_WORDS(JTAG_BSR_MAX_LEN + 128)];
+  for (uint32_t i = 0; i < count; i++) {
+    tap_model_set_pins(pins(loop_words / (loop_stream->clocks / JTAG_TDO_CLOCKS_PER_WORD)));
+    tap_model_run(loop_stream, tdo);
+    CHECK(tap_model_in_idle());  // A period has to end where it starts
+    for (uint32_t w = 0; w < loop_stream->clocks / JTAG_TDO_CLOCKS_PER_WORD; w++) {
+      loop_ring[loop_words++ & loop_mask] = tdo[w];
+    }
+  }
+}
+
+static uint64_t sample(const uint32_t *words) {
+  return words[0] | (uint64_t)words[1] << 32;
+}
+
+static const struct tap_model_tap taps[] = {
+    {.ir_length = 4, .idcode = 0x4BA00477},
+    {.ir_length = 5, .idcode = 0x0692602F, .sample = SAMPLE, .bsr_length = BSR_LENGTH},
+    {.ir_length = 7, .idcode = 0x06431041},
+};
+static const uint8_t ir_lengths[] = {4, 5, 7};
+
+static void test_sampling(uint32_t bsr_length) {
+  struct jtag_bsr_target target = {
+      .device = 1, .device_count = 3, .ir_lengths = ir_lengths, .opcode = SAMPLE, .bsr_length = bsr_length};
+  struct jtag_bsr_status status;
+  uint32_t words[2 * 8];
+
+  tap_model_init(taps, 3);
+  CHECK(jtag_bsr_start(&target));
+  CHECK(jtag_bsr_running());
+  CHECK_EQ(tap_model_instruction(0), 0xF);
+  CHECK_EQ(tap_model_instruction(1), SAMPLE);
+  CHECK_EQ(tap_model_instruction(2), 0x7F);
+  jtag_bsr_get_status(&status);
+  CHECK_EQ(status.bsr_length, BSR_LENGTH);
+  CHECK_EQ(status.samples, 0);
+
+  loop_periods(10);
+  uint32_t first = 0;
+  CHECK_EQ(jtag_bsr_read(&first, words, 8), 8);
+  CHECK_EQ(first, 0);
+  for (uint32_t i = 0; i < 8; i++) {
+    CHECK_EQ(sample(words + 2 * i), pins(i));
+  }
+
+  // Wrap the ring a few times: the oldest samples are gone
+  loop_periods(3000);
+  jtag_bsr_get_status(&status);
+  CHECK_EQ(status.samples, 3010);
+  first = 0;
+  CHECK_EQ(jtag_bsr_read(&first, words, 8), 8);
+  CHECK(first > 0);
+  for (uint32_t i = 0; i < 8; i++) {
+    CHECK_EQ(sample(words + 2 * i), pins(first + i));
+  }
+  first = status.samples - 1;
+  CHECK_EQ(jtag_bsr_read(&first, words, 8), 1);
+  CHECK_EQ(sample(words), pins(status.samples - 1));
+
+  jtag_bsr_stop();
+  CHECK(!jtag_bsr_running());
+  first = status.samples;
+  CHECK_EQ(jtag_bsr_read(&first, words, 8), 0);
+}
+
+static void test_rejects() {
+  struct jtag_bsr_target target = {.device = 1, .device_count = 3, .ir_lengths = ir_lengths, .opcode = 0};
+  tap_model_init(taps, 3);
+  CHECK(!jtag_bsr_start(&target));  // EXTEST in most parts
+  target.opcode = 0x20;             // Wider than the IR
+  CHECK(!jtag_bsr_start(&target));
+  target.opcode = SAMPLE;
+  target.device = 3;
+  CHECK(!jtag_bsr_start(&target));
+}
+
+int main() {
+  test_sampling(0);  // Measured
+  test_sampling(BSR_LENGTH);
+  test_rejects();
+  return test_exit();
+}
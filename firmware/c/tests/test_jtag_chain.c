@@ -0,0 +1,217 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "jtag_chain.h"
+#include "jtag_stream.h"
+#include "tap_model.h"
+#include "test.h"
+
+/*
+ * The scan's stream sequences (see blueTag.h: detectDevices(),
+ * jtagReadChainIds(), jtagMeasureIr()) run against the TAP model.
+ */
+
+#define MAX_DEVICES 32
+#define MAX_IR_CHAIN (MAX_DEVICES * JTAG_CHAIN_MAX_IR_LEN)
+#define MAX_CLOCKS 4096
+
+static uint32_t stream_words[JTAG_STREAM_WORDS(MAX_CLOCKS)];
+static uint32_t tdo[JTAG_TDO_WORDS(MAX_CLOCKS)];
+static struct jtag_stream stream;
+
+static void begin() {
+  jtag_stream_init(&stream, stream_words, MAX_CLOCKS);
+  jtag_stream_restore_idle(&stream);
+}
+
+static void run() {
+  CHECK(jtag_stream_finish(&stream));
+  tap_model_run(&stream, tdo);
+  CHECK(tap_model_in_idle());
+}
+
+static uint32_t detect_devices() {
+  begin();
+  jtag_stream_enter_shift_ir(&stream);
+  jtag_stream_clocks(&stream, false, true, MAX_IR_CHAIN);
+  jtag_stream_tms(&stream, 0b00111, 5);  // Update-IR, on to Shift-DR
+  jtag_stream_clocks(&stream, false, true, MAX_DEVICES);
+  uint32_t start = stream.clocks;
+  jtag_stream_clocks(&stream, false, false, MAX_DEVICES - 1);
+  jtag_stream_tms(&stream, 0b011, 3);
+  run();
+  return jtag_chain_measure(tdo, start, MAX_DEVICES - 1);
+}
+
+static void read_ids(uint32_t count, uint32_t *ids) {
+  begin();
+  jtag_stream_enter_shift_dr(&stream);
+  uint32_t clock = stream.clocks;
+  jtag_stream_clocks(&stream, false, true, count * 32);
+  jtag_stream_restore_idle(&stream);
+  run();
+  for (uint32_t i = 0; i < count; i++) {
+    if (jtag_tdo_bit(tdo, clock)) {
+      ids[i] = jtag_tdo_bits(tdo, clock, 32);
+      clock += 32;
+    } else {
+      ids[i] = 0;
+      clock += 1;
+    }
+  }
+}
+
+static bool measure_ir(uint32_t count, uint32_t *total, uint8_t *lengths) {
+  begin();
+  jtag_stream_enter_shift_ir(&stream);
+  uint32_t capture = stream.clocks;
+  jtag_stream_clocks(&stream, false, true, MAX_IR_CHAIN);
+  uint32_t zero = stream.clocks;
+  jtag_stream_clocks(&stream, false, false, 1);
+  jtag_stream_clocks(&stream, false, true, MAX_IR_CHAIN - 1);
+  jtag_stream_clocks(&stream, true, true, 1);
+  jtag_stream_exit_to_idle(&stream);
+  run();
+  *total = jtag_chain_measure(tdo, zero, MAX_IR_CHAIN);
+  return jtag_chain_split_ir(tdo, capture, *total, count, lengths);
+}
+
+static void test_encoding() {
+  uint32_t words[JTAG_STREAM_WORDS(64)];
+  struct jtag_stream s;
+  jtag_stream_init(&s, words, 64);
+  jtag_stream_tms(&s, 0b10, 2);
+  jtag_stream_shift(&s, 0b101, 3, true);
+  // TDI in the even bits, TMS in the odd ones
+  CHECK_EQ(s.clocks, 5);
+  CHECK_EQ(words[0], 0b01 | (0b11 << 2) | (0b01 << 4) | (0b00 << 6) | (0b11 << 8));
+
+  CHECK(jtag_stream_finish(&s));
+  CHECK_EQ(s.clocks, 32);
+  jtag_stream_clocks(&s, false, false, 33);
+  CHECK(s.overflow);
+  CHECK_EQ(s.clocks, 64);
+  CHECK(!jtag_stream_finish(&s));
+
+  uint32_t captured[2] = {0x80000000, 0x5};
+  CHECK(jtag_tdo_bit(captured, 31));
+  CHECK(!jtag_tdo_bit(captured, 33));
+  CHECK_EQ(jtag_tdo_bits(captured, 31, 4), 0b1011);
+}
+
+// restore_idle() gets every TAP to Run-Test/Idle whatever state it's in
+static void test_restore_idle() {
+  const struct tap_model_tap tap = {.ir_length = 4, .idcode = 0x4BA00477};
+  tap_model_init(&tap, 1);
+  srand(3);
+  for (int i = 0; i < 1000; i++) {
+    uint32_t clocks = rand() % 20;
+    jtag_stream_init(&stream, stream_words, MAX_CLOCKS);
+    jtag_stream_tms(&stream, rand(), clocks);
+    jtag_stream_restore_idle(&stream);
+    run();
+  }
+}
+
+static void check_chain(const struct tap_model_tap *taps, uint32_t count, bool splits) {
+  tap_model_init(taps, count);
+  CHECK_EQ(detect_devices(), count);
+
+  uint32_t ids[MAX_DEVICES];
+  read_ids(count, ids);
+  for (uint32_t i = 0; i < count; i++) {
+    CHECK_EQ(ids[i], taps[i].idcode);
+  }
+
+  uint32_t total;
+  uint32_t expected_total = 0;
+  uint8_t lengths[MAX_DEVICES];
+  for (uint32_t i = 0; i < count; i++) {
+    expected_total += taps[i].ir_length;
+  }
+  CHECK_EQ(measure_ir(count, &total, lengths) ? 1 : 0, splits ? 1 : 0);
+  CHECK_EQ(total, expected_total);
+  for (uint32_t i = 0; i < count; i++) {
+    CHECK_EQ(lengths[i], splits ? taps[i].ir_length : 0);
+  }
+
+  // The IR measurement leaves every TAP in BYPASS
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t ones = taps[i].ir_length == 32 ? 0xFFFFFFFF : (1u << taps[i].ir_length) - 1;
+    CHECK_EQ(tap_model_instruction(i), ones);
+  }
+}
+
+static void test_chains() {
+  // Cortex-M DAP, an FPGA, another vendor's part
+  const struct tap_model_tap mixed[] = {
+      {.ir_length = 4, .idcode = 0x4BA00477},
+      {.ir_length = 5, .idcode = 0x0692602F},
+      {.ir_length = 7, .idcode = 0x06431041},
+  };
+  check_chain(mixed, 3, true);
+  check_chain(mixed, 1, true);
+
+  // A TAP without IDCODE shifts out a single 0 after reset
+  const struct tap_model_tap bypass_only[] = {
+      {.ir_length = 4, .idcode = 0x4BA00477},
+      {.ir_length = 2, .idcode = 0},
+      {.ir_length = 8, .idcode = 0x0692602F},
+  };
+  check_chain(bypass_only, 3, true);
+
+  // Extremes of the IR length range
+  const struct tap_model_tap wide[] = {
+      {.ir_length = 32, .idcode = 0x1000000F},
+      {.ir_length = 2, .idcode = 0x2000000F},
+      {.ir_length = 32, .idcode = 0x3000000F},
+  };
+  check_chain(wide, 3, true);
+
+  // Capture 0101 then 01: reads 1010 10, which also splits as 2 + 4
+  const struct tap_model_tap ambiguous[] = {
+      {.ir_length = 4, .ir_capture = 0b0101, .idcode = 0x4BA00477},
+      {.ir_length = 2, .idcode = 0x0692602F},
+  };
+  check_chain(ambiguous, 2, false);
+
+  // Capture 0001 then 01: only 4 + 2 fits
+  const struct tap_model_tap unique[] = {
+      {.ir_length = 4, .idcode = 0x4BA00477},
+      {.ir_length = 2, .idcode = 0x0692602F},
+  };
+  check_chain(unique, 2, true);
+}
+
+static void test_long_chain() {
+  struct tap_model_tap taps[TAP_MODEL_MAX_TAPS];
+  for (uint32_t i = 0; i < TAP_MODEL_MAX_TAPS; i++) {
+    taps[i] = (struct tap_model_tap){.ir_length = 2 + (i * 5) % 11, .idcode = 0x100 * i + 0x1001};
+  }
+  check_chain(taps, TAP_MODEL_MAX_TAPS, true);
+}
+
+static void test_split_rejects() {
+  uint32_t capture[1] = {0};
+  uint8_t lengths[4];
+  // No capture pattern at all, fewer candidates than TAPs, too short
+  CHECK(!jtag_chain_split_ir(capture, 0, 8, 2, lengths));
+  capture[0] = 0b01;
+  CHECK(!jtag_chain_split_ir(capture, 0, 8, 2, lengths));
+  CHECK(!jtag_chain_split_ir(capture, 0, 3, 2, lengths));
+  // Single TAP: the total is the length, if it's in range
+  CHECK(jtag_chain_split_ir(capture, 0, 5, 1, lengths) && lengths[0] == 5);
+  CHECK(!jtag_chain_split_ir(capture, 0, 40, 1, lengths));
+
+  uint32_t ones[2] = {0xFFFFFFFF, 0xFFFFFFFF};
+  CHECK_EQ(jtag_chain_measure(ones, 0, 40), 0);
+}
+
+int main() {
+  test_encoding();
+  test_restore_idle();
+  test_chains();
+  test_long_chain();
+  test_split_rejects();
+  return test_exit();
+}
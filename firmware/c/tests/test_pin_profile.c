@@ -0,0 +1,128 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "pin_profile.h"
+#include "test.h"
+
+/*
+ * Recorded profiles: per channel, the levels of the 16 samples taken with
+ * the pull-ups and the 16 taken with the pull-downs, sample n in bit n.
+ */
+
+#define SAMPLES 16
+
+struct recording {
+  uint8_t channels;
+  uint16_t pulled_up[PIN_PROFILE_MAX_CHANNELS];
+  uint16_t pulled_down[PIN_PROFILE_MAX_CHANNELS];
+};
+
+// Feed a recording the way pinProfileMeasure() does, one sample of every
+// channel at a time
+static void replay(const struct recording *recording, struct pin_profile *profile) {
+  pin_profile_init(profile, recording->channels);
+  for (int pass = 0; pass < 2; pass++) {
+    const uint16_t *levels = pass == 0 ? recording->pulled_up : recording->pulled_down;
+    for (int i = 0; i < SAMPLES; i++) {
+      uint32_t sample = 0;
+      for (uint8_t ch = 0; ch < recording->channels; ch++) {
+        sample |= ((levels[ch] >> i) & 1u) << ch;
+      }
+      pin_profile_add(profile, pass == 0, sample);
+    }
+  }
+}
+
+// An SWD/JTAG header next to the target's console UART
+static const struct recording board = {
+    .channels = 8,
+    .pulled_up = {0x0000, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFE, 0xF0F3, 0xAAAA, 0x0000},
+    .pulled_down = {0x0000, 0xFFFF, 0x0000, 0xFFFF, 0xFFFF, 0xFFFF, 0x5555, 0x0000},
+};
+
+static const enum pin_class board_classes[] = {
+    PIN_CLASS_LOW,       // TCK with a board pull-down
+    PIN_CLASS_HIGH,      // TMS with a board pull-up
+    PIN_CLASS_FLOATING,  // TDI, no pull
+    PIN_CLASS_HIGH,      // TDO driven high
+    PIN_CLASS_HIGH,      // UART TX idle, a start bit in one sample
+    PIN_CLASS_ACTIVE,    // UART TX mid-transfer
+    PIN_CLASS_ACTIVE,    // Clock output
+    PIN_CLASS_LOW,       // GND
+};
+
+static void check_order(const struct pin_profile *profile, enum pin_role role, uint32_t exclude, bool prune,
+                        const uint8_t *expected, uint8_t count) {
+  uint8_t order[PIN_PROFILE_MAX_CHANNELS];
+  CHECK_EQ(pin_profile_order(profile, role, exclude, prune, order), count);
+  CHECK(count == 0 || memcmp(order, expected, count) == 0);
+}
+
+static void test_board() {
+  struct pin_profile profile;
+  replay(&board, &profile);
+  for (uint8_t ch = 0; ch < board.channels; ch++) {
+    CHECK_EQ(pin_profile_class(&profile, ch), board_classes[ch]);
+  }
+  CHECK_EQ(pin_profile_active(&profile), 0x60);
+
+  check_order(&profile, PIN_ROLE_TCK, 0, true, (const uint8_t[]){0, 7, 2, 1, 3, 4}, 6);
+  check_order(&profile, PIN_ROLE_TMS, 0, true, (const uint8_t[]){1, 3, 4, 2, 0, 7}, 6);
+  check_order(&profile, PIN_ROLE_TDO, 0, true, (const uint8_t[]){2, 1, 3, 4, 0, 7}, 6);
+  // The second search: the active channels come last
+  check_order(&profile, PIN_ROLE_TCK, 0, false, (const uint8_t[]){0, 7, 2, 1, 3, 4, 5, 6}, 8);
+  check_order(&profile, PIN_ROLE_SWDIO, 0x0B, false, (const uint8_t[]){4, 2, 7, 5, 6}, 5);
+}
+
+static uint16_t with_glitches(uint16_t level, int glitches) {
+  return level ^ ((1u << glitches) - 1);
+}
+
+// Samples away from the majority only make a channel active from 1/4 on
+static void test_threshold() {
+  struct recording recording = {.channels = 2};
+  struct pin_profile profile;
+  for (int glitches = 0; glitches <= SAMPLES / 2; glitches++) {
+    bool active = glitches * PIN_PROFILE_ACTIVE_FRACTION >= SAMPLES;
+    // A pulled-up pin glitching low, a floating one glitching against the pull-down
+    recording.pulled_up[0] = with_glitches(0xFFFF, glitches);
+    recording.pulled_down[0] = 0xFFFF;
+    recording.pulled_up[1] = 0xFFFF;
+    recording.pulled_down[1] = with_glitches(0x0000, glitches);
+    replay(&recording, &profile);
+    CHECK_EQ(pin_profile_class(&profile, 0), active ? PIN_CLASS_ACTIVE : PIN_CLASS_HIGH);
+    CHECK_EQ(pin_profile_class(&profile, 1), active ? PIN_CLASS_ACTIVE : PIN_CLASS_FLOATING);
+  }
+}
+
+static void test_edge_cases() {
+  struct pin_profile profile;
+
+  // Nothing sampled: every channel floats, in channel order
+  pin_profile_init(&profile, 4);
+  CHECK_EQ(pin_profile_active(&profile), 0);
+  check_order(&profile, PIN_ROLE_TMS, 0, true, (const uint8_t[]){0, 1, 2, 3}, 4);
+  check_order(&profile, PIN_ROLE_TDI, 0x5, true, (const uint8_t[]){1, 3}, 2);
+
+  // Low against the pull-up, high against the pull-down: steady within each
+  // pass, but it must have moved in between
+  const struct recording swapped = {.channels = 1, .pulled_up = {0x0000}, .pulled_down = {0xFFFF}};
+  replay(&swapped, &profile);
+  CHECK_EQ(pin_profile_class(&profile, 0), PIN_CLASS_ACTIVE);
+
+  // All of the channels active: the pruned search has nothing to try
+  const struct recording busy = {.channels = 2, .pulled_up = {0xAAAA, 0x00FF}, .pulled_down = {0x5555, 0xFF00}};
+  replay(&busy, &profile);
+  check_order(&profile, PIN_ROLE_SWCLK, 0, true, NULL, 0);
+  check_order(&profile, PIN_ROLE_SWCLK, 0, false, (const uint8_t[]){0, 1}, 2);
+
+  pin_profile_init(&profile, 40);
+  CHECK_EQ(profile.channels, PIN_PROFILE_MAX_CHANNELS);
+}
+
+int main() {
+  test_board();
+  test_threshold();
+  test_edge_cases();
+  return test_exit();
+}
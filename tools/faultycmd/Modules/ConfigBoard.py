@@ -15,6 +15,9 @@ class Commands(Enum):
     COMMAND_TOGGLE_GPIO       = "t"
     COMMAND_STATUS            = "s"
     COMMAND_RESET             = "r"
+    COMMAND_MACHINE_MODE      = "mm"
+    COMMAND_HUMAN_MODE        = "mm off"
+    COMMAND_BURST             = "bu"
     
     def __str__(self):
         return self.value
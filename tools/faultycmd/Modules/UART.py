@@ -12,12 +12,14 @@ else:
     DEFAULT_COMPORT = "/dev/ttyACM0"
 
 DEFAULT_SERIAL_BAUDRATE = 921600
+DEFAULT_SERIAL_TIMEOUT  = 15
 
 class UART(threading.Thread):
     def __init__(self, serial_port: str = DEFAULT_COMPORT):
         self.serial_worker          = serial.Serial()
         self.serial_worker.port     = serial_port
         self.serial_worker.baudrate = DEFAULT_SERIAL_BAUDRATE
+        self.serial_worker.timeout  = DEFAULT_SERIAL_TIMEOUT
         self.recv_cancel            = False
         #self.daemon                 = True
 
@@ -86,6 +88,20 @@ class UART(threading.Thread):
             self.recv_cancel = True
             return None
     
+    def send_command(self, data):
+        """Send machine mode command(s) and collect one OK/ERR reply per ';'-separated command."""
+        self.send(data)
+        expected = data.count(b";") + 1
+        replies = []
+        while len(replies) < expected and not self.recv_cancel:
+            line = self.serial_worker.readline()
+            if not line:
+                break
+            line = line.strip()
+            if line.startswith(b"OK") or line.startswith(b"ERR"):
+                replies.append(line)
+        return replies
+
     def send_recv(self, data):
         self.send(data)
         return self.recv()
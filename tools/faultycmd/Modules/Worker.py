@@ -8,6 +8,8 @@ from .UART import UART
 from .ConfigBoard import ConfigBoard
 
 class FaultyWorker(threading.Thread):
+    BURST_MAX_PULSES = 512
+    BURST_MAX_SECONDS = 10
     def __init__(self):
         super().__init__()
         #self.daemon = True
@@ -42,26 +44,55 @@ class FaultyWorker(threading.Thread):
         self.pulse_time = pulse_time
         self.board_configurator.BOARD_CONFIG["pulse_time"] = pulse_time
     
+    def wait_charged(self, timeout=2.0):
+        """Poll the machine mode status until the HV charged bit is set."""
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            replies = self.board_uart.send_command(
+                self.board_configurator.board_commands.COMMAND_STATUS.value.encode("utf-8")
+            )
+            for field in replies[0].split()[1:] if replies else []:
+                key, _, value = field.partition(b"=")
+                if key == b"st" and int(value) & 0b10:
+                    return True
+        return False
+
     def start_faulty_attack(self):
+        commands = self.board_configurator.board_commands
         try:
             self.board_uart.open()
-            time.sleep(0.1)
+            self.board_uart.send_command(commands.COMMAND_MACHINE_MODE.value.encode("utf-8"))
             typer.secho("Board connected.", fg=typer.colors.GREEN)
             typer.secho("[*] ARMING BOARD, BE CAREFULL!", fg=typer.colors.BRIGHT_YELLOW)
-            self.board_uart.send(self.board_configurator.board_commands.COMMAND_DISARM.value.encode("utf-8"))
-            time.sleep(1)
-            self.board_uart.send(self.board_configurator.board_commands.COMMAND_ARM.value.encode("utf-8"))
+            self.board_uart.send_command(commands.COMMAND_DISARM.value.encode("utf-8"))
             
-            typer.secho("[*] ARMED BOARD.", fg=typer.colors.BRIGHT_GREEN)
-            time.sleep(1)
             typer.secho(f"[*] SENDING {self.pulse_count} PULSES.", fg=typer.colors.BRIGHT_GREEN)
-            for i in range(self.pulse_count):
-                typer.secho(f"\t- SENDING PULSE {i+1} OF {self.pulse_count}.", fg=typer.colors.BRIGHT_GREEN)
-                self.board_uart.send(self.board_configurator.board_commands.COMMAND_PULSE.value.encode("utf-8"))
-                time.sleep(self.pulse_time)
+            # The board paces the pulses itself; split into bursts that fit the serial timeout
+            period_us = max(1, int(self.pulse_time * 1000000))
+            per_burst = max(1, min(self.BURST_MAX_PULSES, int(self.BURST_MAX_SECONDS * 1000000 / period_us)))
+            sent = 0
+            while sent < self.pulse_count:
+                count = min(per_burst, self.pulse_count - sent)
+                # The board disarms after every burst, so re-arm and wait for the charge
+                self.board_uart.send_command(commands.COMMAND_ARM.value.encode("utf-8"))
+                if not self.wait_charged():
+                    typer.secho("\t  BOARD DID NOT CHARGE.", fg=typer.colors.BRIGHT_RED)
+                command = f"{commands.COMMAND_BURST.value} n={count} period={period_us}"
+                replies = self.board_uart.send_command(command.encode("utf-8"))
+                if not replies or not replies[0].startswith(b"OK"):
+                    typer.secho(f"\t  BURST FAILED: {replies}", fg=typer.colors.BRIGHT_RED)
+                    break
+                fields = dict(field.partition(b"=")[::2] for field in replies[0].split()[1:])
+                typer.secho(
+                    f"\t- PULSES {sent+1}-{sent+count}: {int(fields[b'fired'])} FIRED, "
+                    f"{int(fields[b'skipped'])} SKIPPED (NOT CHARGED).",
+                    fg=typer.colors.BRIGHT_GREEN,
+                )
+                sent += count
             
             typer.secho("DISARMING BOARD.", fg=typer.colors.BRIGHT_YELLOW)
-            self.board_uart.send(self.board_configurator.board_commands.COMMAND_DISARM.value.encode("utf-8"))
+            self.board_uart.send_command(commands.COMMAND_DISARM.value.encode("utf-8"))
+            self.board_uart.send_command(commands.COMMAND_HUMAN_MODE.value.encode("utf-8"))
             self.board_uart.close()
             typer.secho("BOARD DISARMING.", fg=typer.colors.BRIGHT_YELLOW)
         except Exception as e: